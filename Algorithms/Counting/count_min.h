@@ -0,0 +1,180 @@
+#ifndef AC50772F_2C78_46AF_B54A_F88B2024FD70
+#define AC50772F_2C78_46AF_B54A_F88B2024FD70
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../IO/hash_mix.h"
+
+/*
+
+The swiss table counts every key exactly, and needs memory for every distinct key. A
+Count-Min sketch answers "how often did key occur" in fixed memory: depth rows of width
+counters, where every key owns one counter per row.
+
+Adding a key increments its counter in every row; other keys that share one of those
+counters can only add to it, so every counter overestimates, and the smallest of the depth
+counters is the estimate. With width w and depth d, the estimate exceeds the true count by
+more than e / w times the total count with probability at most e^-d. The default, 2^14
+counters by 4 rows (512 KB), overestimates by at most 0.017% of the total, 98% of the time.
+
+The d counters come from one 64-bit hash, as h1 + i * h2 for row i (Kirsch and Mitzenmacher),
+which is as good as d independent hashes for this purpose.
+
+With conservative update, an add only raises the counters that would otherwise fall below
+the new estimate: every counter becomes at least min + amount, and none grows beyond that.
+The estimates stay upper bounds, and keys that share counters with frequent keys are
+overestimated far less.
+
+Sketches of the same shape merge by adding their counters, so per-thread sketches combine
+into the sketch of the whole stream. The sum of two conservative sketches still only
+overestimates.
+
+*/
+
+#define COUNT_MIN_DEFAULT_WIDTH (1 << 14)
+#define COUNT_MIN_DEFAULT_DEPTH 4
+#define COUNT_MIN_MAX_DEPTH 16
+
+typedef struct
+{
+    uint64_t *counters; // depth rows of width counters
+    size_t width;       // a power of two
+    size_t depth;
+    uint64_t total;     // sum of all amounts added
+} count_min_t;
+
+/*
+
+width is rounded up to a power of two; 0 picks COUNT_MIN_DEFAULT_WIDTH, and a depth of 0
+picks COUNT_MIN_DEFAULT_DEPTH.
+
+*/
+
+bool count_min_init(count_min_t *sketch, size_t width, size_t depth)
+{
+    if (!sketch || depth > COUNT_MIN_MAX_DEPTH)
+    {
+        return false;
+    }
+
+    if (!width)
+    {
+        width = COUNT_MIN_DEFAULT_WIDTH;
+    }
+    if (!depth)
+    {
+        depth = COUNT_MIN_DEFAULT_DEPTH;
+    }
+
+    sketch->width = 1;
+    while (sketch->width < width)
+    {
+        sketch->width *= 2;
+    }
+    sketch->depth = depth;
+    sketch->total = 0;
+    sketch->counters = (uint64_t *)calloc(sketch->width * depth, sizeof(uint64_t));
+    return sketch->counters != NULL;
+}
+
+void count_min_free(count_min_t *sketch)
+{
+    if (!sketch)
+    {
+        return;
+    }
+
+    free(sketch->counters);
+    sketch->counters = NULL;
+    sketch->width = 0;
+    sketch->depth = 0;
+    sketch->total = 0;
+}
+
+// the counter of key in every row
+static inline void count_min_cells(const count_min_t *sketch, int64_t key, size_t *cells)
+{
+    uint64_t hash = splitmix64_mix((uint64_t)key);
+    uint64_t h1 = hash & 0xFFFFFFFFU;
+    uint64_t h2 = (hash >> 32) | 1;
+
+    for (size_t row = 0; row < sketch->depth; row++)
+    {
+        cells[row] = row * sketch->width + (size_t)((h1 + row * h2) & (sketch->width - 1));
+    }
+}
+
+void count_min_add(count_min_t *sketch, int64_t key, uint64_t amount)
+{
+    size_t cells[COUNT_MIN_MAX_DEPTH];
+    count_min_cells(sketch, key, cells);
+
+    uint64_t estimate = UINT64_MAX;
+    for (size_t row = 0; row < sketch->depth; row++)
+    {
+        estimate = sketch->counters[cells[row]] < estimate ? sketch->counters[cells[row]] : estimate;
+    }
+
+    // conservative update: raise the counters below the new estimate to it, and no further
+    uint64_t target = estimate + amount;
+    for (size_t row = 0; row < sketch->depth; row++)
+    {
+        if (sketch->counters[cells[row]] < target)
+        {
+            sketch->counters[cells[row]] = target;
+        }
+    }
+
+    sketch->total += amount;
+}
+
+void count_min_add_all(count_min_t *sketch, const int64_t *keys, size_t len)
+{
+    for (size_t counter = 0; counter < len; counter++)
+    {
+        count_min_add(sketch, keys[counter], 1);
+    }
+}
+
+// an upper bound on the number of times key was added, usually exact for frequent keys
+uint64_t count_min_estimate(const count_min_t *sketch, int64_t key)
+{
+    size_t cells[COUNT_MIN_MAX_DEPTH];
+    count_min_cells(sketch, key, cells);
+
+    uint64_t estimate = UINT64_MAX;
+    for (size_t row = 0; row < sketch->depth; row++)
+    {
+        estimate = sketch->counters[cells[row]] < estimate ? sketch->counters[cells[row]] : estimate;
+    }
+    return estimate;
+}
+
+// adds source into sketch; false if their widths or depths differ
+bool count_min_merge(count_min_t *sketch, const count_min_t *source)
+{
+    if (!sketch || !source || sketch->width != source->width || sketch->depth != source->depth)
+    {
+        return false;
+    }
+
+    size_t cells = sketch->width * sketch->depth;
+    for (size_t cell = 0; cell < cells; cell++)
+    {
+        sketch->counters[cell] += source->counters[cell];
+    }
+
+    sketch->total += source->total;
+    return true;
+}
+
+size_t count_min_memory(const count_min_t *sketch)
+{
+    return sizeof(uint64_t) * sketch->width * sketch->depth;
+}
+
+#endif /* AC50772F_2C78_46AF_B54A_F88B2024FD70 */
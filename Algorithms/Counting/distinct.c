@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../IO/int_stream.h"
+#include "../IO/parallel_parser.h"
+#include "./hyperloglog.h"
+
+/*
+
+distinct [-p precision] [input ...]
+
+Estimates the number of distinct values in the inputs (text or .i64; - or no input at all
+reads standard input) in one pass, without keeping the values. Every input is read by its
+own thread into its own sketch, and the sketches are merged at the end. precision is between
+4 and 18 (default 14, about 0.8% error in 16 KB).
+
+*/
+
+#define DISTINCT_MAX_INPUTS PARALLEL_PARSE_MAX_THREADS // one thread each
+
+typedef struct
+{
+    const char *path;
+    hyperloglog_t sketch;
+    bool counted;
+} distinct_input_t;
+
+static bool add_to_sketch(void *context, const int64_t *values, size_t len)
+{
+    return hyperloglog_add_all((hyperloglog_t *)context, values, len);
+}
+
+static void *count_input(void *arg)
+{
+    distinct_input_t *input = (distinct_input_t *)arg;
+    input->counted = stream_int64_input(input->path, add_to_sketch, &input->sketch);
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    int precision = HLL_DEFAULT_PRECISION;
+    int first = 1;
+    if (argc > 2 && !strcmp(argv[1], "-p"))
+    {
+        // a number and nothing else, within the precisions the sketch supports
+        char *end = NULL;
+        bool digits = argv[2][0] >= '0' && argv[2][0] <= '9';
+        long parsed = digits ? strtol(argv[2], &end, 10) : 0;
+        if (!digits || *end || parsed < HLL_MIN_PRECISION || parsed > HLL_MAX_PRECISION)
+        {
+            fprintf(stderr, "invalid precision %s, expected %d to %d\n", argv[2], HLL_MIN_PRECISION, HLL_MAX_PRECISION);
+            return EXIT_FAILURE;
+        }
+        precision = (int)parsed;
+        first = 3;
+    }
+
+    static distinct_input_t inputs[DISTINCT_MAX_INPUTS];
+    static const char *standard_input = "-";
+    size_t count = argc > first ? (size_t)(argc - first) : 1;
+    if (count > DISTINCT_MAX_INPUTS)
+    {
+        fprintf(stderr, "too many inputs, %zu, at most %d\n", count, DISTINCT_MAX_INPUTS);
+        return EXIT_FAILURE;
+    }
+
+    for (size_t counter = 0; counter < count; counter++)
+    {
+        inputs[counter].path = argc > first ? argv[first + (int)counter] : standard_input;
+        if (!hyperloglog_init(&inputs[counter].sketch, precision))
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
+    run_workers(inputs, sizeof(inputs[0]), count, count_input);
+
+    bool counted = inputs[0].counted;
+    for (size_t counter = 1; counter < count; counter++)
+    {
+        counted = counted && inputs[counter].counted && hyperloglog_merge(&inputs[0].sketch, &inputs[counter].sketch);
+    }
+
+    if (counted)
+    {
+        printf("%.0f\n", hyperloglog_estimate(&inputs[0].sketch));
+    }
+
+    for (size_t counter = 0; counter < count; counter++)
+    {
+        hyperloglog_free(&inputs[counter].sketch);
+    }
+    return counted ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../IO/int_stream.h"
+#include "../IO/parallel_parser.h"
+#include "./count_min.h"
+#include "./space_saving.h"
+
+/*
+
+heavy_hitters [-k count] [input ...]
+
+Prints the count most frequent values of the inputs (text or .i64; - or no input at all
+reads standard input; default 10), one per line, most frequent first:
+
+    value   count   error   estimate
+
+count is the Space-Saving count, which is at least the true count and at most error more;
+estimate is the Count-Min estimate, another upper bound, which is often tighter. Every input
+is read by its own thread into its own sketches, which are merged at the end, and memory
+does not depend on the number of distinct values: HEAVY_HITTERS_COUNTERS_PER_RESULT
+Space-Saving counters per value printed, and a Count-Min sketch of the default size.
+
+*/
+
+#define HEAVY_HITTERS_MAX_INPUTS PARALLEL_PARSE_MAX_THREADS // one thread each
+#define HEAVY_HITTERS_DEFAULT_COUNT 10
+#define HEAVY_HITTERS_COUNTERS_PER_RESULT 16
+
+typedef struct
+{
+    const char *path;
+    space_saving_t summary;
+    count_min_t sketch;
+    bool counted;
+} heavy_hitters_input_t;
+
+static bool add_to_sketches(void *context, const int64_t *values, size_t len)
+{
+    heavy_hitters_input_t *input = (heavy_hitters_input_t *)context;
+    count_min_add_all(&input->sketch, values, len);
+    return space_saving_add_all(&input->summary, values, len);
+}
+
+static void *count_input(void *arg)
+{
+    heavy_hitters_input_t *input = (heavy_hitters_input_t *)arg;
+    input->counted = stream_int64_input(input->path, add_to_sketches, input);
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    size_t results = HEAVY_HITTERS_DEFAULT_COUNT;
+    int first = 1;
+    if (argc > 2 && !strcmp(argv[1], "-k"))
+    {
+        results = (size_t)atol(argv[2]);
+        first = 3;
+    }
+
+    static heavy_hitters_input_t inputs[HEAVY_HITTERS_MAX_INPUTS];
+    static const char *standard_input = "-";
+    size_t count = argc > first ? (size_t)(argc - first) : 1;
+    if (!results || count > HEAVY_HITTERS_MAX_INPUTS)
+    {
+        return EXIT_FAILURE;
+    }
+
+    for (size_t counter = 0; counter < count; counter++)
+    {
+        inputs[counter].path = argc > first ? argv[first + (int)counter] : standard_input;
+        if (!space_saving_init(&inputs[counter].summary, results * HEAVY_HITTERS_COUNTERS_PER_RESULT) ||
+            !count_min_init(&inputs[counter].sketch, 0, 0))
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
+    run_workers(inputs, sizeof(inputs[0]), count, count_input);
+
+    bool counted = inputs[0].counted;
+    for (size_t counter = 1; counter < count; counter++)
+    {
+        counted = counted && inputs[counter].counted &&
+                  space_saving_merge(&inputs[0].summary, &inputs[counter].summary) &&
+                  count_min_merge(&inputs[0].sketch, &inputs[counter].sketch);
+    }
+
+    space_saving_item_t *items = (space_saving_item_t *)malloc(sizeof(space_saving_item_t) * results);
+    if (counted && items)
+    {
+        size_t written = space_saving_top(&inputs[0].summary, items, results);
+        for (size_t counter = 0; counter < written; counter++)
+        {
+            printf("%lld\t%llu\t%llu\t%llu\n", (long long)items[counter].key, (unsigned long long)items[counter].count,
+                   (unsigned long long)items[counter].error,
+                   (unsigned long long)count_min_estimate(&inputs[0].sketch, items[counter].key));
+        }
+    }
+
+    free(items);
+    for (size_t counter = 0; counter < count; counter++)
+    {
+        space_saving_free(&inputs[counter].summary);
+        count_min_free(&inputs[counter].sketch);
+    }
+    return counted && items ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,297 @@
+#ifndef DD65E43C_3FC7_4CFB_943B_F940349AEE9F
+#define DD65E43C_3FC7_4CFB_943B_F940349AEE9F
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../IO/parallel_parser.h"
+#include "./presence_bitmap.h"
+
+/*
+
+A parallel histogram over int values in [0, range), that answers how many values are
+distinct, occur exactly once or more than once, and optionally how often each one occurs.
+
+Threads that increment shared counters either need atomics or fight over cache lines. Here
+the value range is instead cut into partitions, each owned by one thread, so no two threads
+ever write to the same cache line and the hot loops are plain increments:
+
+1. Every thread takes a slice of the input and counts how many of its values fall into each
+partition (a partition is a power-of-two-wide value range, so that is a shift).
+2. A prefix sum over the (thread, partition) counts gives every thread its own offset in
+every partition of a scatter buffer; the threads copy their values there.
+3. Every thread takes a partition and counts its values into its part of the output: the
+presence bitmap of presence_bitmap.h, or the caller's frequency array. Partitions are
+multiples of HISTOGRAM_PARTITION_ALIGN values wide, and their bounds fall on cache lines: the
+bitmap is allocated 64-byte aligned, and the caller's array need not be, so its partitions
+are shifted down by the values before its first cache line. They share no line in either.
+4. Each thread summarizes its partition; the summaries are added up at the end.
+
+Passes 1 and 2 read the input sequentially and write sequentially into a few hundred
+streams; pass 3 scatters into a range that is 1 / threads of the whole, and mostly cached.
+With a single thread, passes 1 and 2 are skipped and pass 3 reads the input directly.
+
+*/
+
+#define HISTOGRAM_PARTITION_ALIGN 512 // 1024 bits of bitmap, or 2 KB of frequencies
+#define HISTOGRAM_MIN_VALUES_PER_THREAD (1 << 16)
+
+typedef struct
+{
+    size_t distinct; // values that occur at least once
+    size_t once;     // values that occur exactly once
+    size_t repeated; // values that occur more than once
+} histogram_summary_t;
+
+typedef struct
+{
+    // passes 1 and 2: a slice of the input
+    const int *values;
+    size_t begin;
+    size_t end;
+    size_t range;
+    unsigned shift;
+    size_t skew; // value v is in partition (v + skew) >> shift
+    size_t partitions;
+    size_t *counts;  // this thread's row: values per partition, then write offsets
+    int *scattered;
+    bool valid;
+
+    // passes 3 and 4: one partition
+    const int *partition_values;
+    size_t partition_len;
+    size_t low;
+    size_t high;
+    presence_bitmap_t *bitmap;
+    uint32_t *frequencies;
+    histogram_summary_t summary;
+} histogram_task_t;
+
+static void *histogram_count_worker(void *arg)
+{
+    histogram_task_t *task = (histogram_task_t *)arg;
+    bool valid = true;
+
+    // the rows of neighbouring threads may share a cache line, so count on the stack
+    size_t counts[PARALLEL_PARSE_MAX_THREADS] = {0};
+    for (size_t counter = task->begin; counter < task->end; counter++)
+    {
+        size_t value = (size_t)(unsigned)task->values[counter];
+        valid &= (task->values[counter] >= 0) & (value < task->range);
+        counts[valid ? (value + task->skew) >> task->shift : 0]++;
+    }
+
+    memcpy(task->counts, counts, sizeof(size_t) * task->partitions);
+    task->valid = valid;
+    return NULL;
+}
+
+static void *histogram_scatter_worker(void *arg)
+{
+    histogram_task_t *task = (histogram_task_t *)arg;
+    size_t offsets[PARALLEL_PARSE_MAX_THREADS];
+    memcpy(offsets, task->counts, sizeof(size_t) * task->partitions);
+
+    for (size_t counter = task->begin; counter < task->end; counter++)
+    {
+        int value = task->values[counter];
+        task->scattered[offsets[((size_t)value + task->skew) >> task->shift]++] = value;
+    }
+
+    return NULL;
+}
+
+static void *histogram_partition_worker(void *arg)
+{
+    histogram_task_t *task = (histogram_task_t *)arg;
+    const int *values = task->partition_values;
+    histogram_summary_t *summary = &task->summary;
+
+    if (task->frequencies)
+    {
+        uint32_t *frequencies = task->frequencies;
+        for (size_t counter = 0; counter < task->partition_len; counter++)
+        {
+            frequencies[values[counter]]++;
+        }
+
+        memset(summary, 0, sizeof(*summary));
+        for (size_t value = task->low; value < task->high; value++)
+        {
+            summary->distinct += (frequencies[value] > 0);
+            summary->once += (frequencies[value] == 1);
+            summary->repeated += (frequencies[value] > 1);
+        }
+        return NULL;
+    }
+
+    for (size_t counter = 0; counter < task->partition_len; counter++)
+    {
+        presence_bitmap_add(task->bitmap, (size_t)values[counter]);
+    }
+
+    presence_bitmap_count_words(task->bitmap, task->low / 64, (task->high + 63) / 64,
+                                &summary->distinct, &summary->once, &summary->repeated);
+    return NULL;
+}
+
+/*
+
+Counts values[0, len), which must all lie in [0, range), on up to threads threads (0 picks
+one per online core). frequencies is either NULL or an array of range counters, which is
+overwritten with the number of occurrences of every value. Returns false when out of memory
+or when a value is out of range.
+
+*/
+
+bool histogram_count(const int *values, size_t len, size_t range, size_t threads, uint32_t *frequencies, histogram_summary_t *summary)
+{
+    if ((!values && len) || !summary)
+    {
+        return false;
+    }
+
+    if (!range)
+    {
+        memset(summary, 0, sizeof(*summary));
+        return !len;
+    }
+
+    if (!threads)
+    {
+        threads = default_parse_threads();
+    }
+    if (threads > PARALLEL_PARSE_MAX_THREADS)
+    {
+        threads = PARALLEL_PARSE_MAX_THREADS;
+    }
+    if (threads > len / HISTOGRAM_MIN_VALUES_PER_THREAD)
+    {
+        threads = len / HISTOGRAM_MIN_VALUES_PER_THREAD;
+    }
+    if (!threads)
+    {
+        threads = 1;
+    }
+
+    // the frequencies before the first cache line of the array; the bitmap starts on one
+    size_t skew = frequencies ? (size_t)((uintptr_t)frequencies % 64) / sizeof(uint32_t) : 0;
+
+    // the narrowest power-of-two partition that needs no more partitions than threads
+    unsigned shift = 0;
+    while (((size_t)1 << shift) < HISTOGRAM_PARTITION_ALIGN || ((range - 1 + skew) >> shift) + 1 > threads)
+    {
+        shift++;
+    }
+    size_t partitions = ((range - 1 + skew) >> shift) + 1;
+
+    presence_bitmap_t bitmap;
+    memset(&bitmap, 0, sizeof(bitmap));
+    if (frequencies)
+    {
+        memset(frequencies, 0, sizeof(uint32_t) * range);
+    }
+    else if (!presence_bitmap_init(&bitmap, range))
+    {
+        return false;
+    }
+
+    histogram_task_t tasks[PARALLEL_PARSE_MAX_THREADS];
+    memset(tasks, 0, sizeof(tasks));
+
+    size_t *counts = NULL;
+    int *scattered = NULL;
+    bool valid = true;
+
+    if (partitions == 1)
+    {
+        for (size_t counter = 0; counter < len && valid; counter++)
+        {
+            valid = values[counter] >= 0 && (size_t)values[counter] < range;
+        }
+
+        tasks[0].partition_values = values;
+        tasks[0].partition_len = len;
+        tasks[0].high = range;
+    }
+    else
+    {
+        counts = (size_t *)calloc(threads * partitions, sizeof(size_t));
+        scattered = (int *)malloc(sizeof(int) * len);
+        if (!counts || !scattered)
+        {
+            free(counts);
+            free(scattered);
+            presence_bitmap_free(&bitmap);
+            return false;
+        }
+
+        for (size_t thread = 0; thread < threads; thread++)
+        {
+            tasks[thread].values = values;
+            tasks[thread].begin = len / threads * thread;
+            tasks[thread].end = thread + 1 == threads ? len : len / threads * (thread + 1);
+            tasks[thread].range = range;
+            tasks[thread].shift = shift;
+            tasks[thread].skew = skew;
+            tasks[thread].partitions = partitions;
+            tasks[thread].counts = counts + thread * partitions;
+            tasks[thread].scattered = scattered;
+        }
+
+        run_workers(tasks, sizeof(histogram_task_t), threads, histogram_count_worker);
+        for (size_t thread = 0; thread < threads; thread++)
+        {
+            valid &= tasks[thread].valid;
+        }
+
+        // partition by partition, thread by thread: counts become write offsets
+        size_t offset = 0;
+        for (size_t partition = 0; valid && partition < partitions; partition++)
+        {
+            tasks[partition].partition_values = scattered + offset;
+            for (size_t thread = 0; thread < threads; thread++)
+            {
+                size_t count = counts[thread * partitions + partition];
+                counts[thread * partitions + partition] = offset;
+                offset += count;
+            }
+            tasks[partition].partition_len = (size_t)(scattered + offset - tasks[partition].partition_values);
+            tasks[partition].low = partition ? (partition << shift) - skew : 0;
+            tasks[partition].high = ((partition + 1) << shift) - skew < range ? ((partition + 1) << shift) - skew : range;
+        }
+
+        if (valid)
+        {
+            run_workers(tasks, sizeof(histogram_task_t), threads, histogram_scatter_worker);
+        }
+    }
+
+    if (valid)
+    {
+        for (size_t partition = 0; partition < partitions; partition++)
+        {
+            tasks[partition].bitmap = &bitmap;
+            tasks[partition].frequencies = frequencies;
+        }
+        run_workers(tasks, sizeof(histogram_task_t), partitions, histogram_partition_worker);
+
+        memset(summary, 0, sizeof(*summary));
+        for (size_t partition = 0; partition < partitions; partition++)
+        {
+            summary->distinct += tasks[partition].summary.distinct;
+            summary->once += tasks[partition].summary.once;
+            summary->repeated += tasks[partition].summary.repeated;
+        }
+    }
+
+    free(counts);
+    free(scattered);
+    presence_bitmap_free(&bitmap);
+    return valid;
+}
+
+#endif /* DD65E43C_3FC7_4CFB_943B_F940349AEE9F */
@@ -0,0 +1,403 @@
+#ifndef E6EDD1FB_4951_4B04_9CF4_6C181D66F74C
+#define E6EDD1FB_4951_4B04_9CF4_6C181D66F74C
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../IO/hash_mix.h"
+#include "../Sorting/sort_template.h"
+
+/*
+
+Exact distinct counting needs memory for every distinct key. When an answer within about 1%
+is enough, a HyperLogLog sketch counts billions of keys in one pass and a few KB.
+
+Every key is hashed to 64 bits. The top p bits pick one of m = 2^p registers, and the
+register keeps the maximum, over all its keys, of the position of the first 1 bit in the
+remaining 64 - p bits (rho). Many distinct keys make long runs of zeros likely, so the
+registers together estimate the cardinality with a relative standard error of 1.04 / sqrt(m):
+0.81% for the default p = 14, whose 16384 one-byte registers take 16 KB.
+
+Like HyperLogLog++, the sketch starts sparse: as long as few keys were seen, it stores
+(index, rho) pairs at the higher precision 25 in a sorted list of 32-bit entries, which is
+far smaller than the registers and nearly exact (linear counting over 2^25 buckets). New
+entries go to an unsorted buffer first, which is sorted and merged into the list when it
+fills up. Once the list would take more memory than the registers, the sketch converts to
+the dense form; an entry at precision 25 carries enough bits to compute its dense register
+and rho exactly.
+
+The dense estimate is Ertl's improved estimator, computed from the histogram of register
+values. It needs neither the bias tables of HyperLogLog++ nor a switch to linear counting
+for small cardinalities.
+
+Sketches of the same precision merge by taking the maximum of every register (or by
+merging the sparse lists), so per-thread or per-file sketches combine into the sketch of
+the union. hyperloglog_add_all hashes blocks of keys in a separate, branch-free loop that
+the compiler can vectorize (AVX-512 has the 64-bit multiplies it needs) before it updates
+the registers.
+
+*/
+
+#define HLL_MIN_PRECISION 4
+#define HLL_MAX_PRECISION 18
+#define HLL_DEFAULT_PRECISION 14
+#define HLL_SPARSE_PRECISION 25
+#define HLL_PENDING_ENTRIES 1024
+#define HLL_HASH_BLOCK 256
+
+typedef struct
+{
+    int precision;
+    bool sparse;
+    uint8_t *registers; // 2^precision of them, once dense
+    uint32_t *entries;  // sorted sparse entries, (index << 6) | rho at precision 25
+    size_t entry_len;
+    size_t entry_capacity;
+    uint32_t pending[HLL_PENDING_ENTRIES];
+    size_t pending_len;
+} hyperloglog_t;
+
+#define HLL_ENTRY_LESS(a, b) ((a) < (b))
+DEFINE_SORT(hll_sort_entries, uint32_t, HLL_ENTRY_LESS)
+
+static inline uint64_t hll_hash(int64_t key)
+{
+    return fmix64((uint64_t)key);
+}
+
+// position of the first 1 bit among the bits of hash after the top precision, counting from 1
+static inline uint8_t hll_rho(uint64_t hash, int precision)
+{
+    uint64_t rest = hash << precision;
+    return rest ? (uint8_t)(__builtin_clzll(rest) + 1) : (uint8_t)(64 - precision + 1);
+}
+
+static inline uint32_t hll_sparse_entry(uint64_t hash)
+{
+    return (uint32_t)(hash >> (64 - HLL_SPARSE_PRECISION)) << 6 | hll_rho(hash, HLL_SPARSE_PRECISION);
+}
+
+// precision = 0 picks HLL_DEFAULT_PRECISION
+bool hyperloglog_init(hyperloglog_t *sketch, int precision)
+{
+    if (!sketch)
+    {
+        return false;
+    }
+
+    if (!precision)
+    {
+        precision = HLL_DEFAULT_PRECISION;
+    }
+    if (precision < HLL_MIN_PRECISION || precision > HLL_MAX_PRECISION)
+    {
+        return false;
+    }
+
+    sketch->precision = precision;
+    sketch->sparse = true;
+    sketch->registers = NULL;
+    sketch->entries = NULL;
+    sketch->entry_len = 0;
+    sketch->entry_capacity = 0;
+    sketch->pending_len = 0;
+    return true;
+}
+
+void hyperloglog_free(hyperloglog_t *sketch)
+{
+    if (!sketch)
+    {
+        return;
+    }
+
+    free(sketch->registers);
+    free(sketch->entries);
+    sketch->registers = NULL;
+    sketch->entries = NULL;
+    sketch->entry_len = 0;
+    sketch->entry_capacity = 0;
+    sketch->pending_len = 0;
+}
+
+static inline void hll_dense_update(uint8_t *registers, uint32_t index, uint8_t rho)
+{
+    registers[index] = rho > registers[index] ? rho : registers[index];
+}
+
+// the dense register and rho that a sparse entry stands for
+static inline void hll_dense_update_entry(uint8_t *registers, int precision, uint32_t entry)
+{
+    uint32_t sparse_index = entry >> 6;
+    uint32_t index = sparse_index >> (HLL_SPARSE_PRECISION - precision);
+    uint32_t low_bits = sparse_index & ((1U << (HLL_SPARSE_PRECISION - precision)) - 1);
+
+    // the bits between the two precisions come first in the dense rho
+    uint8_t rho = low_bits ? (uint8_t)(__builtin_clz(low_bits) - (32 - (HLL_SPARSE_PRECISION - precision)) + 1)
+                           : (uint8_t)((entry & 63) + (HLL_SPARSE_PRECISION - precision));
+    hll_dense_update(registers, index, rho);
+}
+
+static bool hll_to_dense(hyperloglog_t *sketch)
+{
+    uint8_t *registers = (uint8_t *)calloc((size_t)1 << sketch->precision, 1);
+    if (!registers)
+    {
+        return false;
+    }
+
+    for (size_t counter = 0; counter < sketch->entry_len; counter++)
+    {
+        hll_dense_update_entry(registers, sketch->precision, sketch->entries[counter]);
+    }
+    for (size_t counter = 0; counter < sketch->pending_len; counter++)
+    {
+        hll_dense_update_entry(registers, sketch->precision, sketch->pending[counter]);
+    }
+
+    free(sketch->entries);
+    sketch->entries = NULL;
+    sketch->entry_len = 0;
+    sketch->entry_capacity = 0;
+    sketch->pending_len = 0;
+    sketch->registers = registers;
+    sketch->sparse = false;
+    return true;
+}
+
+// merges the pending entries into the sorted list, keeping the largest rho per index
+static bool hll_flush_pending(hyperloglog_t *sketch)
+{
+    if (!sketch->sparse || !sketch->pending_len)
+    {
+        return true;
+    }
+
+    hll_sort_entries(sketch->pending, sketch->pending_len);
+
+    size_t needed = sketch->entry_len + sketch->pending_len;
+    if (needed * sizeof(uint32_t) > ((size_t)1 << sketch->precision))
+    {
+        return hll_to_dense(sketch);
+    }
+
+    uint32_t *merged = (uint32_t *)malloc(sizeof(uint32_t) * needed);
+    if (!merged)
+    {
+        return false;
+    }
+
+    // entries sort by index, then rho, so the last entry of an index has its largest rho
+    size_t len = 0;
+    size_t left = 0;
+    size_t right = 0;
+    while (left < sketch->entry_len || right < sketch->pending_len)
+    {
+        uint32_t next;
+        if (right == sketch->pending_len || (left < sketch->entry_len && sketch->entries[left] < sketch->pending[right]))
+        {
+            next = sketch->entries[left++];
+        }
+        else
+        {
+            next = sketch->pending[right++];
+        }
+
+        if (len && (merged[len - 1] >> 6) == (next >> 6))
+        {
+            merged[len - 1] = next;
+        }
+        else
+        {
+            merged[len++] = next;
+        }
+    }
+
+    free(sketch->entries);
+    sketch->entries = merged;
+    sketch->entry_len = len;
+    sketch->entry_capacity = needed;
+    sketch->pending_len = 0;
+    return true;
+}
+
+static inline bool hll_add_hash(hyperloglog_t *sketch, uint64_t hash)
+{
+    if (!sketch->sparse)
+    {
+        hll_dense_update(sketch->registers, (uint32_t)(hash >> (64 - sketch->precision)), hll_rho(hash, sketch->precision));
+        return true;
+    }
+
+    sketch->pending[sketch->pending_len++] = hll_sparse_entry(hash);
+    return sketch->pending_len < HLL_PENDING_ENTRIES || hll_flush_pending(sketch);
+}
+
+bool hyperloglog_add(hyperloglog_t *sketch, int64_t key)
+{
+    return hll_add_hash(sketch, hll_hash(key));
+}
+
+bool hyperloglog_add_all(hyperloglog_t *sketch, const int64_t *keys, size_t len)
+{
+    uint64_t hashes[HLL_HASH_BLOCK];
+
+    for (size_t start = 0; start < len; start += HLL_HASH_BLOCK)
+    {
+        size_t block = len - start < HLL_HASH_BLOCK ? len - start : HLL_HASH_BLOCK;
+        for (size_t counter = 0; counter < block; counter++)
+        {
+            hashes[counter] = hll_hash(keys[start + counter]);
+        }
+
+        if (!sketch->sparse)
+        {
+            int precision = sketch->precision;
+            uint8_t *registers = sketch->registers;
+            for (size_t counter = 0; counter < block; counter++)
+            {
+                hll_dense_update(registers, (uint32_t)(hashes[counter] >> (64 - precision)), hll_rho(hashes[counter], precision));
+            }
+            continue;
+        }
+
+        for (size_t counter = 0; counter < block; counter++)
+        {
+            if (!hll_add_hash(sketch, hashes[counter]))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// adds everything counted by source to sketch; both must have the same precision
+bool hyperloglog_merge(hyperloglog_t *sketch, hyperloglog_t *source)
+{
+    if (sketch->precision != source->precision || !hll_flush_pending(source))
+    {
+        return false;
+    }
+
+    if (source->sparse)
+    {
+        for (size_t counter = 0; counter < source->entry_len; counter++)
+        {
+            if (!sketch->sparse)
+            {
+                hll_dense_update_entry(sketch->registers, sketch->precision, source->entries[counter]);
+                continue;
+            }
+
+            sketch->pending[sketch->pending_len++] = source->entries[counter];
+            if (sketch->pending_len == HLL_PENDING_ENTRIES && !hll_flush_pending(sketch))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    if (sketch->sparse && !hll_to_dense(sketch))
+    {
+        return false;
+    }
+
+    for (size_t index = 0; index < ((size_t)1 << sketch->precision); index++)
+    {
+        hll_dense_update(sketch->registers, (uint32_t)index, source->registers[index]);
+    }
+    return true;
+}
+
+static double hll_sigma(double x)
+{
+    if (x == 1.0)
+    {
+        return INFINITY;
+    }
+
+    double y = 1.0;
+    double z = x;
+    double previous;
+    do
+    {
+        x *= x;
+        previous = z;
+        z += x * y;
+        y += y;
+    } while (z != previous);
+
+    return z;
+}
+
+static double hll_tau(double x)
+{
+    if (x == 0.0 || x == 1.0)
+    {
+        return 0.0;
+    }
+
+    double y = 1.0;
+    double z = 1.0 - x;
+    double previous;
+    do
+    {
+        x = sqrt(x);
+        previous = z;
+        y *= 0.5;
+        z -= (1.0 - x) * (1.0 - x) * y;
+    } while (z != previous);
+
+    return z / 3.0;
+}
+
+// estimated number of distinct keys added so far
+double hyperloglog_estimate(hyperloglog_t *sketch)
+{
+    if (!hll_flush_pending(sketch))
+    {
+        return -1.0;
+    }
+
+    if (sketch->sparse)
+    {
+        // linear counting over the 2^25 buckets of the sparse precision
+        double buckets = (double)((uint64_t)1 << HLL_SPARSE_PRECISION);
+        return buckets * log(buckets / (buckets - (double)sketch->entry_len));
+    }
+
+    int precision = sketch->precision;
+    int q = 64 - precision;
+    size_t m = (size_t)1 << precision;
+
+    double histogram[64 + 2] = {0};
+    for (size_t index = 0; index < m; index++)
+    {
+        histogram[sketch->registers[index]] += 1.0;
+    }
+
+    double registers = (double)m;
+    double z = registers * hll_tau(1.0 - histogram[q + 1] / registers);
+    for (int value = q; value >= 1; value--)
+    {
+        z = 0.5 * (z + histogram[value]);
+    }
+    z += registers * hll_sigma(histogram[0] / registers);
+
+    return registers * registers / (2.0 * log(2.0) * z);
+}
+
+// bytes used by the sketch, beyond the hyperloglog_t itself
+size_t hyperloglog_memory(const hyperloglog_t *sketch)
+{
+    return sketch->sparse ? sizeof(uint32_t) * sketch->entry_capacity : (size_t)1 << sketch->precision;
+}
+
+#endif /* E6EDD1FB_4951_4B04_9CF4_6C181D66F74C */
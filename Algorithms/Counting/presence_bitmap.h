@@ -0,0 +1,150 @@
+#ifndef F1A95262_1CEE_46F6_AE5C_23B16638F8F6
+#define F1A95262_1CEE_46F6_AE5C_23B16638F8F6
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+
+Counting how many values occur exactly once does not need a full counter per value: the only
+states that matter are "not seen", "seen once" and "seen more than once". The presence
+bitmap keeps that saturating 2-bit state as two bit planes,
+
+    seen      set by the first occurrence of a value
+    repeated  set by every further occurrence
+
+so adding a value is two bit operations without a branch, and the answers are popcounts:
+
+    distinct values      popcount(seen)
+    values seen once     popcount(seen & ~repeated)
+    repeated values      popcount(repeated)
+
+The planes are interleaved word by word, so both bits of a value share one cache line and an
+add costs at most one miss. For values in [0, 10^7) the bitmap takes 2.5 MB instead of the
+40 MB of an int counter per value, which fits in the last level cache. The planes start on
+a cache line, so threads that own disjoint blocks of 512 values never share a line.
+
+*/
+
+typedef struct
+{
+    uint64_t *planes; // planes[2w] holds seen, planes[2w + 1] repeated, for values [64w, 64w + 64)
+    size_t range;
+    size_t words;
+} presence_bitmap_t;
+
+// values must lie in [0, range)
+bool presence_bitmap_init(presence_bitmap_t *bitmap, size_t range)
+{
+    if (!bitmap)
+    {
+        return false;
+    }
+
+    bitmap->range = range;
+    bitmap->words = (range + 63) / 64;
+    size_t bytes = (sizeof(uint64_t) * 2 * bitmap->words + 63) / 64 * 64;
+    bitmap->planes = (uint64_t *)aligned_alloc(64, bytes ? bytes : 64);
+    if (!bitmap->planes)
+    {
+        return false;
+    }
+
+    memset(bitmap->planes, 0, bytes);
+    return true;
+}
+
+void presence_bitmap_free(presence_bitmap_t *bitmap)
+{
+    if (!bitmap)
+    {
+        return;
+    }
+
+    free(bitmap->planes);
+    bitmap->planes = NULL;
+    bitmap->range = 0;
+    bitmap->words = 0;
+}
+
+static inline void presence_bitmap_add(presence_bitmap_t *bitmap, size_t value)
+{
+    uint64_t *pair = bitmap->planes + 2 * (value / 64);
+    uint64_t bit = (uint64_t)1 << (value % 64);
+
+    pair[1] |= pair[0] & bit;
+    pair[0] |= bit;
+}
+
+// false if a value lies outside [0, range); the values before it have been added
+bool presence_bitmap_add_all(presence_bitmap_t *bitmap, const int *values, size_t len)
+{
+    for (size_t counter = 0; counter < len; counter++)
+    {
+        if (values[counter] < 0 || (size_t)values[counter] >= bitmap->range)
+        {
+            return false;
+        }
+        presence_bitmap_add(bitmap, (size_t)values[counter]);
+    }
+
+    return true;
+}
+
+size_t presence_bitmap_count_distinct(const presence_bitmap_t *bitmap)
+{
+    size_t count = 0;
+    for (size_t word = 0; word < bitmap->words; word++)
+    {
+        count += (size_t)__builtin_popcountll(bitmap->planes[2 * word]);
+    }
+
+    return count;
+}
+
+size_t presence_bitmap_count_once(const presence_bitmap_t *bitmap)
+{
+    size_t count = 0;
+    for (size_t word = 0; word < bitmap->words; word++)
+    {
+        count += (size_t)__builtin_popcountll(bitmap->planes[2 * word] & ~bitmap->planes[2 * word + 1]);
+    }
+
+    return count;
+}
+
+size_t presence_bitmap_count_repeated(const presence_bitmap_t *bitmap)
+{
+    size_t count = 0;
+    for (size_t word = 0; word < bitmap->words; word++)
+    {
+        count += (size_t)__builtin_popcountll(bitmap->planes[2 * word + 1]);
+    }
+
+    return count;
+}
+
+// all three counts at once, over the values [64 first_word, 64 last_word)
+void presence_bitmap_count_words(const presence_bitmap_t *bitmap, size_t first_word, size_t last_word, size_t *distinct, size_t *once, size_t *repeated)
+{
+    size_t seen_count = 0;
+    size_t once_count = 0;
+    size_t repeated_count = 0;
+    for (size_t word = first_word; word < last_word; word++)
+    {
+        uint64_t seen = bitmap->planes[2 * word];
+        uint64_t again = bitmap->planes[2 * word + 1];
+        seen_count += (size_t)__builtin_popcountll(seen);
+        once_count += (size_t)__builtin_popcountll(seen & ~again);
+        repeated_count += (size_t)__builtin_popcountll(again);
+    }
+
+    *distinct = seen_count;
+    *once = once_count;
+    *repeated = repeated_count;
+}
+
+#endif /* F1A95262_1CEE_46F6_AE5C_23B16638F8F6 */
@@ -0,0 +1,405 @@
+#ifndef C72BAF59_A6FA_4E32_8752_E4020A40E568
+#define C72BAF59_A6FA_4E32_8752_E4020A40E568
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Sorting/sort_template.h"
+#include "./swiss_table.h"
+
+/*
+
+Space-Saving finds the most frequent keys of a stream with k counters, however many distinct
+keys the stream has (Metwally, Agrawal and El Abbadi).
+
+Every counter holds a key, a count and an error. A key that has a counter gets its count
+incremented. A key that has none takes over the counter with the smallest count m: its count
+becomes m + 1 and its error m, since the key may have occurred up to m times before, while
+its counter belonged to others. Therefore:
+
+- every count is at least the true count of its key, and at most error more;
+- the smallest count is at most n / k after n keys, so any key that occurs more than n / k
+times is certain to have a counter.
+
+Finding the smallest count must be cheap, which the stream-summary list makes it: counters
+with equal counts share a bucket, and the buckets form a doubly linked list in increasing
+order of count. An increment moves a counter from its bucket to the next one, creating that
+bucket if the next one holds a larger count, and releasing the old one if it is left empty;
+the counter to evict is the first of the head bucket. Both are O(1). The counters and buckets
+live in two arrays allocated once, linked by index (SPACE_SAVING_NONE ends a list), and a
+swiss table maps every key to its counter.
+
+Weighted adds move a counter over several buckets, at most one per counter.
+
+Summaries of the same capacity merge like mergeable summaries (Agarwal et al.): a key counted
+by one summary only may have occurred up to the smallest count of the other, so that smallest
+count is added to both its count and its error. The k largest of the combined counters are
+kept, and the list is rebuilt from them in one pass. The guarantees above then hold for the
+combined stream.
+
+*/
+
+#define SPACE_SAVING_NONE SIZE_MAX
+
+typedef struct
+{
+    int64_t key;
+    uint64_t count; // at least the number of times key occurred
+    uint64_t error; // at most count - the number of times key occurred
+} space_saving_item_t;
+
+typedef struct
+{
+    int64_t key;
+    uint64_t error;
+    size_t bucket;
+    size_t prev; // counters of the same bucket
+    size_t next;
+} space_saving_counter_t;
+
+typedef struct
+{
+    uint64_t count;
+    size_t first; // counter
+    size_t prev;  // buckets, in increasing order of count
+    size_t next;
+} space_saving_bucket_t;
+
+typedef struct
+{
+    space_saving_counter_t *counters;
+    space_saving_bucket_t *buckets;
+    swiss_table_t index; // key -> counter, in the slot's count
+    size_t capacity;     // counters
+    size_t size;         // counters in use
+    size_t head;         // bucket with the smallest count
+    size_t tail;         // bucket with the largest count
+    size_t free_bucket;
+    uint64_t total; // sum of all amounts added
+} space_saving_t;
+
+#define SPACE_SAVING_ITEM_MORE(a, b) ((a).count > (b).count)
+DEFINE_SORT(space_saving_sort_items, space_saving_item_t, SPACE_SAVING_ITEM_MORE)
+
+bool space_saving_init(space_saving_t *summary, size_t capacity)
+{
+    if (!summary || !capacity)
+    {
+        return false;
+    }
+
+    // an increment takes its new bucket before it releases the old one
+    summary->counters = (space_saving_counter_t *)malloc(sizeof(space_saving_counter_t) * capacity);
+    summary->buckets = (space_saving_bucket_t *)malloc(sizeof(space_saving_bucket_t) * (capacity + 1));
+    if (!summary->counters || !summary->buckets || !swiss_table_init(&summary->index, capacity))
+    {
+        free(summary->counters);
+        free(summary->buckets);
+        summary->counters = NULL;
+        summary->buckets = NULL;
+        return false;
+    }
+
+    for (size_t bucket = 0; bucket <= capacity; bucket++)
+    {
+        summary->buckets[bucket].next = bucket < capacity ? bucket + 1 : SPACE_SAVING_NONE;
+    }
+
+    summary->capacity = capacity;
+    summary->size = 0;
+    summary->head = SPACE_SAVING_NONE;
+    summary->tail = SPACE_SAVING_NONE;
+    summary->free_bucket = 0;
+    summary->total = 0;
+    return true;
+}
+
+void space_saving_free(space_saving_t *summary)
+{
+    if (!summary)
+    {
+        return;
+    }
+
+    free(summary->counters);
+    free(summary->buckets);
+    swiss_table_free(&summary->index);
+    summary->counters = NULL;
+    summary->buckets = NULL;
+    summary->capacity = 0;
+    summary->size = 0;
+    summary->head = SPACE_SAVING_NONE;
+    summary->tail = SPACE_SAVING_NONE;
+}
+
+// a new bucket of count, linked in between before and after
+static size_t space_saving_new_bucket(space_saving_t *summary, uint64_t count, size_t before, size_t after)
+{
+    size_t bucket = summary->free_bucket;
+    space_saving_bucket_t *buckets = summary->buckets;
+    summary->free_bucket = buckets[bucket].next;
+
+    buckets[bucket].count = count;
+    buckets[bucket].first = SPACE_SAVING_NONE;
+    buckets[bucket].prev = before;
+    buckets[bucket].next = after;
+    *(before == SPACE_SAVING_NONE ? &summary->head : &buckets[before].next) = bucket;
+    *(after == SPACE_SAVING_NONE ? &summary->tail : &buckets[after].prev) = bucket;
+    return bucket;
+}
+
+static void space_saving_release_bucket(space_saving_t *summary, size_t bucket)
+{
+    space_saving_bucket_t *buckets = summary->buckets;
+    size_t before = buckets[bucket].prev;
+    size_t after = buckets[bucket].next;
+    *(before == SPACE_SAVING_NONE ? &summary->head : &buckets[before].next) = after;
+    *(after == SPACE_SAVING_NONE ? &summary->tail : &buckets[after].prev) = before;
+
+    buckets[bucket].next = summary->free_bucket;
+    summary->free_bucket = bucket;
+}
+
+// makes counter the first of bucket
+static void space_saving_attach(space_saving_t *summary, size_t counter, size_t bucket)
+{
+    space_saving_counter_t *counters = summary->counters;
+    space_saving_bucket_t *buckets = summary->buckets;
+
+    counters[counter].bucket = bucket;
+    counters[counter].prev = SPACE_SAVING_NONE;
+    counters[counter].next = buckets[bucket].first;
+    if (buckets[bucket].first != SPACE_SAVING_NONE)
+    {
+        counters[buckets[bucket].first].prev = counter;
+    }
+    buckets[bucket].first = counter;
+}
+
+// moves counter from its bucket (SPACE_SAVING_NONE for a new counter) amount counts up
+static void space_saving_increment(space_saving_t *summary, size_t counter, uint64_t amount)
+{
+    space_saving_counter_t *counters = summary->counters;
+    space_saving_bucket_t *buckets = summary->buckets;
+    size_t old = counters[counter].bucket;
+    uint64_t count = (old == SPACE_SAVING_NONE ? 0 : buckets[old].count) + amount;
+
+    // the last bucket whose count is at most the new one; with unit increments, one step
+    size_t before = old;
+    size_t after = old == SPACE_SAVING_NONE ? summary->head : buckets[old].next;
+    while (after != SPACE_SAVING_NONE && buckets[after].count <= count)
+    {
+        before = after;
+        after = buckets[after].next;
+    }
+
+    size_t target = before;
+    if (before == SPACE_SAVING_NONE || buckets[before].count != count)
+    {
+        target = space_saving_new_bucket(summary, count, before, after);
+    }
+
+    if (old != SPACE_SAVING_NONE)
+    {
+        size_t prev = counters[counter].prev;
+        size_t next = counters[counter].next;
+        *(prev == SPACE_SAVING_NONE ? &buckets[old].first : &counters[prev].next) = next;
+        if (next != SPACE_SAVING_NONE)
+        {
+            counters[next].prev = prev;
+        }
+    }
+
+    space_saving_attach(summary, counter, target);
+
+    if (old != SPACE_SAVING_NONE && buckets[old].first == SPACE_SAVING_NONE)
+    {
+        space_saving_release_bucket(summary, old);
+    }
+}
+
+// counts key amount times more; false when out of memory
+bool space_saving_add(space_saving_t *summary, int64_t key, uint64_t amount)
+{
+    if (!amount)
+    {
+        return true;
+    }
+
+    summary->total += amount;
+
+    size_t slot = swiss_table_find(&summary->index, key);
+    if (slot != summary->index.capacity)
+    {
+        space_saving_increment(summary, (size_t)summary->index.slots[slot].count, amount);
+        return true;
+    }
+
+    size_t counter = summary->size;
+    uint64_t error = 0;
+    if (summary->size < summary->capacity)
+    {
+        summary->counters[counter].bucket = SPACE_SAVING_NONE;
+        summary->size++;
+    }
+    else
+    {
+        // take over the first counter with the smallest count, and inherit that count as error
+        counter = summary->buckets[summary->head].first;
+        error = summary->buckets[summary->head].count;
+        swiss_table_erase(&summary->index, summary->counters[counter].key);
+    }
+
+    summary->counters[counter].key = key;
+    summary->counters[counter].error = error;
+    space_saving_increment(summary, counter, amount);
+    return swiss_table_add(&summary->index, key, counter);
+}
+
+bool space_saving_add_all(space_saving_t *summary, const int64_t *keys, size_t len)
+{
+    for (size_t counter = 0; counter < len; counter++)
+    {
+        if (!space_saving_add(summary, keys[counter], 1))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// the counter of key, if it has one; keys without one occurred at most the smallest count times
+bool space_saving_find(const space_saving_t *summary, int64_t key, space_saving_item_t *item)
+{
+    size_t slot = swiss_table_find(&summary->index, key);
+    if (slot == summary->index.capacity)
+    {
+        return false;
+    }
+
+    const space_saving_counter_t *counter = summary->counters + summary->index.slots[slot].count;
+    item->key = key;
+    item->count = summary->buckets[counter->bucket].count;
+    item->error = counter->error;
+    return true;
+}
+
+// smallest count of all counters, 0 while some are unused
+uint64_t space_saving_min_count(const space_saving_t *summary)
+{
+    return summary->size < summary->capacity ? 0 : summary->buckets[summary->head].count;
+}
+
+// replaces the counters by items, which are sorted by decreasing count and at most capacity
+static bool space_saving_rebuild(space_saving_t *summary, const space_saving_item_t *items, size_t len)
+{
+    swiss_table_clear(&summary->index);
+    for (size_t bucket = 0; bucket <= summary->capacity; bucket++)
+    {
+        summary->buckets[bucket].next = bucket < summary->capacity ? bucket + 1 : SPACE_SAVING_NONE;
+    }
+    summary->free_bucket = 0;
+    summary->head = SPACE_SAVING_NONE;
+    summary->tail = SPACE_SAVING_NONE;
+    summary->size = 0;
+
+    // smallest first, so every counter goes to the tail bucket or a new one after it
+    for (size_t item = len; item-- > 0;)
+    {
+        size_t counter = summary->size++;
+        size_t bucket = summary->tail;
+        if (bucket == SPACE_SAVING_NONE || summary->buckets[bucket].count != items[item].count)
+        {
+            bucket = space_saving_new_bucket(summary, items[item].count, summary->tail, SPACE_SAVING_NONE);
+        }
+
+        summary->counters[counter].key = items[item].key;
+        summary->counters[counter].error = items[item].error;
+        space_saving_attach(summary, counter, bucket);
+        if (!swiss_table_add(&summary->index, items[item].key, counter))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// merges source into summary; false if their capacities differ or when out of memory
+bool space_saving_merge(space_saving_t *summary, const space_saving_t *source)
+{
+    if (!summary || !source || summary->capacity != source->capacity)
+    {
+        return false;
+    }
+
+    space_saving_item_t *items = (space_saving_item_t *)malloc(sizeof(space_saving_item_t) * (summary->size + source->size + 1));
+    if (!items)
+    {
+        return false;
+    }
+
+    // the counters in use are always the first size ones
+    uint64_t summary_min = space_saving_min_count(summary);
+    uint64_t source_min = space_saving_min_count(source);
+    size_t len = 0;
+    space_saving_item_t other;
+
+    for (size_t counter = 0; counter < summary->size; counter++)
+    {
+        const space_saving_counter_t *own = summary->counters + counter;
+        bool shared = space_saving_find(source, own->key, &other);
+        items[len].key = own->key;
+        items[len].count = summary->buckets[own->bucket].count + (shared ? other.count : source_min);
+        items[len].error = own->error + (shared ? other.error : source_min);
+        len++;
+    }
+
+    for (size_t counter = 0; counter < source->size; counter++)
+    {
+        const space_saving_counter_t *added = source->counters + counter;
+        if (!space_saving_find(summary, added->key, &other))
+        {
+            items[len].key = added->key;
+            items[len].count = source->buckets[added->bucket].count + summary_min;
+            items[len].error = added->error + summary_min;
+            len++;
+        }
+    }
+
+    space_saving_sort_items(items, len);
+    bool rebuilt = space_saving_rebuild(summary, items, len < summary->capacity ? len : summary->capacity);
+    summary->total += source->total;
+    free(items);
+    return rebuilt;
+}
+
+// writes up to count items, by decreasing count, and returns how many it wrote
+size_t space_saving_top(const space_saving_t *summary, space_saving_item_t *items, size_t count)
+{
+    size_t written = 0;
+    for (size_t bucket = summary->tail; bucket != SPACE_SAVING_NONE && written < count; bucket = summary->buckets[bucket].prev)
+    {
+        for (size_t counter = summary->buckets[bucket].first; counter != SPACE_SAVING_NONE && written < count; counter = summary->counters[counter].next)
+        {
+            items[written].key = summary->counters[counter].key;
+            items[written].count = summary->buckets[bucket].count;
+            items[written].error = summary->counters[counter].error;
+            written++;
+        }
+    }
+
+    return written;
+}
+
+size_t space_saving_memory(const space_saving_t *summary)
+{
+    return sizeof(space_saving_counter_t) * summary->capacity + sizeof(space_saving_bucket_t) * (summary->capacity + 1) +
+           (sizeof(swiss_slot_t) + 1) * summary->index.capacity;
+}
+
+#endif /* C72BAF59_A6FA_4E32_8752_E4020A40E568 */
@@ -0,0 +1,404 @@
+#ifndef FCC85117_1322_4B31_99D4_3FA9F6A92171
+#define FCC85117_1322_4B31_99D4_3FA9F6A92171
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../IO/hash_mix.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+
+The presence bitmap and the histogram need the values to come from a small range. Keys that
+span 64 bits need a hash table, and counting them touches the table once per key, so the
+table has to be fast on exactly that: insert-or-increment.
+
+The swiss table is an open-addressing table whose slots come in groups of 16, each with
+16 control bytes stored apart from the slots:
+
+    0x80        empty
+    0xFE        deleted (a tombstone, so that probe chains stay intact)
+    0x00-0x7F   full; the low 7 bits are the top 7 bits of the key's hash (h2)
+
+The rest of the hash (h1) picks the first group to probe; groups are probed in triangular
+steps, which visits every group once because the group count is a power of two. Inside a
+group, one SSE2 compare of the 16 control bytes against h2 gives the candidate slots as a
+bit mask, so most lookups compare one key, and most misses compare none: a second compare
+against "empty" ends the probe. Without SSE2 the 16 bytes are compared in a loop.
+
+The hash is the splitmix64 finalizer (hash_mix.h), in which every bit of the key affects
+every bit of the hash. A multiplication alone would carry key bits only upward, and keys that
+differ only in their high bits, such as i << 48, would all start probing in the same groups.
+
+The table keeps its load at most 7/8 and doubles when it reaches it, so its memory follows
+the number of distinct keys, not the number of keys counted. swiss_table_add_all prefetches
+the groups of the keys SWISS_PREFETCH_DISTANCE places ahead, which lets the cache misses of
+a bulk insert overlap; callers that know the number of distinct keys can also reserve.
+
+*/
+
+#define SWISS_GROUP_WIDTH 16
+#define SWISS_EMPTY 0x80
+#define SWISS_DELETED 0xFE
+#define SWISS_PREFETCH_DISTANCE 16
+
+typedef struct
+{
+    int64_t key;
+    uint64_t count;
+} swiss_slot_t;
+
+typedef struct
+{
+    uint8_t *ctrl;
+    swiss_slot_t *slots;
+    size_t capacity;    // slots, a power of two and a multiple of SWISS_GROUP_WIDTH
+    size_t size;        // full slots
+    size_t growth_left; // inserts into empty slots before the table has to grow
+} swiss_table_t;
+
+static inline uint64_t swiss_hash(int64_t key)
+{
+    return splitmix64_mix((uint64_t)key);
+}
+
+static inline uint8_t swiss_h2(uint64_t hash)
+{
+    return (uint8_t)(hash >> 57);
+}
+
+// slots that may be taken before growing: 7/8 of the capacity
+static inline size_t swiss_max_load(size_t capacity)
+{
+    return capacity - capacity / 8;
+}
+
+// bit i is set if control byte i of the group equals byte
+static inline unsigned swiss_match(const uint8_t *group, uint8_t byte)
+{
+#ifdef __SSE2__
+    __m128i ctrl = _mm_load_si128((const __m128i *)group);
+    return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)byte)));
+#else
+    unsigned mask = 0;
+    for (int slot = 0; slot < SWISS_GROUP_WIDTH; slot++)
+    {
+        mask |= (unsigned)(group[slot] == byte) << slot;
+    }
+    return mask;
+#endif
+}
+
+// bit i is set if slot i of the group is empty or deleted (the high bit of its control byte)
+static inline unsigned swiss_match_free(const uint8_t *group)
+{
+#ifdef __SSE2__
+    return (unsigned)_mm_movemask_epi8(_mm_load_si128((const __m128i *)group));
+#else
+    unsigned mask = 0;
+    for (int slot = 0; slot < SWISS_GROUP_WIDTH; slot++)
+    {
+        mask |= (unsigned)(group[slot] >> 7) << slot;
+    }
+    return mask;
+#endif
+}
+
+static bool swiss_table_allocate(swiss_table_t *table, size_t capacity)
+{
+    table->ctrl = (uint8_t *)aligned_alloc(SWISS_GROUP_WIDTH, capacity);
+    table->slots = (swiss_slot_t *)malloc(sizeof(swiss_slot_t) * capacity);
+    if (!table->ctrl || !table->slots)
+    {
+        free(table->ctrl);
+        free(table->slots);
+        return false;
+    }
+
+    memset(table->ctrl, SWISS_EMPTY, capacity);
+    table->capacity = capacity;
+    table->size = 0;
+    table->growth_left = swiss_max_load(capacity);
+    return true;
+}
+
+// sizes the table so that expected distinct keys fit without growing
+bool swiss_table_init(swiss_table_t *table, size_t expected)
+{
+    if (!table)
+    {
+        return false;
+    }
+
+    size_t capacity = SWISS_GROUP_WIDTH;
+    while (swiss_max_load(capacity) < expected)
+    {
+        capacity *= 2;
+    }
+
+    return swiss_table_allocate(table, capacity);
+}
+
+void swiss_table_free(swiss_table_t *table)
+{
+    if (!table)
+    {
+        return;
+    }
+
+    free(table->ctrl);
+    free(table->slots);
+    table->ctrl = NULL;
+    table->slots = NULL;
+    table->capacity = 0;
+    table->size = 0;
+    table->growth_left = 0;
+}
+
+static inline size_t swiss_first_group(const swiss_table_t *table, uint64_t hash)
+{
+    return (size_t)(hash >> 7) & (table->capacity / SWISS_GROUP_WIDTH - 1);
+}
+
+// slot holding key, or capacity if it is not in the table
+static size_t swiss_table_find(const swiss_table_t *table, int64_t key)
+{
+    uint64_t hash = swiss_hash(key);
+    uint8_t h2 = swiss_h2(hash);
+    size_t group_mask = table->capacity / SWISS_GROUP_WIDTH - 1;
+    size_t group = swiss_first_group(table, hash);
+
+    for (size_t step = 1; step <= group_mask + 1; step++)
+    {
+        const uint8_t *ctrl = table->ctrl + group * SWISS_GROUP_WIDTH;
+        for (unsigned match = swiss_match(ctrl, h2); match; match &= match - 1)
+        {
+            size_t slot = group * SWISS_GROUP_WIDTH + (size_t)__builtin_ctz(match);
+            if (table->slots[slot].key == key)
+            {
+                return slot;
+            }
+        }
+
+        if (swiss_match(ctrl, SWISS_EMPTY))
+        {
+            break;
+        }
+        group = (group + step) & group_mask;
+    }
+
+    return table->capacity;
+}
+
+// first empty or deleted slot on the probe sequence of hash; the table must have one
+static size_t swiss_table_find_free(const swiss_table_t *table, uint64_t hash)
+{
+    size_t group_mask = table->capacity / SWISS_GROUP_WIDTH - 1;
+    size_t group = swiss_first_group(table, hash);
+
+    for (size_t step = 1;; step++)
+    {
+        unsigned free_slots = swiss_match_free(table->ctrl + group * SWISS_GROUP_WIDTH);
+        if (free_slots)
+        {
+            return group * SWISS_GROUP_WIDTH + (size_t)__builtin_ctz(free_slots);
+        }
+        group = (group + step) & group_mask;
+    }
+}
+
+// moves every key into a table of capacity slots, which also drops the tombstones
+static bool swiss_table_rehash(swiss_table_t *table, size_t capacity)
+{
+    swiss_table_t grown;
+    if (!swiss_table_allocate(&grown, capacity))
+    {
+        return false;
+    }
+
+    for (size_t slot = 0; slot < table->capacity; slot++)
+    {
+        if (!(table->ctrl[slot] & 0x80))
+        {
+            uint64_t hash = swiss_hash(table->slots[slot].key);
+            size_t target = swiss_table_find_free(&grown, hash);
+            grown.ctrl[target] = swiss_h2(hash);
+            grown.slots[target] = table->slots[slot];
+        }
+    }
+    grown.size = table->size;
+    grown.growth_left -= table->size;
+
+    swiss_table_free(table);
+    *table = grown;
+    return true;
+}
+
+// makes room for expected distinct keys in total, so that adding them never rehashes
+bool swiss_table_reserve(swiss_table_t *table, size_t expected)
+{
+    if (expected <= table->size + table->growth_left)
+    {
+        return true;
+    }
+
+    size_t capacity = table->capacity;
+    while (swiss_max_load(capacity) < expected)
+    {
+        capacity *= 2;
+    }
+
+    return swiss_table_rehash(table, capacity);
+}
+
+// adds amount to the count of key, inserting it with count amount if it is new
+bool swiss_table_add(swiss_table_t *table, int64_t key, uint64_t amount)
+{
+    size_t slot = swiss_table_find(table, key);
+    if (slot != table->capacity)
+    {
+        table->slots[slot].count += amount;
+        return true;
+    }
+
+    uint64_t hash = swiss_hash(key);
+    slot = swiss_table_find_free(table, hash);
+
+    // reusing a tombstone does not bring the table closer to its load limit
+    if (table->ctrl[slot] == SWISS_EMPTY)
+    {
+        if (!table->growth_left)
+        {
+            size_t capacity = table->size + 1 > swiss_max_load(table->capacity) / 2 ? table->capacity * 2 : table->capacity;
+            if (!swiss_table_rehash(table, capacity))
+            {
+                return false;
+            }
+            slot = swiss_table_find_free(table, hash);
+        }
+        table->growth_left--;
+    }
+
+    table->ctrl[slot] = swiss_h2(hash);
+    table->slots[slot].key = key;
+    table->slots[slot].count = amount;
+    table->size++;
+    return true;
+}
+
+// counts every key of keys once
+bool swiss_table_add_all(swiss_table_t *table, const int64_t *keys, size_t len)
+{
+    for (size_t counter = 0; counter < len; counter++)
+    {
+        if (counter + SWISS_PREFETCH_DISTANCE < len)
+        {
+            uint64_t ahead = swiss_hash(keys[counter + SWISS_PREFETCH_DISTANCE]);
+            size_t group = swiss_first_group(table, ahead);
+            __builtin_prefetch(table->ctrl + group * SWISS_GROUP_WIDTH);
+            __builtin_prefetch(table->slots + group * SWISS_GROUP_WIDTH);
+        }
+
+        if (!swiss_table_add(table, keys[counter], 1))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// number of times key was counted, 0 if it is not in the table
+uint64_t swiss_table_count(const swiss_table_t *table, int64_t key)
+{
+    size_t slot = swiss_table_find(table, key);
+    return slot == table->capacity ? 0 : table->slots[slot].count;
+}
+
+/*
+
+Removes key; false if it was not in the table. A slot whose group still has an empty slot
+becomes empty again, since no probe can have passed through that group; otherwise it
+becomes a tombstone, which inserts reuse and the next rehash drops.
+
+*/
+
+bool swiss_table_erase(swiss_table_t *table, int64_t key)
+{
+    size_t slot = swiss_table_find(table, key);
+    if (slot == table->capacity)
+    {
+        return false;
+    }
+
+    if (swiss_match(table->ctrl + slot / SWISS_GROUP_WIDTH * SWISS_GROUP_WIDTH, SWISS_EMPTY))
+    {
+        table->ctrl[slot] = SWISS_EMPTY;
+        table->growth_left++;
+    }
+    else
+    {
+        table->ctrl[slot] = SWISS_DELETED;
+    }
+
+    table->size--;
+    return true;
+}
+
+// removes every key, keeping the memory
+void swiss_table_clear(swiss_table_t *table)
+{
+    memset(table->ctrl, SWISS_EMPTY, table->capacity);
+    table->size = 0;
+    table->growth_left = swiss_max_load(table->capacity);
+}
+
+// the next full slot at or after *cursor (start at 0), or NULL at the end
+const swiss_slot_t *swiss_table_next(const swiss_table_t *table, size_t *cursor)
+{
+    for (size_t slot = *cursor; slot < table->capacity; slot++)
+    {
+        if (!(table->ctrl[slot] & 0x80))
+        {
+            *cursor = slot + 1;
+            return table->slots + slot;
+        }
+    }
+
+    *cursor = table->capacity;
+    return NULL;
+}
+
+/*
+
+Count of counts: histogram[c] is the number of keys that were counted exactly c times, for
+0 < c < buckets - 1, and histogram[buckets - 1] the number counted buckets - 1 times or more.
+histogram[1] is the number of unique keys. histogram[0] is always 0.
+
+*/
+
+void swiss_table_count_of_counts(const swiss_table_t *table, uint64_t *histogram, size_t buckets)
+{
+    if (!buckets)
+    {
+        return;
+    }
+
+    memset(histogram, 0, sizeof(uint64_t) * buckets);
+    for (size_t slot = 0; slot < table->capacity; slot++)
+    {
+        if (!(table->ctrl[slot] & 0x80))
+        {
+            uint64_t count = table->slots[slot].count;
+            histogram[count < buckets - 1 ? count : buckets - 1]++;
+        }
+    }
+}
+
+#endif /* FCC85117_1322_4B31_99D4_3FA9F6A92171 */
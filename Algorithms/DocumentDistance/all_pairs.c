@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../IO/parallel_parser.h"
+#include "./all_pairs.h"
+#include "./document_list.h"
+#include "./shared_term_table.h"
+#include "./tokenizer.h"
+
+/*
+
+all_pairs [-k count] [document ...]
+
+Prints, for every document, the count (default 10) documents most similar to it by the
+cosine of their word frequency vectors, most similar first, one pair per line:
+
+    document   neighbor   similarity
+
+Without documents on the command line, their paths are read from standard input, one per
+line. Documents without a word in common with a document are never its neighbors, so a
+document can have fewer than count lines.
+
+Every core tokenizes documents, taking them one at a time, and interns their words into one
+shared term table (shared_term_table.h), so that every document becomes a sparse unit
+vector over the same term ids (all_pairs.h). The ids are then renumbered in the order of
+their terms, so that the similarities, which are computed exactly, again on every core, add
+their products in the same order on every run.
+
+*/
+
+#define ALL_PAIRS_DEFAULT_COUNT 10
+
+typedef struct
+{
+    term_cache_t *cache;
+    term_counts_t *counts;
+    uint32_t *ids; // of the current block
+} vectorize_context_t;
+
+static bool vectorize_block(void *context, const char *block, const token_t *tokens, size_t count)
+{
+    vectorize_context_t *vectorize = (vectorize_context_t *)context;
+    return term_cache_intern_all(vectorize->cache, block, tokens, count, vectorize->ids) &&
+           term_counts_add(vectorize->counts, vectorize->ids, count);
+}
+
+typedef struct
+{
+    char **paths;
+    size_t len;
+    shared_term_table_t *terms;
+    sparse_vector_t *vectors; // by document
+    size_t *next;             // the next document to take, shared by all threads
+    bool failed;
+} vectorize_task_t;
+
+static void *vectorize_worker(void *arg)
+{
+    vectorize_task_t *task = (vectorize_task_t *)arg;
+    tokenizer_t tokenizer;
+    term_cache_t cache;
+    term_counts_t counts;
+    term_counts_init(&counts);
+    bool tokenizer_ready = tokenizer_init(&tokenizer);
+    bool cache_ready = term_cache_init(&cache, task->terms);
+    uint32_t *ids = (uint32_t *)malloc(sizeof(uint32_t) * TOKENIZER_MAX_TOKENS);
+    task->failed = !tokenizer_ready || !cache_ready || !ids;
+
+    vectorize_context_t context = {&cache, &counts, ids};
+    size_t document;
+    while (!task->failed && (document = __atomic_fetch_add(task->next, 1, __ATOMIC_RELAXED)) < task->len)
+    {
+        if (!tokenizer_run_file(&tokenizer, task->paths[document], vectorize_block, &context))
+        {
+            fprintf(stderr, "cannot read %s\n", task->paths[document]);
+            term_counts_clear(&counts);
+        }
+        task->failed = !term_counts_to_vector(&counts, task->vectors + document);
+    }
+
+    free(ids);
+    term_counts_free(&counts);
+    if (cache_ready)
+    {
+        term_cache_free(&cache);
+    }
+    if (tokenizer_ready)
+    {
+        tokenizer_free(&tokenizer);
+    }
+    return NULL;
+}
+
+// the vectors of all documents, on up to threads threads
+static bool vectorize_documents(vectorize_task_t *prototype, size_t threads)
+{
+    vectorize_task_t tasks[PARALLEL_PARSE_MAX_THREADS];
+    for (size_t counter = 0; counter < threads; counter++)
+    {
+        tasks[counter] = *prototype;
+    }
+
+    run_workers(tasks, sizeof(vectorize_task_t), threads, vectorize_worker);
+
+    bool computed = true;
+    for (size_t counter = 0; counter < threads; counter++)
+    {
+        computed = computed && !tasks[counter].failed;
+    }
+    return computed;
+}
+
+int main(int argc, char **argv)
+{
+    size_t k = ALL_PAIRS_DEFAULT_COUNT;
+    int first = 1;
+    if (first + 1 < argc && !strcmp(argv[first], "-k"))
+    {
+        k = (size_t)atol(argv[first + 1]);
+        first += 2;
+    }
+    if (!k)
+    {
+        return EXIT_FAILURE;
+    }
+
+    size_t len = 0;
+    char **paths = argc > first ? argv + first : read_document_paths(stdin, &len);
+    len = argc > first ? (size_t)(argc - first) : len;
+
+    shared_term_table_t terms;
+    sparse_corpus_t corpus;
+    bool terms_ready = shared_term_table_init(&terms, 0);
+    bool corpus_ready = sparse_corpus_init(&corpus);
+    sparse_vector_t *vectors = (sparse_vector_t *)calloc(len ? len : 1, sizeof(sparse_vector_t));
+    bool found = paths && terms_ready && corpus_ready && vectors;
+
+    if (found)
+    {
+        size_t next = 0;
+        vectorize_task_t prototype = {paths, len, &terms, vectors, &next, false};
+        size_t threads = default_parse_threads();
+        found = vectorize_documents(&prototype, threads < len ? threads : (len ? len : 1));
+    }
+
+    // ids that do not depend on which thread saw a term first
+    uint32_t *ranks = found ? (uint32_t *)malloc(sizeof(uint32_t) * (shared_term_table_count(&terms) + 1)) : NULL;
+    found = ranks && shared_term_table_rank(&terms, ranks);
+
+    for (size_t document = 0; document < len && vectors; document++)
+    {
+        found = found && sparse_vector_renumber(vectors + document, ranks) && sparse_corpus_append(&corpus, vectors + document);
+        sparse_vector_free(vectors + document);
+    }
+    free(ranks);
+
+    neighbor_t *neighbors = found ? (neighbor_t *)malloc(sizeof(neighbor_t) * k * (len ? len : 1)) : NULL;
+    size_t *counts = found ? (size_t *)malloc(sizeof(size_t) * (len ? len : 1)) : NULL;
+    found = neighbors && counts && all_pairs_top_k(&corpus, k, 0, neighbors, counts);
+
+    if (found)
+    {
+        for (size_t document = 0; document < len; document++)
+        {
+            for (size_t counter = 0; counter < counts[document]; counter++)
+            {
+                const neighbor_t *neighbor = neighbors + document * k + counter;
+                double similarity = neighbor->score > 1 ? 1 : neighbor->score;
+                printf("%s\t%s\t%.4f\n", paths[document], paths[neighbor->document], similarity);
+            }
+        }
+    }
+
+    if (paths != argv + first)
+    {
+        free_document_paths(paths, len);
+    }
+    free(vectors);
+    free(neighbors);
+    free(counts);
+    if (corpus_ready)
+    {
+        sparse_corpus_free(&corpus);
+    }
+    if (terms_ready)
+    {
+        shared_term_table_free(&terms);
+    }
+    return found ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,563 @@
+#ifndef FE272BD7_EDED_4C9D_A5D9_8D6638FB2589
+#define FE272BD7_EDED_4C9D_A5D9_8D6638FB2589
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../IO/parallel_parser.h"
+#include "../Sorting/sort_template.h"
+
+/*
+
+Exact cosine similarities between all pairs of a corpus, reduced to the k most similar
+documents of every document, so the output grows with N k and not N^2.
+
+Every document is a sparse vector: its distinct term ids in increasing order, each with its
+count, scaled once to unit length. The cosine of two documents is then the plain dot
+product of their vectors. Documents are counted into vectors independently (term_counts_t),
+so that threads can do it, and the vectors of the corpus are then stored one after the
+other (CSR).
+
+Dot products are accumulated through an inverted index rather than by intersecting vectors
+pair by pair: for a query document q, every term t of q adds w(q, t) * w(d, t) to the score
+of every document d in the postings of t, so only pairs that share a term cost anything.
+
+The scores of all N documents would not stay in cache, so the documents are cut into tiles
+of ALL_PAIRS_TILE_DOCUMENTS. A thread takes a block of ALL_PAIRS_QUERY_BLOCK query documents
+and runs it against one tile at a time, so the tile's scores (64 KB of floats) stay cached
+while the whole block goes through. Postings are sorted by document, so every term of every
+query in the block keeps a cursor into its postings that moves forward tile by tile, and
+each posting is still read once per query. After each query, the documents it touched in
+the tile are offered to the query's top-k heap and their scores cleared.
+
+Query blocks go to threads through a shared counter. Every query's heap belongs to the
+thread running its block, so threads share nothing they write. Both directions of a pair
+are computed, so that no heap is written by two threads.
+
+*/
+
+#define ALL_PAIRS_TILE_DOCUMENTS (1 << 14)
+#define ALL_PAIRS_QUERY_BLOCK 256
+
+typedef struct
+{
+    uint32_t *terms; // increasing
+    float *weights;  // unit length
+    size_t len;
+} sparse_vector_t;
+
+// counts the terms of one document at a time, with a count by term id for every term
+typedef struct
+{
+    uint32_t *counts;
+    size_t capacity;
+    uint32_t *touched; // the ids with a nonzero count; the next id is written ahead, so capacity + 1
+    size_t touched_len;
+} term_counts_t;
+
+typedef struct
+{
+    size_t *offsets;   // document d owns entries [offsets[d], offsets[d + 1])
+    uint32_t *terms;   // increasing within a document
+    float *weights;    // unit length per document
+    size_t documents;
+    size_t entries;
+    size_t capacity;   // entries
+    size_t term_count; // every term id is below this
+} sparse_corpus_t;
+
+typedef struct
+{
+    float score;
+    uint32_t document;
+} neighbor_t;
+
+#define ALL_PAIRS_ID_LESS(a, b) ((a) < (b))
+DEFINE_SORT(all_pairs_sort_ids, uint32_t, ALL_PAIRS_ID_LESS)
+
+typedef struct
+{
+    uint32_t term;
+    float weight;
+} sparse_entry_t;
+
+#define SPARSE_ENTRY_LESS(a, b) ((a).term < (b).term)
+DEFINE_SORT(all_pairs_sort_entries, sparse_entry_t, SPARSE_ENTRY_LESS)
+
+// better neighbors have higher scores, and among equal scores lower document numbers
+#define ALL_PAIRS_NEIGHBOR_BETTER(a, b) ((a).score > (b).score || ((a).score == (b).score && (a).document < (b).document))
+DEFINE_SORT(all_pairs_sort_neighbors, neighbor_t, ALL_PAIRS_NEIGHBOR_BETTER)
+
+void sparse_vector_free(sparse_vector_t *vector)
+{
+    if (vector)
+    {
+        free(vector->terms); // the weights share its allocation
+        memset(vector, 0, sizeof(*vector));
+    }
+}
+
+void term_counts_init(term_counts_t *counts)
+{
+    memset(counts, 0, sizeof(*counts));
+}
+
+void term_counts_free(term_counts_t *counts)
+{
+    if (!counts)
+    {
+        return;
+    }
+
+    free(counts->counts);
+    free(counts->touched);
+    memset(counts, 0, sizeof(*counts));
+}
+
+// counts the term ids ids[0, count)
+bool term_counts_add(term_counts_t *counts, const uint32_t *ids, size_t count)
+{
+    for (size_t counter = 0; counter < count; counter++)
+    {
+        uint32_t id = ids[counter];
+        if (id >= counts->capacity)
+        {
+            size_t capacity = counts->capacity ? counts->capacity : 1024;
+            while (capacity <= id)
+            {
+                capacity *= 2;
+            }
+
+            uint32_t *grown = (uint32_t *)realloc(counts->counts, sizeof(uint32_t) * capacity);
+            uint32_t *touched = grown ? (uint32_t *)realloc(counts->touched, sizeof(uint32_t) * (capacity + 1)) : NULL;
+            if (grown)
+            {
+                memset(grown + counts->capacity, 0, sizeof(uint32_t) * (capacity - counts->capacity));
+                counts->counts = grown;
+            }
+            if (!touched)
+            {
+                return false;
+            }
+            counts->touched = touched;
+            counts->capacity = capacity;
+        }
+
+        counts->touched[counts->touched_len] = id;
+        counts->touched_len += !counts->counts[id];
+        counts->counts[id]++;
+    }
+
+    return true;
+}
+
+// forgets the terms counted so far
+void term_counts_clear(term_counts_t *counts)
+{
+    for (size_t counter = 0; counter < counts->touched_len; counter++)
+    {
+        counts->counts[counts->touched[counter]] = 0;
+    }
+    counts->touched_len = 0;
+}
+
+// the terms counted so far as a unit-length vector, and clears the counts
+bool term_counts_to_vector(term_counts_t *counts, sparse_vector_t *vector)
+{
+    size_t len = counts->touched_len;
+    vector->len = len;
+    vector->terms = (uint32_t *)malloc((sizeof(uint32_t) + sizeof(float)) * (len ? len : 1));
+    vector->weights = (float *)(vector->terms + len);
+    if (!vector->terms)
+    {
+        term_counts_clear(counts);
+        return false;
+    }
+
+    all_pairs_sort_ids(counts->touched, len);
+
+    double norm = 0;
+    for (size_t counter = 0; counter < len; counter++)
+    {
+        double count = counts->counts[counts->touched[counter]];
+        norm += count * count;
+    }
+    norm = sqrt(norm);
+
+    for (size_t counter = 0; counter < len; counter++)
+    {
+        uint32_t id = counts->touched[counter];
+        vector->terms[counter] = id;
+        vector->weights[counter] = (float)(counts->counts[id] / norm);
+        counts->counts[id] = 0;
+    }
+
+    counts->touched_len = 0;
+    return true;
+}
+
+// gives term t of vector the id ids[t] instead, keeping the terms increasing
+bool sparse_vector_renumber(sparse_vector_t *vector, const uint32_t *ids)
+{
+    sparse_entry_t *entries = (sparse_entry_t *)malloc(sizeof(sparse_entry_t) * (vector->len ? vector->len : 1));
+    if (!entries)
+    {
+        return false;
+    }
+
+    for (size_t counter = 0; counter < vector->len; counter++)
+    {
+        entries[counter].term = ids[vector->terms[counter]];
+        entries[counter].weight = vector->weights[counter];
+    }
+
+    all_pairs_sort_entries(entries, vector->len);
+    for (size_t counter = 0; counter < vector->len; counter++)
+    {
+        vector->terms[counter] = entries[counter].term;
+        vector->weights[counter] = entries[counter].weight;
+    }
+
+    free(entries);
+    return true;
+}
+
+bool sparse_corpus_init(sparse_corpus_t *corpus)
+{
+    if (!corpus)
+    {
+        return false;
+    }
+
+    memset(corpus, 0, sizeof(*corpus));
+    corpus->offsets = (size_t *)malloc(sizeof(size_t) * 1024);
+    if (!corpus->offsets)
+    {
+        return false;
+    }
+    corpus->offsets[0] = 0;
+    return true;
+}
+
+void sparse_corpus_free(sparse_corpus_t *corpus)
+{
+    if (!corpus)
+    {
+        return;
+    }
+
+    free(corpus->offsets);
+    free(corpus->terms);
+    free(corpus->weights);
+    memset(corpus, 0, sizeof(*corpus));
+}
+
+// appends vector as the next document
+bool sparse_corpus_append(sparse_corpus_t *corpus, const sparse_vector_t *vector)
+{
+    size_t documents = corpus->documents + 1;
+    if (!(documents & (documents - 1)) && documents >= 1024)
+    {
+        size_t *offsets = (size_t *)realloc(corpus->offsets, sizeof(size_t) * documents * 2);
+        if (!offsets)
+        {
+            return false;
+        }
+        corpus->offsets = offsets;
+    }
+
+    size_t len = vector->len;
+    if (corpus->entries + len > corpus->capacity)
+    {
+        size_t capacity = corpus->capacity ? corpus->capacity : 1 << 16;
+        while (corpus->entries + len > capacity)
+        {
+            capacity *= 2;
+        }
+
+        uint32_t *terms = (uint32_t *)realloc(corpus->terms, sizeof(uint32_t) * capacity);
+        if (terms)
+        {
+            corpus->terms = terms;
+        }
+        float *weights = terms ? (float *)realloc(corpus->weights, sizeof(float) * capacity) : NULL;
+        if (!weights)
+        {
+            return false;
+        }
+        corpus->weights = weights;
+        corpus->capacity = capacity;
+    }
+
+    if (len)
+    {
+        memcpy(corpus->terms + corpus->entries, vector->terms, sizeof(uint32_t) * len);
+        memcpy(corpus->weights + corpus->entries, vector->weights, sizeof(float) * len);
+        uint32_t last = vector->terms[len - 1];
+        corpus->term_count = last >= corpus->term_count ? (size_t)last + 1 : corpus->term_count;
+    }
+
+    corpus->entries += len;
+    corpus->documents = documents;
+    corpus->offsets[documents] = corpus->entries;
+    return true;
+}
+
+// the postings of term t are [starts[t], starts[t + 1]), by increasing document
+typedef struct
+{
+    size_t *starts;
+    uint32_t *documents;
+    float *weights;
+} inverted_index_t;
+
+static void inverted_index_free(inverted_index_t *index)
+{
+    free(index->starts);
+    free(index->documents);
+    free(index->weights);
+}
+
+static bool inverted_index_build(inverted_index_t *index, const sparse_corpus_t *corpus)
+{
+    size_t terms = corpus->term_count;
+    index->starts = (size_t *)calloc(terms + 1, sizeof(size_t));
+    index->documents = (uint32_t *)malloc(sizeof(uint32_t) * (corpus->entries ? corpus->entries : 1));
+    index->weights = (float *)malloc(sizeof(float) * (corpus->entries ? corpus->entries : 1));
+    size_t *cursors = (size_t *)malloc(sizeof(size_t) * (terms ? terms : 1));
+    if (!index->starts || !index->documents || !index->weights || !cursors)
+    {
+        inverted_index_free(index);
+        free(cursors);
+        return false;
+    }
+
+    // a counting sort by term; documents come in order, so every list is sorted
+    for (size_t entry = 0; entry < corpus->entries; entry++)
+    {
+        index->starts[corpus->terms[entry] + 1]++;
+    }
+    for (size_t term = 0; term < terms; term++)
+    {
+        index->starts[term + 1] += index->starts[term];
+    }
+    memcpy(cursors, index->starts, sizeof(size_t) * terms);
+
+    for (size_t document = 0; document < corpus->documents; document++)
+    {
+        for (size_t entry = corpus->offsets[document]; entry < corpus->offsets[document + 1]; entry++)
+        {
+            size_t position = cursors[corpus->terms[entry]]++;
+            index->documents[position] = (uint32_t)document;
+            index->weights[position] = corpus->weights[entry];
+        }
+    }
+
+    free(cursors);
+    return true;
+}
+
+// offers candidate to the min-heap heap[0, *len) of at most k best neighbors
+static inline void all_pairs_offer(neighbor_t *heap, size_t *len, size_t k, neighbor_t candidate)
+{
+    size_t position;
+    if (*len < k)
+    {
+        position = (*len)++;
+        while (position && ALL_PAIRS_NEIGHBOR_BETTER(heap[(position - 1) / 2], candidate))
+        {
+            heap[position] = heap[(position - 1) / 2];
+            position = (position - 1) / 2;
+        }
+        heap[position] = candidate;
+        return;
+    }
+
+    if (!ALL_PAIRS_NEIGHBOR_BETTER(candidate, heap[0]))
+    {
+        return;
+    }
+
+    // replace the worst, the root, and sift the candidate down
+    position = 0;
+    for (;;)
+    {
+        size_t child = 2 * position + 1;
+        if (child >= k)
+        {
+            break;
+        }
+        if (child + 1 < k && ALL_PAIRS_NEIGHBOR_BETTER(heap[child], heap[child + 1]))
+        {
+            child++;
+        }
+        if (!ALL_PAIRS_NEIGHBOR_BETTER(candidate, heap[child]))
+        {
+            break;
+        }
+        heap[position] = heap[child];
+        position = child;
+    }
+    heap[position] = candidate;
+}
+
+typedef struct
+{
+    const sparse_corpus_t *corpus;
+    const inverted_index_t *index;
+    size_t k;
+    neighbor_t *neighbors; // k per document
+    size_t *found;         // neighbors per document
+    size_t *next_block;    // shared by all threads
+    bool failed;
+} all_pairs_task_t;
+
+static void *all_pairs_worker(void *arg)
+{
+    all_pairs_task_t *task = (all_pairs_task_t *)arg;
+    const sparse_corpus_t *corpus = task->corpus;
+    const inverted_index_t *index = task->index;
+    size_t blocks = (corpus->documents + ALL_PAIRS_QUERY_BLOCK - 1) / ALL_PAIRS_QUERY_BLOCK;
+
+    float *scores = (float *)calloc(ALL_PAIRS_TILE_DOCUMENTS, sizeof(float));
+    uint32_t *touched = (uint32_t *)malloc(sizeof(uint32_t) * (ALL_PAIRS_TILE_DOCUMENTS + 1)); // one written ahead
+    size_t *cursors = NULL; // by entry of the block
+    size_t cursors_capacity = 0;
+    if (!scores || !touched)
+    {
+        task->failed = true;
+    }
+
+    size_t block;
+    while (!task->failed && (block = __atomic_fetch_add(task->next_block, 1, __ATOMIC_RELAXED)) < blocks)
+    {
+        size_t first = block * ALL_PAIRS_QUERY_BLOCK;
+        size_t last = first + ALL_PAIRS_QUERY_BLOCK < corpus->documents ? first + ALL_PAIRS_QUERY_BLOCK : corpus->documents;
+        size_t base = corpus->offsets[first];
+        size_t entries = corpus->offsets[last] - base;
+
+        if (entries > cursors_capacity)
+        {
+            free(cursors);
+            cursors_capacity = entries * 2;
+            cursors = (size_t *)malloc(sizeof(size_t) * cursors_capacity);
+            if (!cursors)
+            {
+                task->failed = true;
+                break;
+            }
+        }
+        for (size_t entry = 0; entry < entries; entry++)
+        {
+            cursors[entry] = index->starts[corpus->terms[base + entry]];
+        }
+
+        for (size_t tile_first = 0; tile_first < corpus->documents; tile_first += ALL_PAIRS_TILE_DOCUMENTS)
+        {
+            uint32_t tile_last = (uint32_t)(tile_first + ALL_PAIRS_TILE_DOCUMENTS < corpus->documents ? tile_first + ALL_PAIRS_TILE_DOCUMENTS : corpus->documents);
+
+            for (size_t query = first; query < last; query++)
+            {
+                size_t touched_len = 0;
+                for (size_t entry = corpus->offsets[query]; entry < corpus->offsets[query + 1]; entry++)
+                {
+                    size_t posting = cursors[entry - base];
+                    size_t end = index->starts[corpus->terms[entry] + 1];
+                    float weight = corpus->weights[entry];
+                    for (; posting < end && index->documents[posting] < tile_last; posting++)
+                    {
+                        uint32_t local = index->documents[posting] - (uint32_t)tile_first;
+                        touched[touched_len] = local;
+                        touched_len += scores[local] == 0;
+                        scores[local] += weight * index->weights[posting];
+                    }
+                    cursors[entry - base] = posting;
+                }
+
+                neighbor_t *heap = task->neighbors + query * task->k;
+                for (size_t counter = 0; counter < touched_len; counter++)
+                {
+                    uint32_t local = touched[counter];
+                    neighbor_t candidate = {scores[local], (uint32_t)tile_first + local};
+                    scores[local] = 0;
+                    if (candidate.document != query)
+                    {
+                        all_pairs_offer(heap, task->found + query, task->k, candidate);
+                    }
+                }
+            }
+        }
+
+        for (size_t query = first; query < last; query++)
+        {
+            all_pairs_sort_neighbors(task->neighbors + query * task->k, task->found[query]);
+        }
+    }
+
+    free(scores);
+    free(touched);
+    free(cursors);
+    return NULL;
+}
+
+/*
+
+The k most similar documents of every document of corpus, on up to threads threads (0 picks
+one per online core): neighbors[d * k, d * k + found[d]) by decreasing cosine similarity.
+Only documents that share a term with d qualify, so found[d] can be below k.
+
+*/
+
+bool all_pairs_top_k(const sparse_corpus_t *corpus, size_t k, size_t threads, neighbor_t *neighbors, size_t *found)
+{
+    if (!corpus || !k || !neighbors || !found || corpus->documents > UINT32_MAX)
+    {
+        return false;
+    }
+
+    memset(found, 0, sizeof(size_t) * corpus->documents);
+    inverted_index_t index;
+    if (!inverted_index_build(&index, corpus))
+    {
+        return false;
+    }
+
+    size_t blocks = (corpus->documents + ALL_PAIRS_QUERY_BLOCK - 1) / ALL_PAIRS_QUERY_BLOCK;
+    if (!threads)
+    {
+        threads = default_parse_threads();
+    }
+    if (threads > PARALLEL_PARSE_MAX_THREADS)
+    {
+        threads = PARALLEL_PARSE_MAX_THREADS;
+    }
+    if (threads > blocks)
+    {
+        threads = blocks ? blocks : 1;
+    }
+
+    size_t next_block = 0;
+    all_pairs_task_t tasks[PARALLEL_PARSE_MAX_THREADS];
+    for (size_t counter = 0; counter < threads; counter++)
+    {
+        all_pairs_task_t task = {corpus, &index, k, neighbors, found, &next_block, false};
+        tasks[counter] = task;
+    }
+
+    run_workers(tasks, sizeof(all_pairs_task_t), threads, all_pairs_worker);
+
+    bool computed = true;
+    for (size_t counter = 0; counter < threads; counter++)
+    {
+        computed = computed && !tasks[counter].failed;
+    }
+
+    inverted_index_free(&index);
+    return computed;
+}
+
+#endif /* FE272BD7_EDED_4C9D_A5D9_8D6638FB2589 */
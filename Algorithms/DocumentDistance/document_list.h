@@ -0,0 +1,80 @@
+#ifndef AD4789F4_34D4_4F08_B55A_E125C6F23B18
+#define AD4789F4_34D4_4F08_B55A_E125C6F23B18
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+/*
+
+Corpora of millions of documents do not fit on a command line, so the corpus tools also take
+their document paths from a file (standard input), one per line. Empty lines are skipped and
+trailing carriage returns dropped.
+
+*/
+
+void free_document_paths(char **paths, size_t len)
+{
+    if (!paths)
+    {
+        return;
+    }
+
+    for (size_t counter = 0; counter < len; counter++)
+    {
+        free(paths[counter]);
+    }
+    free(paths);
+}
+
+// the paths listed in file, or NULL when out of memory or on a read error
+char **read_document_paths(FILE *file, size_t *len)
+{
+    size_t capacity = 1024;
+    char **paths = (char **)malloc(sizeof(char *) * capacity);
+    char *line = NULL;
+    size_t line_capacity = 0;
+    ssize_t line_len;
+    bool stored = paths != NULL;
+
+    *len = 0;
+    while (stored && (line_len = getline(&line, &line_capacity, file)) >= 0)
+    {
+        while (line_len > 0 && (line[line_len - 1] == '\n' || line[line_len - 1] == '\r'))
+        {
+            line[--line_len] = '\0';
+        }
+        if (!line_len)
+        {
+            continue;
+        }
+
+        if (*len == capacity)
+        {
+            char **grown = (char **)realloc(paths, sizeof(char *) * capacity * 2);
+            if (!grown)
+            {
+                stored = false;
+                break;
+            }
+            paths = grown;
+            capacity *= 2;
+        }
+        paths[*len] = strdup(line);
+        stored = paths[*len] != NULL;
+        *len += stored;
+    }
+
+    free(line);
+    if (!stored || ferror(file))
+    {
+        free_document_paths(paths, *len);
+        return NULL;
+    }
+    return paths;
+}
+
+#endif /* AD4789F4_34D4_4F08_B55A_E125C6F23B18 */
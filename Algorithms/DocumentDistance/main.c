@@ -1,8 +1,145 @@
-#include <stdlib.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
-#include "../Strix/header/strix.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "./term_table.h"
+#include "./tokenizer.h"
+
+/*
+
+document_distance [angle | cosine] first second
+
+Prints the distance between two text documents, seen as vectors of word frequencies: the
+angle between the vectors in radians (default, 0 for documents with the same word mix and
+pi / 2 for documents without a word in common), or the cosine distance, 1 - cos(angle).
 
-int main()
+Both documents are mapped, not read, and tokenized block by block (tokenizer.h). The words of
+both go through one term table (term_table.h), so each document becomes an array of counts
+indexed by term id, and the dot product is a single pass over two arrays. Nothing is
+allocated per word.
+
+*/
+
+typedef struct
+{
+    term_table_t *terms;
+    uint64_t *counts; // by term id
+    size_t capacity;
+    uint32_t *ids;    // of the current block
+} document_t;
+
+static bool count_block(void *context, const char *block, const token_t *tokens, size_t count)
 {
-    
-}
\ No newline at end of file
+    document_t *document = (document_t *)context;
+    if (!term_table_intern_all(document->terms, block, tokens, count, document->ids))
+    {
+        return false;
+    }
+
+    if (document->terms->count > document->capacity)
+    {
+        size_t capacity = document->capacity ? document->capacity : 1024;
+        while (capacity < document->terms->count)
+        {
+            capacity *= 2;
+        }
+        uint64_t *counts = (uint64_t *)realloc(document->counts, sizeof(uint64_t) * capacity);
+        if (!counts)
+        {
+            return false;
+        }
+        memset(counts + document->capacity, 0, sizeof(uint64_t) * (capacity - document->capacity));
+        document->counts = counts;
+        document->capacity = capacity;
+    }
+
+    for (size_t counter = 0; counter < count; counter++)
+    {
+        document->counts[document->ids[counter]]++;
+    }
+    return true;
+}
+
+// cosine of the angle between the count vectors; 0 if either document has no words
+static double cosine_similarity(const document_t *first, const document_t *second, size_t terms)
+{
+    double dot = 0;
+    double first_norm = 0;
+    double second_norm = 0;
+
+    for (size_t id = 0; id < terms; id++)
+    {
+        double left = id < first->capacity ? (double)first->counts[id] : 0;
+        double right = id < second->capacity ? (double)second->counts[id] : 0;
+        dot += left * right;
+        first_norm += left * left;
+        second_norm += right * right;
+    }
+
+    if (!first_norm || !second_norm)
+    {
+        return 0;
+    }
+
+    double cosine = dot / sqrt(first_norm * second_norm);
+    return cosine > 1 ? 1 : cosine;
+}
+
+int main(int argc, char **argv)
+{
+    bool angle = true;
+    int first = 1;
+    if (argc == 4)
+    {
+        if (strcmp(argv[1], "angle") && strcmp(argv[1], "cosine"))
+        {
+            return EXIT_FAILURE;
+        }
+        angle = !strcmp(argv[1], "angle");
+        first = 2;
+    }
+    else if (argc != 3)
+    {
+        return EXIT_FAILURE;
+    }
+
+    term_table_t terms;
+    tokenizer_t tokenizer;
+    if (!term_table_init(&terms, 0))
+    {
+        return EXIT_FAILURE;
+    }
+    if (!tokenizer_init(&tokenizer))
+    {
+        term_table_free(&terms);
+        return EXIT_FAILURE;
+    }
+
+    document_t documents[2];
+    memset(documents, 0, sizeof(documents));
+    bool counted = true;
+    for (int counter = 0; counter < 2 && counted; counter++)
+    {
+        documents[counter].terms = &terms;
+        documents[counter].ids = (uint32_t *)malloc(sizeof(uint32_t) * TOKENIZER_MAX_TOKENS);
+        counted = documents[counter].ids && tokenizer_run_file(&tokenizer, argv[first + counter], count_block, documents + counter);
+    }
+
+    if (counted)
+    {
+        double cosine = cosine_similarity(documents, documents + 1, terms.count);
+        printf("%.6f\n", angle ? acos(cosine) : 1 - cosine);
+    }
+
+    for (int counter = 0; counter < 2; counter++)
+    {
+        free(documents[counter].counts);
+        free(documents[counter].ids);
+    }
+    tokenizer_free(&tokenizer);
+    term_table_free(&terms);
+    return counted ? EXIT_SUCCESS : EXIT_FAILURE;
+}
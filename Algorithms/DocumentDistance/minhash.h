@@ -0,0 +1,597 @@
+#ifndef DD4056D2_1BDA_4AB7_BCE1_1852E1A2E337
+#define DD4056D2_1BDA_4AB7_BCE1_1852E1A2E337
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../IO/hash_mix.h"
+#include "../Sorting/sort_template.h"
+#include "./term_table.h"
+#include "./tokenizer.h"
+
+/*
+
+Comparing every pair of N documents costs N^2 / 2 vector products. MinHash and LSH banding
+find the pairs that are likely to be near duplicates in about linear time, and only those
+get compared.
+
+A document is the set of its shingles, the runs of k consecutive words. Two documents are
+near duplicates when the Jaccard similarity of their shingle sets, |A & B| / |A | B|, is high.
+
+MinHash: for a random hash function h, the shingle of A | B with the smallest h is in A & B
+with probability exactly the Jaccard similarity, so min h(A) == min h(B) with that
+probability. A signature keeps the minimum of n such functions (n = 128 by default); the
+fraction of equal positions in two signatures estimates the similarity with standard error
+at most 1 / (2 sqrt(n)), 4.4% for n = 128, whatever the document lengths.
+
+- Words are hashed with the term hash of term_table.h, and the shingle hash is a polynomial
+rolling hash over the last k word hashes, so every word costs O(1) however large k is.
+- Function i is the murmur3 finalizer of the 32-bit shingle hash xored with a seed s_i. A
+linear family such as (a_i * x + b_i) >> 32 would be cheaper, but is far from min-wise
+independent: it overestimated the similarity of unrelated documents by 0.1 and more. The
+finalizer is xor-shifts and 32-bit multiplies only, which vectorize lane by lane (pmulld
+with SSE4.1, vpmulld with AVX2), MINHASH_LANES functions at a time.
+
+The estimate decides nothing on its own: a pair of true similarity 0.77 has its signatures
+agree on 80% of 128 positions often enough to matter. So a state can also collect the
+shingles of its document (shingle_set_t, the 64-bit rolling hashes, sorted and distinct), and
+shingle_set_similarity gives the exact Jaccard similarity of two of them.
+
+LSH banding: the signature is cut into b bands of r rows. Documents whose signatures agree
+on a whole band land in the same bucket of that band and become a candidate pair, which
+happens with probability 1 - (1 - s^r)^b for similarity s: an S-curve that rises at about
+(1 / b)^(1 / r). More rows per band give fewer false candidates (precision), more bands fewer
+missed pairs (recall). lsh_choose_bands takes as many rows as it can while pairs at the
+threshold still become candidates with probability LSH_MIN_RECALL: for 128 hashes and a
+threshold of 0.8, 18 bands of 7 rows, which find 98.6% of the pairs at 0.8 and 13% of those
+at 0.5.
+
+Buckets are found by sorting the (band hash, document) pairs of every band, and all pairs of
+a bucket become candidates. A cluster of many copies would land in the same bucket of every
+band, and its pairs would be found once per band. So documents with identical signatures are
+grouped first, and only one of each group, its representative, goes into the buckets. The
+candidate pairs of the representatives are deduplicated, then expanded to every pair of
+their groups, plus every pair within a group.
+
+*/
+
+#define MINHASH_DEFAULT_HASHES 128
+#define MINHASH_MAX_HASHES 1024
+#define MINHASH_DEFAULT_SHINGLE 5
+#define MINHASH_MAX_SHINGLE 64
+#define MINHASH_LANES 8 // the number of hashes is rounded up to a multiple of this
+#define MINHASH_EMPTY UINT32_MAX
+#define MINHASH_ROLLING_BASE 0x100000001B3ULL
+#define LSH_MIN_RECALL 0.95
+
+// the hash functions of the signatures, shared read-only by all threads
+typedef struct
+{
+    size_t hashes;  // signature length
+    size_t shingle; // words per shingle
+    uint32_t *seeds;
+    uint64_t base_power; // MINHASH_ROLLING_BASE^shingle, drops the oldest word of the window
+} minhash_t;
+
+// the distinct shingles of one document
+typedef struct
+{
+    uint64_t *hashes;
+    size_t len;
+    size_t capacity;
+} shingle_set_t;
+
+// the signature of one document as it is being computed
+typedef struct
+{
+    const minhash_t *family;
+    uint32_t *signature;     // NULL if only shingles are collected
+    shingle_set_t *shingles; // NULL unless minhash_collect_shingles was called
+    uint64_t window[MINHASH_MAX_SHINGLE]; // the last shingle word hashes, as a ring
+    size_t words;
+    uint64_t rolling;
+} minhash_state_t;
+
+/*
+
+hashes functions (rounded up to a multiple of MINHASH_LANES) for shingles of shingle words
+(0 picks the defaults), drawn from seed; signatures are only comparable between families with
+the same arguments.
+
+*/
+
+bool minhash_init(minhash_t *family, size_t hashes, size_t shingle, uint64_t seed)
+{
+    if (!family || hashes > MINHASH_MAX_HASHES || shingle > MINHASH_MAX_SHINGLE)
+    {
+        return false;
+    }
+
+    hashes = hashes ? hashes : MINHASH_DEFAULT_HASHES;
+    family->hashes = (hashes + MINHASH_LANES - 1) / MINHASH_LANES * MINHASH_LANES;
+    family->shingle = shingle ? shingle : MINHASH_DEFAULT_SHINGLE;
+    family->seeds = (uint32_t *)malloc(sizeof(uint32_t) * family->hashes);
+    if (!family->seeds)
+    {
+        return false;
+    }
+
+    for (size_t hash = 0; hash < family->hashes; hash++)
+    {
+        family->seeds[hash] = (uint32_t)splitmix64_next(&seed);
+    }
+
+    family->base_power = 1;
+    for (size_t word = 0; word < family->shingle; word++)
+    {
+        family->base_power *= MINHASH_ROLLING_BASE;
+    }
+    return true;
+}
+
+void minhash_free(minhash_t *family)
+{
+    if (!family)
+    {
+        return;
+    }
+
+    free(family->seeds);
+    family->seeds = NULL;
+}
+
+// starts a document whose signature (family->hashes values) goes to signature
+void minhash_begin(minhash_state_t *state, const minhash_t *family, uint32_t *signature)
+{
+    state->family = family;
+    state->signature = signature;
+    state->shingles = NULL;
+    state->words = 0;
+    state->rolling = 0;
+    memset(state->window, 0, sizeof(uint64_t) * family->shingle);
+    for (size_t hash = 0; signature && hash < family->hashes; hash++)
+    {
+        signature[hash] = MINHASH_EMPTY;
+    }
+}
+
+// also collects the shingles of the document into shingles, which starts out empty
+void minhash_collect_shingles(minhash_state_t *state, shingle_set_t *shingles)
+{
+    memset(shingles, 0, sizeof(*shingles));
+    state->shingles = shingles;
+}
+
+static bool shingle_set_push(shingle_set_t *shingles, uint64_t hash)
+{
+    if (shingles->len == shingles->capacity)
+    {
+        size_t capacity = shingles->capacity ? shingles->capacity * 2 : 256;
+        uint64_t *grown = (uint64_t *)realloc(shingles->hashes, sizeof(uint64_t) * capacity);
+        if (!grown)
+        {
+            return false;
+        }
+        shingles->hashes = grown;
+        shingles->capacity = capacity;
+    }
+
+    shingles->hashes[shingles->len++] = hash;
+    return true;
+}
+
+static inline bool minhash_add_shingle(minhash_state_t *state, uint64_t rolling)
+{
+    if (state->shingles && !shingle_set_push(state->shingles, rolling))
+    {
+        return false;
+    }
+    if (!state->signature)
+    {
+        return true;
+    }
+
+    const minhash_t *family = state->family;
+    uint64_t mixed = (rolling ^ (rolling >> 31)) * 0xD6E8FEB86659FD93ULL;
+    uint32_t shingle = (uint32_t)(mixed >> 32);
+
+    // MINHASH_LANES functions at a time, a fixed-length loop that compilers vectorize
+    for (size_t first = 0; first < family->hashes; first += MINHASH_LANES)
+    {
+        const uint32_t *seeds = family->seeds + first;
+        uint32_t *signature = state->signature + first;
+        uint32_t values[MINHASH_LANES];
+        for (size_t lane = 0; lane < MINHASH_LANES; lane++)
+        {
+            uint32_t value = shingle ^ seeds[lane];
+            value = (value ^ (value >> 16)) * 0x85EBCA6BU;
+            value = (value ^ (value >> 13)) * 0xC2B2AE35U;
+            values[lane] = value ^ (value >> 16);
+        }
+        for (size_t lane = 0; lane < MINHASH_LANES; lane++)
+        {
+            signature[lane] = values[lane] < signature[lane] ? values[lane] : signature[lane];
+        }
+    }
+    return true;
+}
+
+// adds the words of a token block; a token_consumer_t, with a minhash_state_t as context
+bool minhash_add_block(void *context, const char *block, const token_t *tokens, size_t count)
+{
+    minhash_state_t *state = (minhash_state_t *)context;
+    size_t shingle = state->family->shingle;
+
+    for (size_t counter = 0; counter < count; counter++)
+    {
+        uint64_t word = term_hash(block + tokens[counter].start, tokens[counter].len, true);
+        size_t position = state->words % shingle;
+
+        // the oldest word leaves the window (it is 0 until the window is full)
+        state->rolling = state->rolling * MINHASH_ROLLING_BASE + word - state->window[position] * state->family->base_power;
+        state->window[position] = word;
+        state->words++;
+
+        if (state->words >= shingle && !minhash_add_shingle(state, state->rolling))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#define SHINGLE_LESS(a, b) ((a) < (b))
+DEFINE_SORT(shingle_sort, uint64_t, SHINGLE_LESS)
+
+/*
+
+Finishes the document; false if it has no words, or if its shingles could not be collected.
+Shorter documents are one shingle. Collected shingles end up sorted and distinct, and the
+caller frees them with shingle_set_free.
+
+*/
+
+bool minhash_end(minhash_state_t *state)
+{
+    if (state->words && state->words < state->family->shingle && !minhash_add_shingle(state, state->rolling))
+    {
+        return false;
+    }
+
+    shingle_set_t *shingles = state->shingles;
+    if (shingles)
+    {
+        shingle_sort(shingles->hashes, shingles->len);
+        size_t distinct = 0;
+        for (size_t counter = 0; counter < shingles->len; counter++)
+        {
+            if (!distinct || shingles->hashes[distinct - 1] != shingles->hashes[counter])
+            {
+                shingles->hashes[distinct++] = shingles->hashes[counter];
+            }
+        }
+        shingles->len = distinct;
+    }
+
+    return state->words > 0;
+}
+
+void shingle_set_free(shingle_set_t *shingles)
+{
+    free(shingles->hashes);
+    memset(shingles, 0, sizeof(*shingles));
+}
+
+// the exact Jaccard similarity of two finished shingle sets, a merge of the sorted hashes
+double shingle_set_similarity(const shingle_set_t *first, const shingle_set_t *second)
+{
+    size_t left = 0;
+    size_t right = 0;
+    size_t common = 0;
+    while (left < first->len && right < second->len)
+    {
+        uint64_t a = first->hashes[left];
+        uint64_t b = second->hashes[right];
+        common += a == b;
+        left += a <= b;
+        right += b <= a;
+    }
+
+    size_t total = first->len + second->len - common;
+    return total ? (double)common / (double)total : 0;
+}
+
+// the estimated Jaccard similarity of two signatures of hashes values
+double minhash_similarity(const uint32_t *first, const uint32_t *second, size_t hashes)
+{
+    size_t equal = 0;
+    for (size_t hash = 0; hash < hashes; hash++)
+    {
+        equal += first[hash] == second[hash];
+    }
+
+    return hashes ? (double)equal / (double)hashes : 0;
+}
+
+// the probability that documents of similarity s become a candidate pair
+double lsh_candidate_probability(double similarity, size_t bands, size_t rows)
+{
+    return 1 - pow(1 - pow(similarity, (double)rows), (double)bands);
+}
+
+// the most rows per band (the fewest false candidates) that find pairs at threshold often enough
+void lsh_choose_bands(size_t hashes, double threshold, size_t *bands, size_t *rows)
+{
+    *bands = hashes;
+    *rows = 1;
+
+    for (size_t candidate = 2; candidate <= hashes; candidate++)
+    {
+        if (lsh_candidate_probability(threshold, hashes / candidate, candidate) >= LSH_MIN_RECALL)
+        {
+            *bands = hashes / candidate;
+            *rows = candidate;
+        }
+    }
+}
+
+typedef struct
+{
+    uint64_t hash;
+    uint32_t document;
+} lsh_entry_t;
+
+typedef struct
+{
+    uint32_t first; // first < second
+    uint32_t second;
+} lsh_pair_t;
+
+#define LSH_ENTRY_LESS(a, b) ((a).hash < (b).hash || ((a).hash == (b).hash && (a).document < (b).document))
+DEFINE_SORT(lsh_sort_entries, lsh_entry_t, LSH_ENTRY_LESS)
+
+#define LSH_PAIR_LESS(a, b) ((a).first < (b).first || ((a).first == (b).first && (a).second < (b).second))
+DEFINE_SORT(lsh_sort_pairs, lsh_pair_t, LSH_PAIR_LESS)
+
+typedef struct
+{
+    lsh_pair_t *pairs;
+    size_t len;
+    size_t capacity;
+} lsh_pairs_t;
+
+static inline uint64_t lsh_band_hash(const uint32_t *values, size_t rows)
+{
+    uint64_t hash = 0x9E3779B97F4A7C15ULL;
+    for (size_t row = 0; row < rows; row++)
+    {
+        hash = (hash ^ values[row]) * 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+static bool lsh_push_pair(lsh_pairs_t *pairs, uint32_t first, uint32_t second)
+{
+    if (pairs->len == pairs->capacity)
+    {
+        size_t capacity = pairs->capacity ? pairs->capacity * 2 : 1024;
+        lsh_pair_t *grown = (lsh_pair_t *)realloc(pairs->pairs, sizeof(lsh_pair_t) * capacity);
+        if (!grown)
+        {
+            return false;
+        }
+        pairs->pairs = grown;
+        pairs->capacity = capacity;
+    }
+
+    pairs->pairs[pairs->len].first = first;
+    pairs->pairs[pairs->len].second = second;
+    pairs->len++;
+    return true;
+}
+
+// sorts pairs and drops the repeated ones
+static void lsh_unique_pairs(lsh_pairs_t *pairs)
+{
+    lsh_sort_pairs(pairs->pairs, pairs->len);
+    size_t unique = 0;
+    for (size_t counter = 0; counter < pairs->len; counter++)
+    {
+        if (!unique || LSH_PAIR_LESS(pairs->pairs[unique - 1], pairs->pairs[counter]))
+        {
+            pairs->pairs[unique++] = pairs->pairs[counter];
+        }
+    }
+    pairs->len = unique;
+}
+
+/*
+
+Groups the present documents by identical signature: copies[0, *count) are the
+(representative, document) pairs of all present documents, sorted, so that every group is a
+run; a group's representative is its first document, and representatives[d] is that of d.
+
+*/
+
+static void lsh_group_copies(const uint32_t *signatures, const bool *present, size_t len, size_t hashes, lsh_entry_t *copies, size_t *count, uint32_t *representatives)
+{
+    size_t present_count = 0;
+    for (size_t document = 0; document < len; document++)
+    {
+        if (present[document])
+        {
+            copies[present_count].hash = lsh_band_hash(signatures + document * hashes, hashes);
+            copies[present_count].document = (uint32_t)document;
+            present_count++;
+        }
+    }
+    lsh_sort_entries(copies, present_count);
+
+    // equal hashes almost always mean equal signatures; the rest get representatives of their own
+    for (size_t first = 0; first < present_count;)
+    {
+        size_t end = first + 1;
+        while (end < present_count && copies[end].hash == copies[first].hash)
+        {
+            end++;
+        }
+
+        for (size_t member = first; member < end; member++)
+        {
+            uint32_t document = copies[member].document;
+            representatives[document] = document;
+            for (size_t earlier = first; earlier < member; earlier++)
+            {
+                uint32_t other = copies[earlier].document;
+                if (representatives[other] == other &&
+                    !memcmp(signatures + other * hashes, signatures + document * hashes, sizeof(uint32_t) * hashes))
+                {
+                    representatives[document] = other;
+                    break;
+                }
+            }
+        }
+        first = end;
+    }
+
+    for (size_t counter = 0; counter < present_count; counter++)
+    {
+        copies[counter].hash = representatives[copies[counter].document];
+    }
+    lsh_sort_entries(copies, present_count);
+    *count = present_count;
+}
+
+/*
+
+Candidate pairs among documents[0, len) whose signatures (hashes values each) sit one after
+the other in signatures; documents with present[d] false (no words) are left out. The pairs
+are sorted and distinct, and the caller frees candidates->pairs.
+
+*/
+
+bool lsh_candidates(const uint32_t *signatures, const bool *present, size_t len, size_t hashes, size_t bands, size_t rows, lsh_pairs_t *candidates)
+{
+    memset(candidates, 0, sizeof(*candidates));
+    if (!len || bands * rows > hashes || len > UINT32_MAX)
+    {
+        return len == 0;
+    }
+
+    lsh_entry_t *entries = (lsh_entry_t *)malloc(sizeof(lsh_entry_t) * len);
+    lsh_entry_t *copies = (lsh_entry_t *)malloc(sizeof(lsh_entry_t) * len);
+    uint32_t *representatives = (uint32_t *)malloc(sizeof(uint32_t) * len);
+    size_t *group_starts = (size_t *)malloc(sizeof(size_t) * len); // in copies, by representative
+    lsh_pairs_t groups; // candidate pairs of representatives
+    memset(&groups, 0, sizeof(groups));
+    bool pushed = entries && copies && representatives && group_starts;
+
+    size_t copy_count = 0;
+    if (pushed)
+    {
+        lsh_group_copies(signatures, present, len, hashes, copies, &copy_count, representatives);
+        for (size_t counter = 0; counter < copy_count; counter++)
+        {
+            if (!counter || copies[counter].hash != copies[counter - 1].hash)
+            {
+                group_starts[copies[counter].hash] = counter;
+            }
+        }
+    }
+
+    for (size_t band = 0; band < bands && pushed; band++)
+    {
+        size_t count = 0;
+        for (size_t document = 0; document < len; document++)
+        {
+            if (present[document] && representatives[document] == document)
+            {
+                const uint32_t *values = signatures + document * hashes + band * rows;
+                entries[count].hash = lsh_band_hash(values, rows);
+                entries[count].document = (uint32_t)document;
+                count++;
+            }
+        }
+
+        lsh_sort_entries(entries, count);
+        for (size_t first = 0; first < count && pushed;)
+        {
+            size_t end = first + 1;
+            while (end < count && entries[end].hash == entries[first].hash)
+            {
+                end++;
+            }
+
+            for (size_t left = first; left < end && pushed; left++)
+            {
+                for (size_t right = left + 1; right < end && pushed; right++)
+                {
+                    pushed = lsh_push_pair(&groups, entries[left].document, entries[right].document);
+                }
+            }
+            first = end;
+        }
+    }
+
+    if (pushed)
+    {
+        lsh_unique_pairs(&groups);
+    }
+
+    // every pair within a group of copies, then every pair across two candidate groups
+    for (size_t first = 0; first < copy_count && pushed;)
+    {
+        size_t end = first + 1;
+        while (end < copy_count && copies[end].hash == copies[first].hash)
+        {
+            end++;
+        }
+
+        for (size_t left = first; left + 1 < end && pushed; left++)
+        {
+            for (size_t right = left + 1; right < end && pushed; right++)
+            {
+                pushed = lsh_push_pair(candidates, copies[left].document, copies[right].document);
+            }
+        }
+        first = end;
+    }
+
+    for (size_t counter = 0; counter < groups.len && pushed; counter++)
+    {
+        for (size_t left = group_starts[groups.pairs[counter].first];
+             left < copy_count && copies[left].hash == groups.pairs[counter].first && pushed; left++)
+        {
+            for (size_t right = group_starts[groups.pairs[counter].second];
+                 right < copy_count && copies[right].hash == groups.pairs[counter].second && pushed; right++)
+            {
+                uint32_t a = copies[left].document;
+                uint32_t b = copies[right].document;
+                pushed = lsh_push_pair(candidates, a < b ? a : b, a < b ? b : a);
+            }
+        }
+    }
+
+    free(entries);
+    free(copies);
+    free(representatives);
+    free(group_starts);
+    free(groups.pairs);
+    if (!pushed)
+    {
+        free(candidates->pairs);
+        memset(candidates, 0, sizeof(*candidates));
+        return false;
+    }
+
+    lsh_sort_pairs(candidates->pairs, candidates->len);
+    return true;
+}
+
+#endif /* DD4056D2_1BDA_4AB7_BCE1_1852E1A2E337 */
@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../IO/parallel_parser.h"
+#include "./document_list.h"
+#include "./minhash.h"
+#include "./tokenizer.h"
+
+/*
+
+near_duplicates [-t threshold] [-k shingle] [-n hashes] [document ...]
+
+Prints the pairs of documents whose Jaccard similarity (over shingles of k words, default 5)
+is at least threshold (default 0.8), one per line:
+
+    first   second   similarity
+
+Without documents on the command line, their paths are read from standard input, one per
+line, which is how a corpus of millions of files gets in.
+
+Every document gets a MinHash signature of n values (default 128; minhash.h), computed by
+one thread per core that take the documents one at a time. LSH banding with the bands chosen
+for threshold turns the signatures into candidate pairs, and only the candidates are
+compared: the documents of the candidates are read again, and their shingle sets give the
+exact similarity that is printed. Pairs slightly above the threshold can be missed, and more
+hashes make that rarer, but no pair below it is printed.
+
+*/
+
+#define NEAR_DUPLICATES_DEFAULT_THRESHOLD 0.8
+#define NEAR_DUPLICATES_SEED 0x6E656172ULL
+
+typedef struct
+{
+    char **paths;
+    size_t len;
+    const minhash_t *family;
+    uint32_t *signatures;
+    bool *present;           // the document has words
+    shingle_set_t *shingles; // if not NULL, collects the shingles of the wanted documents instead
+    const bool *wanted;
+    size_t *next; // the next document to take, shared by all threads
+    bool failed;
+} signature_task_t;
+
+static void *signature_worker(void *arg)
+{
+    signature_task_t *task = (signature_task_t *)arg;
+    tokenizer_t tokenizer;
+    if (!tokenizer_init(&tokenizer))
+    {
+        task->failed = true;
+        return NULL;
+    }
+
+    minhash_state_t state;
+    size_t document;
+    while ((document = __atomic_fetch_add(task->next, 1, __ATOMIC_RELAXED)) < task->len)
+    {
+        if (task->shingles)
+        {
+            // the document had words, so a failure here is a changed file or no memory
+            if (task->wanted[document])
+            {
+                minhash_begin(&state, task->family, NULL);
+                minhash_collect_shingles(&state, task->shingles + document);
+                bool read = tokenizer_run_file(&tokenizer, task->paths[document], minhash_add_block, &state);
+                if (!minhash_end(&state) || !read)
+                {
+                    fprintf(stderr, "cannot read %s again\n", task->paths[document]);
+                    task->failed = true;
+                }
+            }
+            continue;
+        }
+
+        minhash_begin(&state, task->family, task->signatures + document * task->family->hashes);
+        if (!tokenizer_run_file(&tokenizer, task->paths[document], minhash_add_block, &state))
+        {
+            fprintf(stderr, "cannot read %s\n", task->paths[document]);
+        }
+        task->present[document] = minhash_end(&state);
+    }
+
+    tokenizer_free(&tokenizer);
+    return NULL;
+}
+
+// signatures (or shingles) of all documents, on up to threads threads
+static bool compute_signatures(signature_task_t *prototype, size_t threads)
+{
+    signature_task_t tasks[PARALLEL_PARSE_MAX_THREADS];
+    for (size_t counter = 0; counter < threads; counter++)
+    {
+        tasks[counter] = *prototype;
+    }
+
+    run_workers(tasks, sizeof(signature_task_t), threads, signature_worker);
+
+    bool computed = true;
+    for (size_t counter = 0; counter < threads; counter++)
+    {
+        computed = computed && !tasks[counter].failed;
+    }
+    return computed;
+}
+
+int main(int argc, char **argv)
+{
+    double threshold = NEAR_DUPLICATES_DEFAULT_THRESHOLD;
+    size_t shingle = 0;
+    size_t hashes = 0;
+    int first = 1;
+    while (first + 1 < argc && argv[first][0] == '-' && argv[first][1] && !argv[first][2])
+    {
+        switch (argv[first][1])
+        {
+        case 't':
+            threshold = atof(argv[first + 1]);
+            break;
+        case 'k':
+            shingle = (size_t)atol(argv[first + 1]);
+            break;
+        case 'n':
+            hashes = (size_t)atol(argv[first + 1]);
+            break;
+        default:
+            return EXIT_FAILURE;
+        }
+        first += 2;
+    }
+
+    minhash_t family;
+    if (threshold <= 0 || threshold > 1 || !minhash_init(&family, hashes, shingle, NEAR_DUPLICATES_SEED))
+    {
+        return EXIT_FAILURE;
+    }
+
+    size_t len = 0;
+    char **paths = argc > first ? argv + first : read_document_paths(stdin, &len);
+    len = argc > first ? (size_t)(argc - first) : len;
+
+    uint32_t *signatures = (uint32_t *)malloc(sizeof(uint32_t) * family.hashes * (len ? len : 1));
+    bool *present = (bool *)calloc(len ? len : 1, sizeof(bool));
+    bool *wanted = (bool *)calloc(len ? len : 1, sizeof(bool));
+    shingle_set_t *shingles = (shingle_set_t *)calloc(len ? len : 1, sizeof(shingle_set_t));
+    bool found = paths && signatures && present && wanted && shingles;
+    size_t threads = default_parse_threads();
+    threads = threads < len ? threads : (len ? len : 1);
+
+    if (found)
+    {
+        size_t next = 0;
+        signature_task_t prototype = {paths, len, &family, signatures, present, NULL, NULL, &next, false};
+        found = compute_signatures(&prototype, threads);
+    }
+
+    lsh_pairs_t candidates;
+    size_t bands;
+    size_t rows;
+    lsh_choose_bands(family.hashes, threshold, &bands, &rows);
+    found = found && lsh_candidates(signatures, present, len, family.hashes, bands, rows, &candidates);
+
+    if (found)
+    {
+        // the shingles of every document in a candidate pair, for the exact similarities
+        for (size_t counter = 0; counter < candidates.len; counter++)
+        {
+            wanted[candidates.pairs[counter].first] = true;
+            wanted[candidates.pairs[counter].second] = true;
+        }
+
+        size_t next = 0;
+        signature_task_t prototype = {paths, len, &family, signatures, present, shingles, wanted, &next, false};
+        found = compute_signatures(&prototype, threads);
+
+        for (size_t counter = 0; counter < candidates.len && found; counter++)
+        {
+            const lsh_pair_t *pair = candidates.pairs + counter;
+            double similarity = shingle_set_similarity(shingles + pair->first, shingles + pair->second);
+            if (similarity >= threshold)
+            {
+                printf("%s\t%s\t%.4f\n", paths[pair->first], paths[pair->second], similarity);
+            }
+        }
+        free(candidates.pairs);
+    }
+
+    if (paths != argv + first)
+    {
+        free_document_paths(paths, len);
+    }
+    for (size_t document = 0; document < len && shingles; document++)
+    {
+        shingle_set_free(shingles + document);
+    }
+    free(shingles);
+    free(wanted);
+    free(signatures);
+    free(present);
+    minhash_free(&family);
+    return found ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,332 @@
+#ifndef B0652DDD_7917_4BA9_BDD8_2F12018877F0
+#define B0652DDD_7917_4BA9_BDD8_2F12018877F0
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Sorting/sort_template.h"
+#include "./term_table.h"
+#include "./tokenizer.h"
+
+/*
+
+A term table that many threads intern into at once, for corpora tokenized in parallel. Ids
+are still dense 32-bit numbers, 0 to count - 1, so downstream counting keeps working on
+arrays indexed by id; only the order in which terms get their id depends on the threads.
+Results that must not change from run to run renumber the terms with shared_term_table_rank
+once interning is over, which orders them by their bytes.
+
+The terms are split over SHARED_TERM_TABLE_SHARDS term tables (term_table.h) by the top bits
+of their hash, each behind its own mutex, so threads that intern different terms seldom
+wait for each other. A new term takes the next id from a shared counter, and a directory
+of chunks (allocated when first needed, never moved) maps the id back to its shard and its
+place there.
+
+Most occurrences are of terms seen before, so threads do not even go to the shared table
+for them: every thread interns through a term_cache_t, a private term table that remembers
+the shared id of each term it has seen. Only the first occurrence of a term in a thread
+takes a lock. The cost is one copy of its vocabulary per thread.
+
+*/
+
+#define SHARED_TERM_TABLE_SHARD_BITS 6
+#define SHARED_TERM_TABLE_SHARDS (1 << SHARED_TERM_TABLE_SHARD_BITS)
+#define SHARED_TERM_TABLE_CHUNK_BITS 16
+#define SHARED_TERM_TABLE_CHUNKS ((size_t)1 << (32 - SHARED_TERM_TABLE_CHUNK_BITS))
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    term_table_t table;
+    uint32_t *ids; // shared id by id in table
+    size_t ids_capacity;
+} term_shard_t;
+
+typedef struct
+{
+    term_shard_t shards[SHARED_TERM_TABLE_SHARDS];
+    uint32_t **directory; // id -> local id << SHARD_BITS | shard, in chunks of 2^CHUNK_BITS
+    size_t count;         // ids handed out
+} shared_term_table_t;
+
+void shared_term_table_free(shared_term_table_t *table)
+{
+    if (!table)
+    {
+        return;
+    }
+
+    for (size_t shard = 0; shard < SHARED_TERM_TABLE_SHARDS; shard++)
+    {
+        pthread_mutex_destroy(&table->shards[shard].lock);
+        term_table_free(&table->shards[shard].table);
+        free(table->shards[shard].ids);
+    }
+    if (table->directory)
+    {
+        for (size_t chunk = 0; chunk < SHARED_TERM_TABLE_CHUNKS; chunk++)
+        {
+            free(table->directory[chunk]);
+        }
+    }
+    free(table->directory);
+    memset(table, 0, sizeof(*table));
+}
+
+// sizes the table so that expected terms fit without growing
+bool shared_term_table_init(shared_term_table_t *table, size_t expected)
+{
+    if (!table)
+    {
+        return false;
+    }
+
+    memset(table, 0, sizeof(*table));
+    bool ready = true;
+    for (size_t shard = 0; shard < SHARED_TERM_TABLE_SHARDS; shard++)
+    {
+        pthread_mutex_init(&table->shards[shard].lock, NULL);
+        ready = term_table_init(&table->shards[shard].table, expected / SHARED_TERM_TABLE_SHARDS) && ready;
+    }
+
+    table->directory = (uint32_t **)calloc(SHARED_TERM_TABLE_CHUNKS, sizeof(uint32_t *));
+    if (!ready || !table->directory)
+    {
+        shared_term_table_free(table);
+        return false;
+    }
+    return true;
+}
+
+static bool shared_term_table_place(shared_term_table_t *table, uint32_t id, uint32_t place)
+{
+    uint32_t **slot = table->directory + (id >> SHARED_TERM_TABLE_CHUNK_BITS);
+    uint32_t *chunk = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+    if (!chunk)
+    {
+        uint32_t *fresh = (uint32_t *)malloc(sizeof(uint32_t) << SHARED_TERM_TABLE_CHUNK_BITS);
+        if (!fresh)
+        {
+            return false;
+        }
+
+        // another thread may have put its chunk in first
+        if (__atomic_compare_exchange_n(slot, &chunk, fresh, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            chunk = fresh;
+        }
+        else
+        {
+            free(fresh);
+        }
+    }
+
+    chunk[id & ((1 << SHARED_TERM_TABLE_CHUNK_BITS) - 1)] = place;
+    return true;
+}
+
+// the shared id of term, which is added if it is new; TERM_TABLE_NONE when out of memory
+static uint32_t shared_term_table_intern_hashed(shared_term_table_t *table, const char *term, size_t len, uint32_t hash, bool padded)
+{
+    size_t shard_index = hash >> (32 - SHARED_TERM_TABLE_SHARD_BITS);
+    term_shard_t *shard = table->shards + shard_index;
+    pthread_mutex_lock(&shard->lock);
+
+    // room for the shared id of a new term first, so that every term in the shard has one
+    size_t known = shard->table.count;
+    if (known >= shard->ids_capacity)
+    {
+        size_t capacity = shard->ids_capacity ? shard->ids_capacity * 2 : 1024;
+        uint32_t *ids = (uint32_t *)realloc(shard->ids, sizeof(uint32_t) * capacity);
+        if (!ids)
+        {
+            pthread_mutex_unlock(&shard->lock);
+            return TERM_TABLE_NONE;
+        }
+        shard->ids = ids;
+        shard->ids_capacity = capacity;
+    }
+
+    uint32_t local = term_table_intern_hashed(&shard->table, term, len, hash, padded);
+    uint32_t id = local;
+    if (local != TERM_TABLE_NONE && local < known)
+    {
+        id = shard->ids[local];
+    }
+    else if (local != TERM_TABLE_NONE)
+    {
+        // without a place in the directory the term keeps TERM_TABLE_NONE as its id
+        size_t next = __atomic_fetch_add(&table->count, 1, __ATOMIC_RELAXED);
+        bool placed = next < TERM_TABLE_NONE && local <= UINT32_MAX >> SHARED_TERM_TABLE_SHARD_BITS &&
+                      shared_term_table_place(table, (uint32_t)next, local << SHARED_TERM_TABLE_SHARD_BITS | (uint32_t)shard_index);
+        id = placed ? (uint32_t)next : TERM_TABLE_NONE;
+        shard->ids[local] = id;
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+    return id;
+}
+
+uint32_t shared_term_table_intern(shared_term_table_t *table, const char *term, size_t len)
+{
+    return shared_term_table_intern_hashed(table, term, len, term_hash(term, len, false), false);
+}
+
+// the number of ids handed out so far
+size_t shared_term_table_count(const shared_term_table_t *table)
+{
+    size_t count = __atomic_load_n(&table->count, __ATOMIC_RELAXED);
+    return count < TERM_TABLE_NONE ? count : TERM_TABLE_NONE;
+}
+
+// the bytes of term id and their number in *len, once no thread is interning anymore
+const char *shared_term_table_term(const shared_term_table_t *table, uint32_t id, size_t *len)
+{
+    uint32_t place = table->directory[id >> SHARED_TERM_TABLE_CHUNK_BITS][id & ((1 << SHARED_TERM_TABLE_CHUNK_BITS) - 1)];
+    const term_table_t *shard = &table->shards[place & (SHARED_TERM_TABLE_SHARDS - 1)].table;
+    return term_table_term(shard, place >> SHARED_TERM_TABLE_SHARD_BITS, len);
+}
+
+typedef struct
+{
+    const char *term;
+    size_t len;
+    uint32_t id;
+} term_rank_t;
+
+static inline bool term_rank_less(const term_rank_t *left, const term_rank_t *right)
+{
+    int order = memcmp(left->term, right->term, left->len < right->len ? left->len : right->len);
+    return order < 0 || (!order && left->len < right->len);
+}
+
+#define TERM_RANK_LESS(a, b) term_rank_less(&(a), &(b))
+DEFINE_SORT(term_rank_sort, term_rank_t, TERM_RANK_LESS)
+
+/*
+
+ranks[id] is the place of term id among all terms in bytewise order (a prefix first), for
+every id below shared_term_table_count. Unlike the ids, the ranks do not depend on the
+threads. Only valid once no thread is interning anymore.
+
+*/
+
+bool shared_term_table_rank(const shared_term_table_t *table, uint32_t *ranks)
+{
+    size_t count = shared_term_table_count(table);
+    term_rank_t *terms = (term_rank_t *)malloc(sizeof(term_rank_t) * (count ? count : 1));
+    if (!terms)
+    {
+        return false;
+    }
+
+    for (size_t id = 0; id < count; id++)
+    {
+        terms[id].term = shared_term_table_term(table, (uint32_t)id, &terms[id].len);
+        terms[id].id = (uint32_t)id;
+    }
+
+    term_rank_sort(terms, count);
+    for (size_t rank = 0; rank < count; rank++)
+    {
+        ranks[terms[rank].id] = (uint32_t)rank;
+    }
+
+    free(terms);
+    return true;
+}
+
+size_t shared_term_table_memory(const shared_term_table_t *table)
+{
+    size_t memory = sizeof(uint32_t *) * SHARED_TERM_TABLE_CHUNKS;
+    for (size_t shard = 0; shard < SHARED_TERM_TABLE_SHARDS; shard++)
+    {
+        memory += term_table_memory(&table->shards[shard].table) + sizeof(uint32_t) * table->shards[shard].ids_capacity;
+    }
+
+    size_t chunks = (shared_term_table_count(table) + (1 << SHARED_TERM_TABLE_CHUNK_BITS) - 1) >> SHARED_TERM_TABLE_CHUNK_BITS;
+    return memory + chunks * (sizeof(uint32_t) << SHARED_TERM_TABLE_CHUNK_BITS);
+}
+
+typedef struct
+{
+    shared_term_table_t *shared;
+    term_table_t local;
+    uint32_t *ids; // shared id by local id
+    size_t ids_capacity;
+} term_cache_t;
+
+bool term_cache_init(term_cache_t *cache, shared_term_table_t *shared)
+{
+    if (!cache || !shared)
+    {
+        return false;
+    }
+
+    memset(cache, 0, sizeof(*cache));
+    cache->shared = shared;
+    return term_table_init(&cache->local, 0);
+}
+
+void term_cache_free(term_cache_t *cache)
+{
+    if (!cache)
+    {
+        return;
+    }
+
+    term_table_free(&cache->local);
+    free(cache->ids);
+    memset(cache, 0, sizeof(*cache));
+}
+
+// ids[i] = the shared id of tokens[i] of a token block (see tokenizer.h); false when out of memory
+bool term_cache_intern_all(term_cache_t *cache, const char *block, const token_t *tokens, size_t count, uint32_t *ids)
+{
+    size_t known = cache->local.count;
+    if (!term_table_intern_all(&cache->local, block, tokens, count, ids))
+    {
+        return false;
+    }
+
+    size_t terms = cache->local.count;
+    if (terms > cache->ids_capacity)
+    {
+        size_t capacity = cache->ids_capacity ? cache->ids_capacity : 1024;
+        while (capacity < terms)
+        {
+            capacity *= 2;
+        }
+        uint32_t *shared_ids = (uint32_t *)realloc(cache->ids, sizeof(uint32_t) * capacity);
+        if (!shared_ids)
+        {
+            return false;
+        }
+        cache->ids = shared_ids;
+        cache->ids_capacity = capacity;
+    }
+
+    // terms new to this thread; they are in its arena, which is padded like a token block
+    for (size_t local = known; local < terms; local++)
+    {
+        size_t len;
+        const char *term = term_table_term(&cache->local, (uint32_t)local, &len);
+        cache->ids[local] = shared_term_table_intern_hashed(cache->shared, term, len, term_hash(term, len, true), true);
+        if (cache->ids[local] == TERM_TABLE_NONE)
+        {
+            return false;
+        }
+    }
+
+    for (size_t counter = 0; counter < count; counter++)
+    {
+        ids[counter] = cache->ids[ids[counter]];
+    }
+    return true;
+}
+
+#endif /* B0652DDD_7917_4BA9_BDD8_2F12018877F0 */
@@ -0,0 +1,337 @@
+#ifndef D5C8BFB5_7600_40F7_B781_D6B13769ED65
+#define D5C8BFB5_7600_40F7_B781_D6B13769ED65
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./tokenizer.h"
+
+/*
+
+Maps every distinct term to a dense id (0, 1, 2, ... in order of first appearance), so that a
+document becomes an array of counts indexed by id, and two documents that share the table
+can be compared position by position.
+
+A text has few distinct terms and very many occurrences of them, so the table is built for
+lookups of short keys:
+
+- The terms are copied once, when first seen, into one growing arena (offsets[id] is where
+term id starts, offsets[id + 1] where it ends), instead of one allocation per term. Like
+the token blocks, the arena keeps a few bytes of padding, so short terms compare as one
+masked 8-byte load each.
+- The slots are 16 bytes, a 32-bit hash, the id, and the place and length of the term in the
+arena, in an open-addressing table with linear probing that is at most half full. A lookup
+compares the stored hash and length first and touches the arena only when they match, which
+is nearly always the term itself: one slot and one arena access. Growing rehashes from the
+stored hashes, without reading any term.
+- term_table_intern_all hashes a whole block of tokens first and prefetches each slot
+TERM_TABLE_PREFETCH_DISTANCE tokens ahead, so the cache misses of a block overlap.
+
+*/
+
+#define TERM_TABLE_NONE UINT32_MAX
+#define TERM_TABLE_PREFETCH_DISTANCE 16
+#define TERM_TABLE_HASH_BLOCK 256
+#define TERM_TABLE_PADDING 8 // readable bytes after the last arena term, for term_equal
+
+typedef struct
+{
+    uint32_t hash;
+    uint32_t id;     // TERM_TABLE_NONE if the slot is empty
+    uint32_t offset; // of the term in the arena
+    uint32_t len;
+} term_slot_t;
+
+typedef struct
+{
+    term_slot_t *slots;
+    size_t capacity; // a power of two
+    uint32_t *offsets; // count + 1 of them
+    size_t count;
+    size_t offsets_capacity;
+    char *arena;
+    size_t arena_len;
+    size_t arena_capacity;
+} term_table_t;
+
+_Static_assert(TOKENIZER_PADDING >= 8, "padded terms are read 8 bytes at a time");
+
+static inline uint64_t term_load64(const char *bytes)
+{
+    uint64_t word;
+    memcpy(&word, bytes, sizeof(word));
+    return word;
+}
+
+// the last 1 to 8 bytes of a term, zero-extended; padded terms may be read past their end
+static inline uint64_t term_tail(const char *bytes, size_t len, bool padded)
+{
+    if (padded)
+    {
+        return term_load64(bytes) & (~0ULL >> (64 - 8 * len));
+    }
+
+    uint64_t word = 0;
+    memcpy(&word, bytes, len);
+    return word;
+}
+
+/*
+
+Hashes 8 bytes at a time, the last 1 to 8 of them zero-extended. Terms from a token block
+are padded (see tokenizer.h), so their tail is one load and a mask, and the hash of a short
+term has no branch that depends on its length; other terms copy their tail, with the same
+result.
+
+*/
+
+static inline uint32_t term_hash(const char *term, size_t len, bool padded)
+{
+    uint64_t hash = 0x9E3779B97F4A7C15ULL ^ len;
+    size_t offset = 0;
+    for (; offset + 8 < len; offset += 8)
+    {
+        hash = (hash ^ term_load64(term + offset)) * 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 32;
+    }
+
+    if (len)
+    {
+        hash = (hash ^ term_tail(term + offset, len - offset, padded)) * 0xFF51AFD7ED558CCDULL;
+    }
+
+    hash = (hash ^ (hash >> 33)) * 0xC4CEB9FE1A85EC53ULL;
+    return (uint32_t)(hash >> 32);
+}
+
+// compares term with stored, an arena term of the same length
+static inline bool term_equal(const char *term, const char *stored, size_t len, bool padded)
+{
+    if (padded && len && len <= 8)
+    {
+        return !((term_load64(term) ^ term_load64(stored)) & (~0ULL >> (64 - 8 * len)));
+    }
+
+    return !memcmp(term, stored, len);
+}
+
+static bool term_table_allocate_slots(term_table_t *table, size_t capacity)
+{
+    table->slots = (term_slot_t *)malloc(sizeof(term_slot_t) * capacity);
+    if (!table->slots)
+    {
+        return false;
+    }
+
+    for (size_t slot = 0; slot < capacity; slot++)
+    {
+        table->slots[slot].id = TERM_TABLE_NONE;
+    }
+    table->capacity = capacity;
+    return true;
+}
+
+// sizes the table so that expected terms fit without growing
+bool term_table_init(term_table_t *table, size_t expected)
+{
+    if (!table)
+    {
+        return false;
+    }
+
+    memset(table, 0, sizeof(*table));
+    size_t capacity = 64;
+    while (capacity / 2 < expected)
+    {
+        capacity *= 2;
+    }
+
+    table->offsets_capacity = expected + 1 > 64 ? expected + 1 : 64;
+    table->arena_capacity = table->offsets_capacity * 8;
+    table->offsets = (uint32_t *)malloc(sizeof(uint32_t) * table->offsets_capacity);
+    table->arena = (char *)malloc(table->arena_capacity);
+    if (!table->offsets || !table->arena || !term_table_allocate_slots(table, capacity))
+    {
+        free(table->offsets);
+        free(table->arena);
+        memset(table, 0, sizeof(*table));
+        return false;
+    }
+
+    table->offsets[0] = 0;
+    return true;
+}
+
+void term_table_free(term_table_t *table)
+{
+    if (!table)
+    {
+        return;
+    }
+
+    free(table->slots);
+    free(table->offsets);
+    free(table->arena);
+    memset(table, 0, sizeof(*table));
+}
+
+static bool term_table_grow(term_table_t *table)
+{
+    term_slot_t *old = table->slots;
+    size_t old_capacity = table->capacity;
+    if (!term_table_allocate_slots(table, old_capacity * 2))
+    {
+        table->slots = old;
+        return false;
+    }
+
+    size_t mask = table->capacity - 1;
+    for (size_t slot = 0; slot < old_capacity; slot++)
+    {
+        if (old[slot].id != TERM_TABLE_NONE)
+        {
+            size_t target = old[slot].hash & mask;
+            while (table->slots[target].id != TERM_TABLE_NONE)
+            {
+                target = (target + 1) & mask;
+            }
+            table->slots[target] = old[slot];
+        }
+    }
+
+    free(old);
+    return true;
+}
+
+// copies term into the arena as the next id
+static uint32_t term_table_store(term_table_t *table, const char *term, size_t len)
+{
+    if (table->count + 2 > table->offsets_capacity)
+    {
+        uint32_t *offsets = (uint32_t *)realloc(table->offsets, sizeof(uint32_t) * table->offsets_capacity * 2);
+        if (!offsets)
+        {
+            return TERM_TABLE_NONE;
+        }
+        table->offsets = offsets;
+        table->offsets_capacity *= 2;
+    }
+
+    if (table->arena_len + len + TERM_TABLE_PADDING > table->arena_capacity)
+    {
+        size_t capacity = table->arena_capacity * 2;
+        while (table->arena_len + len + TERM_TABLE_PADDING > capacity)
+        {
+            capacity *= 2;
+        }
+        // offsets are 32 bits
+        char *arena = capacity > UINT32_MAX ? NULL : (char *)realloc(table->arena, capacity);
+        if (!arena)
+        {
+            return TERM_TABLE_NONE;
+        }
+        table->arena = arena;
+        table->arena_capacity = capacity;
+    }
+
+    memcpy(table->arena + table->arena_len, term, len);
+    table->arena_len += len;
+    memset(table->arena + table->arena_len, 0, TERM_TABLE_PADDING);
+    table->offsets[table->count + 1] = (uint32_t)table->arena_len;
+    return (uint32_t)table->count++;
+}
+
+static inline uint32_t term_table_intern_hashed(term_table_t *table, const char *term, size_t len, uint32_t hash, bool padded)
+{
+    size_t mask = table->capacity - 1;
+    size_t slot = hash & mask;
+    while (table->slots[slot].id != TERM_TABLE_NONE)
+    {
+        const term_slot_t *candidate = table->slots + slot;
+        if (candidate->hash == hash && candidate->len == len && term_equal(term, table->arena + candidate->offset, len, padded))
+        {
+            return candidate->id;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    if ((table->count + 1) * 2 > table->capacity)
+    {
+        if (!term_table_grow(table))
+        {
+            return TERM_TABLE_NONE;
+        }
+        mask = table->capacity - 1;
+        slot = hash & mask;
+        while (table->slots[slot].id != TERM_TABLE_NONE)
+        {
+            slot = (slot + 1) & mask;
+        }
+    }
+
+    uint32_t id = term_table_store(table, term, len);
+    if (id != TERM_TABLE_NONE)
+    {
+        table->slots[slot].hash = hash;
+        table->slots[slot].id = id;
+        table->slots[slot].offset = table->offsets[id];
+        table->slots[slot].len = (uint32_t)len;
+    }
+    return id;
+}
+
+// id of term, which is added if it is new; TERM_TABLE_NONE when out of memory
+uint32_t term_table_intern(term_table_t *table, const char *term, size_t len)
+{
+    return term_table_intern_hashed(table, term, len, term_hash(term, len, false), false);
+}
+
+// ids[i] = the id of tokens[i] of a token block (see tokenizer.h); false when out of memory
+bool term_table_intern_all(term_table_t *table, const char *block, const token_t *tokens, size_t count, uint32_t *ids)
+{
+    uint32_t hashes[TERM_TABLE_HASH_BLOCK];
+
+    for (size_t first = 0; first < count; first += TERM_TABLE_HASH_BLOCK)
+    {
+        size_t len = count - first < TERM_TABLE_HASH_BLOCK ? count - first : TERM_TABLE_HASH_BLOCK;
+        for (size_t counter = 0; counter < len; counter++)
+        {
+            const token_t *token = tokens + first + counter;
+            hashes[counter] = term_hash(block + token->start, token->len, true);
+        }
+
+        for (size_t counter = 0; counter < len; counter++)
+        {
+            if (counter + TERM_TABLE_PREFETCH_DISTANCE < len)
+            {
+                __builtin_prefetch(table->slots + (hashes[counter + TERM_TABLE_PREFETCH_DISTANCE] & (table->capacity - 1)));
+            }
+
+            const token_t *token = tokens + first + counter;
+            ids[first + counter] = term_table_intern_hashed(table, block + token->start, token->len, hashes[counter], true);
+            if (ids[first + counter] == TERM_TABLE_NONE)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// the bytes of term id (not NUL-terminated), and their number in *len
+const char *term_table_term(const term_table_t *table, uint32_t id, size_t *len)
+{
+    *len = table->offsets[id + 1] - table->offsets[id];
+    return table->arena + table->offsets[id];
+}
+
+size_t term_table_memory(const term_table_t *table)
+{
+    return sizeof(term_slot_t) * table->capacity + sizeof(uint32_t) * table->offsets_capacity + table->arena_capacity;
+}
+
+#endif /* D5C8BFB5_7600_40F7_B781_D6B13769ED65 */
@@ -0,0 +1,268 @@
+#ifndef AE24FAEA_DBF9_4AEC_9188_EB2B3D6A26CD
+#define AE24FAEA_DBF9_4AEC_9188_EB2B3D6A26CD
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+
+Splits text into lowercase words without looking at it one byte at a time.
+
+A word is a maximal run of word bytes: ASCII letters and digits, and every byte >= 0x80, so
+that UTF-8 encoded letters stay inside their words. Everything else separates words. ASCII
+letters are lowercased; other bytes are kept as they are.
+
+The text is processed in blocks of about TOKENIZER_BLOCK_SIZE bytes, each extended to the end
+of the word it cuts, so that no word spans two blocks:
+
+1. Classification: 16 bytes at a time, SSE2 compares find the letters, digits and high bytes,
+one OR with 0x20 on the letters lowercases them into the block buffer, and a movemask gives
+one bit per word byte. Four of those make a 64-bit mask per 64 bytes.
+2. Boundaries: in a mask m, the words start at m & ~(m << 1) and end at ~m & (m << 1) (with
+the last bit of the previous mask shifted in), so the words of 64 bytes are found with a
+couple of bit operations and one count-trailing-zeros per word, whatever their length.
+
+Every block is handed to the consumer as the lowercased bytes and an array of tokens that
+point into them; the consumer returns false to stop. Runs of word bytes longer than
+TOKENIZER_MAX_TOKEN are cut into pieces of at most that length. The block is followed by
+TOKENIZER_PADDING readable bytes, so a consumer may load a whole word past the end of a token.
+
+*/
+
+#define TOKENIZER_BLOCK_SIZE (1 << 16)
+#define TOKENIZER_MAX_TOKEN 256
+#define TOKENIZER_MAX_BLOCK (TOKENIZER_BLOCK_SIZE + TOKENIZER_MAX_TOKEN)
+#define TOKENIZER_MAX_TOKENS (TOKENIZER_MAX_BLOCK / 2 + 1) // a token and its separator take two bytes
+#define TOKENIZER_PADDING 16
+
+typedef struct
+{
+    uint32_t start; // offset in the block
+    uint32_t len;
+} token_t;
+
+typedef bool (*token_consumer_t)(void *context, const char *block, const token_t *tokens, size_t count);
+
+static inline bool is_word_byte(char byte)
+{
+    unsigned char value = (unsigned char)byte;
+    return (unsigned)((value | 0x20) - 'a') < 26 || (unsigned)(value - '0') < 10 || value >= 0x80;
+}
+
+static inline char fold_word_byte(char byte)
+{
+    unsigned char value = (unsigned char)byte;
+    return (unsigned)((value | 0x20) - 'a') < 26 ? (char)(value | 0x20) : byte;
+}
+
+// lowercases len <= 64 bytes of in into out, and returns the mask of the word bytes
+static inline uint64_t tokenizer_classify(const char *in, size_t len, char *out)
+{
+    uint64_t mask = 0;
+    size_t offset = 0;
+
+#ifdef __SSE2__
+    for (; offset + 16 <= len; offset += 16)
+    {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(in + offset));
+        __m128i folded = _mm_or_si128(bytes, _mm_set1_epi8(0x20));
+        __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(folded, _mm_set1_epi8('a' - 1)),
+                                        _mm_cmplt_epi8(folded, _mm_set1_epi8('z' + 1)));
+        __m128i digits = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8('0' - 1)),
+                                       _mm_cmplt_epi8(bytes, _mm_set1_epi8('9' + 1)));
+        __m128i high = _mm_cmplt_epi8(bytes, _mm_setzero_si128());
+
+        _mm_storeu_si128((__m128i *)(out + offset), _mm_or_si128(bytes, _mm_and_si128(letters, _mm_set1_epi8(0x20))));
+        uint64_t words = (uint64_t)(unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(letters, digits), high));
+        mask |= words << offset;
+    }
+#endif
+
+    for (; offset < len; offset++)
+    {
+        out[offset] = fold_word_byte(in[offset]);
+        mask |= (uint64_t)is_word_byte(in[offset]) << offset;
+    }
+
+    return mask;
+}
+
+static inline size_t tokenizer_emit(token_t *tokens, size_t count, size_t start, size_t end)
+{
+    while (end - start > TOKENIZER_MAX_TOKEN)
+    {
+        tokens[count].start = (uint32_t)start;
+        tokens[count].len = TOKENIZER_MAX_TOKEN;
+        count++;
+        start += TOKENIZER_MAX_TOKEN;
+    }
+
+    tokens[count].start = (uint32_t)start;
+    tokens[count].len = (uint32_t)(end - start);
+    return count + 1;
+}
+
+// lowercases text[0, len) (len <= TOKENIZER_MAX_BLOCK) into block and finds its tokens
+size_t tokenize_block(const char *text, size_t len, char *block, token_t *tokens)
+{
+    size_t count = 0;
+    size_t start = 0;
+    bool open = false;
+    uint64_t carry = 0; // the last bit of the previous mask
+
+    for (size_t offset = 0; offset < len; offset += 64)
+    {
+        uint64_t mask = tokenizer_classify(text + offset, len - offset < 64 ? len - offset : 64, block + offset);
+        uint64_t shifted = (mask << 1) | carry;
+        uint64_t starts = mask & ~shifted;
+        uint64_t ends = ~mask & shifted;
+        carry = mask >> 63;
+
+        // starts and ends alternate, so take whichever one the open token is waiting for
+        for (;;)
+        {
+            if (open)
+            {
+                if (!ends)
+                {
+                    break;
+                }
+                size_t end = offset + (size_t)__builtin_ctzll(ends);
+                ends &= ends - 1;
+                count = tokenizer_emit(tokens, count, start, end);
+                open = false;
+            }
+            else
+            {
+                if (!starts)
+                {
+                    break;
+                }
+                start = offset + (size_t)__builtin_ctzll(starts);
+                starts &= starts - 1;
+                open = true;
+            }
+        }
+    }
+
+    if (open)
+    {
+        count = tokenizer_emit(tokens, count, start, len);
+    }
+    return count;
+}
+
+// the buffers of tokenize, which a thread can keep for all its documents
+typedef struct
+{
+    char *block;
+    token_t *tokens;
+} tokenizer_t;
+
+bool tokenizer_init(tokenizer_t *tokenizer)
+{
+    tokenizer->block = (char *)calloc(TOKENIZER_MAX_BLOCK + TOKENIZER_PADDING, 1);
+    tokenizer->tokens = (token_t *)malloc(sizeof(token_t) * TOKENIZER_MAX_TOKENS);
+    if (!tokenizer->block || !tokenizer->tokens)
+    {
+        free(tokenizer->block);
+        free(tokenizer->tokens);
+        return false;
+    }
+
+    return true;
+}
+
+void tokenizer_free(tokenizer_t *tokenizer)
+{
+    free(tokenizer->block);
+    free(tokenizer->tokens);
+    tokenizer->block = NULL;
+    tokenizer->tokens = NULL;
+}
+
+// hands the tokens of text[0, len) to consume block by block; false if consume stopped it
+bool tokenizer_run(tokenizer_t *tokenizer, const char *text, size_t len, token_consumer_t consume, void *context)
+{
+    bool consumed = true;
+    size_t offset = 0;
+    while (consumed && offset < len)
+    {
+        // extend the block to the end of the word it cuts, within TOKENIZER_MAX_TOKEN bytes
+        size_t end = len - offset > TOKENIZER_BLOCK_SIZE ? offset + TOKENIZER_BLOCK_SIZE : len;
+        size_t limit = len - end > TOKENIZER_MAX_TOKEN ? end + TOKENIZER_MAX_TOKEN : len;
+        while (end < limit && is_word_byte(text[end]))
+        {
+            end++;
+        }
+
+        size_t count = tokenize_block(text + offset, end - offset, tokenizer->block, tokenizer->tokens);
+        consumed = consume(context, tokenizer->block, tokenizer->tokens, count);
+        offset = end;
+    }
+
+    return consumed;
+}
+
+// tokenizer_run over a mapping of the file at path; false if it cannot be mapped
+bool tokenizer_run_file(tokenizer_t *tokenizer, const char *path, token_consumer_t consume, void *context)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) < 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    size_t len = (size_t)info.st_size;
+    if (!len)
+    {
+        close(fd);
+        return true;
+    }
+
+    void *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return false;
+    }
+
+    madvise(map, len, MADV_SEQUENTIAL);
+    bool consumed = tokenizer_run(tokenizer, (const char *)map, len, consume, context);
+    munmap(map, len);
+    return consumed;
+}
+
+// tokenizer_run with buffers of its own
+bool tokenize(const char *text, size_t len, token_consumer_t consume, void *context)
+{
+    tokenizer_t tokenizer;
+    if (!tokenizer_init(&tokenizer))
+    {
+        return false;
+    }
+
+    bool consumed = tokenizer_run(&tokenizer, text, len, consume, context);
+    tokenizer_free(&tokenizer);
+    return consumed;
+}
+
+#endif /* AE24FAEA_DBF9_4AEC_9188_EB2B3D6A26CD */
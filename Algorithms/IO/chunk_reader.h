@@ -0,0 +1,106 @@
+#ifndef C3318710_D94E_4C2E_B544_E936B716BF9E
+#define C3318710_D94E_4C2E_B544_E936B716BF9E
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "./parallel_parser.h"
+
+/*
+
+Mapping the whole input only works for regular files. For pipes, and for programs that want
+to start working before the input is complete, the chunk reader reads a file descriptor in
+large pieces and cuts every piece after its last separator, so each chunk holds only whole
+tokens and can be handed to parse_int64_range on its own. The bytes after the cut are kept
+and put in front of the next chunk.
+
+The caller supplies the buffer for every chunk, so chunks can live on in other threads while
+the next one is being read.
+
+*/
+
+#define CHUNK_READER_MAX_CARRY 64 // longer than any valid token, so a longer one is an error
+
+typedef struct
+{
+    int fd;
+    char carry[CHUNK_READER_MAX_CARRY];
+    size_t carry_len;
+    bool eof;
+    bool failed;
+} chunk_reader_t;
+
+void chunk_reader_init(chunk_reader_t *reader, int fd)
+{
+    reader->fd = fd;
+    reader->carry_len = 0;
+    reader->eof = false;
+    reader->failed = false;
+}
+
+/*
+
+Fills out (capacity bytes, at least twice CHUNK_READER_MAX_CARRY) with the next chunk and
+returns its length; 0 means the input is exhausted, or that a read failed or a run of token
+bytes reached CHUNK_READER_MAX_CARRY at the end of a chunk (check reader->failed). Such a run
+is not a number, and cutting it would turn it into two.
+
+*/
+
+size_t chunk_reader_fill(chunk_reader_t *reader, char *out, size_t capacity)
+{
+    if (reader->failed || (reader->eof && !reader->carry_len))
+    {
+        return 0;
+    }
+
+    memcpy(out, reader->carry, reader->carry_len);
+    size_t len = reader->carry_len;
+    reader->carry_len = 0;
+
+    while (!reader->eof && len < capacity)
+    {
+        ssize_t got = read(reader->fd, out + len, capacity - len);
+        if (got < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            reader->failed = true;
+            return 0;
+        }
+        if (!got)
+        {
+            reader->eof = true;
+        }
+        len += (size_t)got;
+    }
+
+    if (reader->eof)
+    {
+        return len;
+    }
+
+    // keep the trailing partial token for the next chunk
+    size_t cut = len;
+    while (cut > 0 && len - cut < CHUNK_READER_MAX_CARRY && is_token_byte(out[cut - 1]))
+    {
+        cut--;
+    }
+    if (len - cut == CHUNK_READER_MAX_CARRY)
+    {
+        reader->failed = true;
+        return 0;
+    }
+
+    memcpy(reader->carry, out + cut, len - cut);
+    reader->carry_len = len - cut;
+    return cut;
+}
+
+#endif /* C3318710_D94E_4C2E_B544_E936B716BF9E */
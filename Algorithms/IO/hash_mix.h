@@ -0,0 +1,41 @@
+#ifndef B7A9BF9F_4402_43F2_9ADC_D312B94DBABA
+#define B7A9BF9F_4402_43F2_9ADC_D312B94DBABA
+
+#include <stdint.h>
+
+/*
+
+The splitmix64 finalizer, shared by the structures that hash 64-bit keys (the swiss table,
+the cuckoo filter, Count-Min, the perfect hash) and by the seed generators. Every input bit
+affects every output bit, and it is a bijection, so distinct keys never collide before the
+caller reduces the hash. Consecutive multiples of SPLITMIX64_GAMMA give independent-looking
+streams, which is how splitmix64 itself draws random numbers.
+
+fmix64 is the finalizer of MurmurHash3, with the same properties; the Bloom filter and the
+HyperLogLog sketch use it, so their hashes stay what they always were.
+
+*/
+
+#define SPLITMIX64_GAMMA 0x9E3779B97F4A7C15ULL
+
+static inline uint64_t splitmix64_mix(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+static inline uint64_t fmix64(uint64_t x)
+{
+    x = (x ^ (x >> 33)) * 0xFF51AFD7ED558CCDULL;
+    x = (x ^ (x >> 33)) * 0xC4CEB9FE1A85EC53ULL;
+    return x ^ (x >> 33);
+}
+
+// the next number of the splitmix64 generator whose state is *state
+static inline uint64_t splitmix64_next(uint64_t *state)
+{
+    return splitmix64_mix(*state += SPLITMIX64_GAMMA);
+}
+
+#endif /* B7A9BF9F_4402_43F2_9ADC_D312B94DBABA */
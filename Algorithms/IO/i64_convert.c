@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "./i64_format.h"
+#include "./int_writer.h"
+
+/*
+
+i64_convert to-binary <input.txt> <output.i64>
+i64_convert to-text <input.i64> <output.txt>
+i64_convert info <input.i64>
+
+*/
+
+int to_binary(const char *input_path, const char *output_path)
+{
+    int64_buffer_t input;
+    if (!load_int64_file_parallel(input_path, &input, 0))
+    {
+        return EXIT_FAILURE;
+    }
+
+    bool written = i64_write_file(output_path, input.nums, input.len);
+
+    int64_buffer_free(&input);
+    return written ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int to_text(const char *input_path, const char *output_path)
+{
+    i64_view_t view;
+    if (!i64_map_file(input_path, &view, false))
+    {
+        return EXIT_FAILURE;
+    }
+
+    int output_fd = open(output_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (output_fd < 0)
+    {
+        i64_unmap_file(&view);
+        return EXIT_FAILURE;
+    }
+
+    int_writer_t writer;
+    if (!int_writer_init(&writer, output_fd, 0))
+    {
+        close(output_fd);
+        i64_unmap_file(&view);
+        return EXIT_FAILURE;
+    }
+
+    int_writer_put_int64_array(&writer, view.nums, view.len, '\n');
+
+    bool written = int_writer_close(&writer);
+    written &= (close(output_fd) == 0);
+    i64_unmap_file(&view);
+    return written ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int info(const char *input_path)
+{
+    i64_view_t view;
+    if (!i64_map_file(input_path, &view, false))
+    {
+        return EXIT_FAILURE;
+    }
+
+    fprintf(stdout, "count %lu\nsorted %d\nmin %ld\nmax %ld\n",
+            view.header.count, view.header.sorted, view.header.min, view.header.max);
+
+    i64_unmap_file(&view);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 4 && !strcmp(argv[1], "to-binary"))
+    {
+        return to_binary(argv[2], argv[3]);
+    }
+    if (argc == 4 && !strcmp(argv[1], "to-text"))
+    {
+        return to_text(argv[2], argv[3]);
+    }
+    if (argc == 3 && !strcmp(argv[1], "info"))
+    {
+        return info(argv[2]);
+    }
+
+    fprintf(stderr, "usage: %s to-binary <input.txt> <output.i64>\n"
+                    "       %s to-text <input.i64> <output.txt>\n"
+                    "       %s info <input.i64>\n",
+            argv[0], argv[0], argv[0]);
+    return EXIT_FAILURE;
+}
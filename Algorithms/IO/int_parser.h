@@ -0,0 +1,351 @@
+#ifndef D3F1516C_C631_41ED_AC59_0708A306033E
+#define D3F1516C_C631_41ED_AC59_0708A306033E
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+
+The sort and search programs used to read their input through strix: the file was split into
+lines, every line was split into tokens twice (once to count them, once to convert them), and
+every token became its own heap-allocated strix_t before strix_to_signed_int looked at it.
+
+This loader maps the file and walks it once, converting the digits in place and appending
+straight into a growable int64_t buffer; no memory is allocated per token.
+
+A token is an optional '-' or '+' immediately followed by a run of decimal digits; every other
+byte is a separator. Values outside the int64_t range wrap around silently.
+
+Digit runs are consumed eight bytes at a time (SWAR, SIMD within a register):
+
+1. The eight bytes are loaded as one little-endian word, so the first character is the lowest byte.
+2. A byte is a digit if its high nibble is 3 and adding 6 to its low nibble does not carry
+out of the nibble; both tests are done for all eight bytes with a few masks and one add,
+and the count of leading digits falls out of a count-trailing-zeros.
+3. The digits are shifted to the top of the word (the vacated low bytes act as leading zeros)
+and combined pairwise in three multiply-shift steps: 8 x 1 digit -> 4 x 2 digits -> 2 x 4
+digits -> 1 x 8 digits.
+
+Near the end of the mapping, where a full word cannot be loaded, the scalar loop takes over.
+
+*/
+
+typedef struct
+{
+    int64_t *nums;
+    size_t len;
+    size_t capacity;
+} int64_buffer_t;
+
+bool int64_buffer_init(int64_buffer_t *buffer, size_t capacity)
+{
+    if (!buffer)
+    {
+        return false;
+    }
+
+    if (!capacity)
+    {
+        capacity = 1;
+    }
+
+    buffer->nums = (int64_t *)malloc(sizeof(int64_t) * capacity);
+    if (!buffer->nums)
+    {
+        return false;
+    }
+
+    buffer->len = 0;
+    buffer->capacity = capacity;
+    return true;
+}
+
+bool int64_buffer_reserve(int64_buffer_t *buffer, size_t capacity)
+{
+    if (capacity <= buffer->capacity)
+    {
+        return true;
+    }
+
+    int64_t *nums = (int64_t *)realloc(buffer->nums, sizeof(int64_t) * capacity);
+    if (!nums)
+    {
+        return false;
+    }
+
+    buffer->nums = nums;
+    buffer->capacity = capacity;
+    return true;
+}
+
+void int64_buffer_free(int64_buffer_t *buffer)
+{
+    if (!buffer)
+    {
+        return;
+    }
+
+    free(buffer->nums);
+    buffer->nums = NULL;
+    buffer->len = 0;
+    buffer->capacity = 0;
+}
+
+typedef struct
+{
+    const char *data;
+    size_t len;
+} mapped_file_t;
+
+// maps the whole file read-only; an empty file maps to data == NULL, len == 0
+bool map_file(const char *path, mapped_file_t *file)
+{
+    if (!path || !file)
+    {
+        return false;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) < 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    file->data = NULL;
+    file->len = (size_t)info.st_size;
+    if (!file->len)
+    {
+        close(fd);
+        return true;
+    }
+
+    void *data = mmap(NULL, file->len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    madvise(data, file->len, MADV_SEQUENTIAL);
+    file->data = (const char *)data;
+    return true;
+}
+
+void unmap_file(mapped_file_t *file)
+{
+    if (!file || !file->data)
+    {
+        return;
+    }
+
+    munmap((void *)file->data, file->len);
+    file->data = NULL;
+    file->len = 0;
+}
+
+#define SWAR_ONES 0x0101010101010101ULL
+#define SWAR_HIGH_BITS 0x8080808080808080ULL
+
+static inline bool is_digit_byte(char c)
+{
+    return (unsigned char)(c - '0') < 10;
+}
+
+// 0x80 in every byte of the word that is not an ASCII digit
+static inline uint64_t swar_non_digit_mask(uint64_t word)
+{
+    uint64_t high_nibble = (word & (0xF0 * SWAR_ONES)) ^ (0x30 * SWAR_ONES);
+    uint64_t low_nibble_overflow = ((word & (0x0F * SWAR_ONES)) + 0x06 * SWAR_ONES) & (0xF0 * SWAR_ONES);
+    uint64_t non_digit = high_nibble | low_nibble_overflow;
+
+    return (((non_digit & (0x7F * SWAR_ONES)) + 0x7F * SWAR_ONES) | non_digit) & SWAR_HIGH_BITS;
+}
+
+static inline uint64_t swar_load(const char *cursor)
+{
+    uint64_t word;
+    memcpy(&word, cursor, sizeof(word));
+    return word;
+}
+
+// converts the eight ASCII digits of word, first digit in the lowest byte
+static inline uint64_t swar_parse_eight_digits(uint64_t word)
+{
+    word = ((word & (0x0F * SWAR_ONES)) * (1 + (10 << 8))) >> 8;
+    word = ((word & 0x00FF00FF00FF00FFULL) * (1 + (100 << 16))) >> 16;
+    return ((word & 0x0000FFFF0000FFFFULL) * (1 + (10000ULL << 32))) >> 32;
+}
+
+static const uint64_t powers_of_ten[9] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+
+// parses the token whose first byte (a digit or a sign followed by a digit) is at cursor
+static inline const char *parse_int64_token(const char *cursor, const char *end, int64_t *value)
+{
+    bool negative = false;
+    if (*cursor == '-' || *cursor == '+')
+    {
+        negative = (*cursor == '-');
+        cursor++;
+    }
+
+    uint64_t magnitude = 0;
+    while (end - cursor >= 8)
+    {
+        uint64_t word = swar_load(cursor);
+        uint64_t non_digit = swar_non_digit_mask(word);
+        int digits = non_digit ? __builtin_ctzll(non_digit) >> 3 : 8;
+        if (!digits)
+        {
+            break;
+        }
+
+        magnitude = magnitude * powers_of_ten[digits] + swar_parse_eight_digits(word << (8 * (8 - digits)));
+        cursor += digits;
+        if (digits < 8)
+        {
+            *value = negative ? (int64_t)(0 - magnitude) : (int64_t)magnitude;
+            return cursor;
+        }
+    }
+
+    while (cursor < end && is_digit_byte(*cursor))
+    {
+        magnitude = magnitude * 10 + (uint64_t)(*cursor - '0');
+        cursor++;
+    }
+
+    *value = negative ? (int64_t)(0 - magnitude) : (int64_t)magnitude;
+    return cursor;
+}
+
+static inline bool starts_token(const char *cursor, const char *end)
+{
+    return is_digit_byte(*cursor) ||
+           ((*cursor == '-' || *cursor == '+') && cursor + 1 < end && is_digit_byte(cursor[1]));
+}
+
+/*
+
+Counts the tokens in [begin, end) without converting them: a token starts at every digit that
+does not follow another digit. begin must not point into the middle of a token.
+
+*/
+
+size_t count_int64_range(const char *begin, const char *end)
+{
+    size_t count = 0;
+    const char *cursor = begin;
+    uint64_t previous_digit = 0; // 1 if the byte before the current word is a digit
+
+    while (end - cursor >= 8)
+    {
+        uint64_t digit = ~swar_non_digit_mask(swar_load(cursor)) & SWAR_HIGH_BITS;
+        uint64_t starts = digit & ~((digit << 8) | (previous_digit << 7));
+        count += (size_t)__builtin_popcountll(starts);
+        previous_digit = digit >> 63;
+        cursor += 8;
+    }
+
+    for (; cursor < end; cursor++)
+    {
+        uint64_t digit = is_digit_byte(*cursor);
+        count += digit & ~previous_digit;
+        previous_digit = digit;
+    }
+
+    return count;
+}
+
+// parses every token in [begin, end) into out, which must have room for all of them
+size_t parse_int64_range(const char *begin, const char *end, int64_t *out)
+{
+    size_t written = 0;
+    const char *cursor = begin;
+
+    while (cursor < end)
+    {
+        if (starts_token(cursor, end))
+        {
+            cursor = parse_int64_token(cursor, end, out + written++);
+        }
+        else
+        {
+            cursor++;
+        }
+    }
+
+    return written;
+}
+
+// parses every token in [begin, end), appending to buffer and growing it as needed
+bool parse_int64_range_into(const char *begin, const char *end, int64_buffer_t *buffer)
+{
+    const char *cursor = begin;
+
+    while (cursor < end)
+    {
+        if (starts_token(cursor, end))
+        {
+            if (buffer->len == buffer->capacity && !int64_buffer_reserve(buffer, buffer->capacity * 2))
+            {
+                return false;
+            }
+            cursor = parse_int64_token(cursor, end, buffer->nums + buffer->len++);
+        }
+        else
+        {
+            cursor++;
+        }
+    }
+
+    return true;
+}
+
+/*
+
+Loads all integers of a text file into a freshly initialized buffer; the buffer is owned by the
+caller afterwards and released with int64_buffer_free. The initial capacity assumes about ten
+bytes per value (what random_gen.py writes) and doubles from there.
+
+*/
+
+bool load_int64_file(const char *path, int64_buffer_t *buffer)
+{
+    mapped_file_t file;
+    if (!map_file(path, &file))
+    {
+        return false;
+    }
+
+    if (!int64_buffer_init(buffer, file.len / 10 + 16))
+    {
+        unmap_file(&file);
+        return false;
+    }
+
+    if (!parse_int64_range_into(file.data, file.data + file.len, buffer))
+    {
+        int64_buffer_free(buffer);
+        unmap_file(&file);
+        return false;
+    }
+
+    unmap_file(&file);
+    return true;
+}
+
+#endif /* D3F1516C_C631_41ED_AC59_0708A306033E */
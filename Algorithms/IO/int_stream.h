@@ -0,0 +1,93 @@
+#ifndef E7AF4691_9A45_4A40_BC76_82BC98137BD3
+#define E7AF4691_9A45_4A40_BC76_82BC98137BD3
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "./chunk_reader.h"
+#include "./i64_format.h"
+
+/*
+
+The sketches in Counting/ look at every value once and keep none of them, so loading a whole
+input first would only cost memory. stream_int64_input hands the values of an input to a
+consumer block by block instead:
+
+- text files and standard input ("-") are read with the chunk reader and parsed one chunk of
+INT_STREAM_CHUNK_SIZE bytes at a time, so memory stays bounded for inputs of any size;
+- .i64 files are mapped and passed on in a single block, straight from the page cache.
+
+The consumer returns false to stop the stream, which then fails.
+
+*/
+
+#define INT_STREAM_CHUNK_SIZE (1 << 20)
+
+typedef bool (*int64_consumer_t)(void *context, const int64_t *values, size_t len);
+
+bool stream_int64_fd(int fd, int64_consumer_t consume, void *context)
+{
+    // a token takes at least two bytes with its separator, which bounds the values per chunk
+    char *chunk = (char *)malloc(INT_STREAM_CHUNK_SIZE);
+    int64_t *values = (int64_t *)malloc(sizeof(int64_t) * (INT_STREAM_CHUNK_SIZE / 2 + 1));
+    if (!chunk || !values)
+    {
+        free(chunk);
+        free(values);
+        return false;
+    }
+
+    chunk_reader_t reader;
+    chunk_reader_init(&reader, fd);
+
+    bool consumed = true;
+    size_t len;
+    while (consumed && (len = chunk_reader_fill(&reader, chunk, INT_STREAM_CHUNK_SIZE)))
+    {
+        size_t count = parse_int64_range(chunk, chunk + len, values);
+        consumed = consume(context, values, count);
+    }
+
+    free(chunk);
+    free(values);
+    return consumed && !reader.failed;
+}
+
+bool stream_int64_input(const char *path, int64_consumer_t consume, void *context)
+{
+    if (!strcmp(path, "-"))
+    {
+        return stream_int64_fd(STDIN_FILENO, consume, context);
+    }
+
+    if (is_i64_file(path))
+    {
+        i64_view_t view;
+        if (!i64_map_file(path, &view, false))
+        {
+            return false;
+        }
+
+        madvise(view.map, view.map_len, MADV_SEQUENTIAL);
+        bool consumed = consume(context, view.nums, view.len);
+        i64_unmap_file(&view);
+        return consumed;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    bool consumed = stream_int64_fd(fd, consume, context);
+    close(fd);
+    return consumed;
+}
+
+#endif /* E7AF4691_9A45_4A40_BC76_82BC98137BD3 */
@@ -0,0 +1,262 @@
+#ifndef E022AE66_5D75_419E_BF62_0F916F215FFE
+#define E022AE66_5D75_419E_BF62_0F916F215FFE
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "./i64_format.h"
+
+/*
+
+Printing 10^8 values with fprintf(stdout, "%ld\n", ...) spends most of its time parsing the
+format string and taking the stdio lock, once per value. The writer avoids both:
+
+1. Values are formatted by hand into a large buffer: digits are produced two at a time from
+a 200-byte table of the pairs "00" to "99", so a ten-digit value takes five divisions.
+2. The buffer goes out with write(2) only when it is full (or on flush), so the number of
+system calls is the output size divided by the buffer size.
+3. The binary .i64 format is emitted with a single writev of the header and the values,
+straight from the caller's array.
+
+A writer that fails once stays failed; every later call is a no-op and int_writer_close
+reports the failure.
+
+*/
+
+#define INT_WRITER_DEFAULT_CAPACITY (1 << 20)
+#define INT_WRITER_MAX_INT64_LEN 21 // sign, 19 digits and the terminator
+
+typedef struct
+{
+    int fd;
+    char *buffer;
+    size_t len;
+    size_t capacity;
+    bool failed;
+} int_writer_t;
+
+static const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+bool int_writer_init(int_writer_t *writer, int fd, size_t capacity)
+{
+    if (!writer)
+    {
+        return false;
+    }
+
+    if (capacity < INT_WRITER_MAX_INT64_LEN)
+    {
+        capacity = INT_WRITER_DEFAULT_CAPACITY;
+    }
+
+    writer->buffer = (char *)malloc(capacity);
+    if (!writer->buffer)
+    {
+        return false;
+    }
+
+    writer->fd = fd;
+    writer->len = 0;
+    writer->capacity = capacity;
+    writer->failed = false;
+    return true;
+}
+
+// writes all of data, retrying on short writes and interrupts
+static bool write_fully(int fd, const char *data, size_t len)
+{
+    while (len)
+    {
+        ssize_t written = write(fd, data, len);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+
+        data += written;
+        len -= (size_t)written;
+    }
+
+    return true;
+}
+
+bool int_writer_flush(int_writer_t *writer)
+{
+    if (writer->failed)
+    {
+        return false;
+    }
+
+    if (writer->len && !write_fully(writer->fd, writer->buffer, writer->len))
+    {
+        writer->failed = true;
+        return false;
+    }
+
+    writer->len = 0;
+    return true;
+}
+
+// formats value followed by terminator; returns the number of bytes written to out
+static inline size_t format_int64(char *out, int64_t value, char terminator)
+{
+    char digits[20];
+    char *cursor = digits + sizeof(digits);
+
+    uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    while (magnitude >= 100)
+    {
+        uint64_t pair = magnitude % 100;
+        magnitude /= 100;
+        cursor -= 2;
+        memcpy(cursor, digit_pairs + 2 * pair, 2);
+    }
+
+    if (magnitude >= 10)
+    {
+        cursor -= 2;
+        memcpy(cursor, digit_pairs + 2 * magnitude, 2);
+    }
+    else
+    {
+        *--cursor = (char)('0' + magnitude);
+    }
+
+    size_t len = 0;
+    if (value < 0)
+    {
+        out[len++] = '-';
+    }
+
+    size_t digit_count = (size_t)(digits + sizeof(digits) - cursor);
+    memcpy(out + len, cursor, digit_count);
+    len += digit_count;
+    out[len++] = terminator;
+
+    return len;
+}
+
+static inline void int_writer_put_int64(int_writer_t *writer, int64_t value, char terminator)
+{
+    if (writer->capacity - writer->len < INT_WRITER_MAX_INT64_LEN && !int_writer_flush(writer))
+    {
+        return;
+    }
+
+    writer->len += format_int64(writer->buffer + writer->len, value, terminator);
+}
+
+bool int_writer_put_int64_array(int_writer_t *writer, const int64_t *nums, size_t len, char terminator)
+{
+    for (size_t counter = 0; counter < len && !writer->failed; counter++)
+    {
+        int_writer_put_int64(writer, nums[counter], terminator);
+    }
+
+    return !writer->failed;
+}
+
+// writes len raw bytes; large blocks bypass the buffer
+bool int_writer_put_raw(int_writer_t *writer, const void *data, size_t len)
+{
+    if (writer->failed)
+    {
+        return false;
+    }
+
+    if (len <= writer->capacity - writer->len)
+    {
+        memcpy(writer->buffer + writer->len, data, len);
+        writer->len += len;
+        return true;
+    }
+
+    if (!int_writer_flush(writer) || !write_fully(writer->fd, (const char *)data, len))
+    {
+        writer->failed = true;
+        return false;
+    }
+
+    return true;
+}
+
+// emits nums as a complete .i64 file (header and payload) at the writer's current position
+bool int_writer_put_i64(int_writer_t *writer, const int64_t *nums, size_t len)
+{
+    if (!int_writer_flush(writer) || !host_is_little_endian())
+    {
+        writer->failed = true;
+        return false;
+    }
+
+    i64_header_t header;
+    i64_fill_header(&header, nums, len);
+
+    struct iovec parts[2];
+    parts[0].iov_base = &header;
+    parts[0].iov_len = sizeof(header);
+    parts[1].iov_base = (void *)nums;
+    parts[1].iov_len = sizeof(int64_t) * len;
+
+    size_t part = 0;
+    while (part < 2)
+    {
+        ssize_t written = writev(writer->fd, parts + part, (int)(2 - part));
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            writer->failed = true;
+            return false;
+        }
+
+        // skip the parts that went out completely and advance into the first partial one
+        while (part < 2 && (size_t)written >= parts[part].iov_len)
+        {
+            written -= (ssize_t)parts[part].iov_len;
+            part++;
+        }
+        if (part < 2)
+        {
+            parts[part].iov_base = (char *)parts[part].iov_base + written;
+            parts[part].iov_len -= (size_t)written;
+        }
+    }
+
+    return true;
+}
+
+// flushes and releases the buffer; the file descriptor stays open
+bool int_writer_close(int_writer_t *writer)
+{
+    bool flushed = int_writer_flush(writer);
+
+    free(writer->buffer);
+    writer->buffer = NULL;
+    writer->capacity = 0;
+    return flushed;
+}
+
+#endif /* E022AE66_5D75_419E_BF62_0F916F215FFE */
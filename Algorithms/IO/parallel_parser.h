@@ -0,0 +1,204 @@
+#ifndef CA4DBF9E_B6F9_45D7_843F_443B6E1D6018
+#define CA4DBF9E_B6F9_45D7_843F_443B6E1D6018
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "./int_parser.h"
+
+/*
+
+A single parsing thread leaves every other core idle while a multi-gigabyte input loads.
+The parallel loader keeps the count-then-fill shape the programs always had, but runs each
+pass on all cores:
+
+1. The mapped file is cut into one byte range per thread. Every cut is moved forward to the
+next separator, so that no token straddles two ranges.
+2. Every thread counts the tokens in its range (count_int64_range never converts anything).
+3. A prefix sum over the counts gives each range its offset in the output array, which is
+allocated once with the exact size.
+4. Every thread parses its range straight into its own slice of that array.
+
+The threads never write to the same part of the output, so no synchronization is needed
+beyond joining them between the passes. Load time scales with the core count until the
+page cache or the disk becomes the bottleneck.
+
+*/
+
+#define PARALLEL_PARSE_MIN_BYTES_PER_THREAD (1 << 20)
+#define PARALLEL_PARSE_MAX_THREADS 256
+
+typedef struct
+{
+    const char *begin;
+    const char *end;
+    size_t count;
+    int64_t *out;
+} parse_range_t;
+
+static inline bool is_token_byte(char c)
+{
+    return is_digit_byte(c) || c == '-' || c == '+';
+}
+
+// moves pos forward until it no longer points into a token
+static size_t align_to_separator(const char *data, size_t len, size_t pos)
+{
+    while (pos < len && pos > 0 && is_token_byte(data[pos - 1]) && is_token_byte(data[pos]))
+    {
+        pos++;
+    }
+
+    return pos;
+}
+
+static void *count_range_worker(void *arg)
+{
+    parse_range_t *range = (parse_range_t *)arg;
+    range->count = count_int64_range(range->begin, range->end);
+    return NULL;
+}
+
+static void *parse_range_worker(void *arg)
+{
+    parse_range_t *range = (parse_range_t *)arg;
+    parse_int64_range(range->begin, range->end, range->out);
+    return NULL;
+}
+
+/*
+
+Runs worker on each of threads tasks (at most PARALLEL_PARSE_MAX_THREADS), which lie stride
+bytes apart from tasks on: task 0 on the calling thread, every other one on a thread of its
+own, or inline if its thread cannot be started. Returns once all of them are done.
+
+*/
+
+void run_workers(void *tasks, size_t stride, size_t threads, void *(*worker)(void *))
+{
+    pthread_t ids[PARALLEL_PARSE_MAX_THREADS];
+    bool started[PARALLEL_PARSE_MAX_THREADS];
+    char *base = (char *)tasks;
+
+    for (size_t counter = 1; counter < threads; counter++)
+    {
+        started[counter] = !pthread_create(&ids[counter], NULL, worker, base + counter * stride);
+        if (!started[counter])
+        {
+            worker(base + counter * stride);
+        }
+    }
+
+    worker(tasks);
+
+    for (size_t counter = 1; counter < threads; counter++)
+    {
+        if (started[counter])
+        {
+            pthread_join(ids[counter], NULL);
+        }
+    }
+}
+
+size_t default_parse_threads(void)
+{
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    if (online < 1)
+    {
+        return 1;
+    }
+
+    return online > PARALLEL_PARSE_MAX_THREADS ? PARALLEL_PARSE_MAX_THREADS : (size_t)online;
+}
+
+/*
+
+Parses [data, data + len) on up to threads threads (0 picks one per online core) into a
+buffer of exactly the right size. The buffer is initialized here and owned by the caller.
+
+*/
+
+bool parse_int64_parallel(const char *data, size_t len, int64_buffer_t *buffer, size_t threads)
+{
+    if (!threads)
+    {
+        threads = default_parse_threads();
+    }
+    if (threads > PARALLEL_PARSE_MAX_THREADS)
+    {
+        threads = PARALLEL_PARSE_MAX_THREADS;
+    }
+    if (threads > len / PARALLEL_PARSE_MIN_BYTES_PER_THREAD)
+    {
+        threads = len / PARALLEL_PARSE_MIN_BYTES_PER_THREAD;
+    }
+    if (!threads)
+    {
+        threads = 1;
+    }
+
+    parse_range_t ranges[PARALLEL_PARSE_MAX_THREADS];
+    size_t cut = 0;
+    for (size_t counter = 0; counter < threads; counter++)
+    {
+        size_t next = (counter + 1 == threads) ? len : align_to_separator(data, len, len / threads * (counter + 1));
+        if (next < cut)
+        {
+            next = cut;
+        }
+
+        ranges[counter].begin = data + cut;
+        ranges[counter].end = data + next;
+        cut = next;
+    }
+
+    run_workers(ranges, sizeof(parse_range_t), threads, count_range_worker);
+
+    size_t total = 0;
+    for (size_t counter = 0; counter < threads; counter++)
+    {
+        total += ranges[counter].count;
+    }
+
+    if (!int64_buffer_init(buffer, total))
+    {
+        return false;
+    }
+
+    size_t offset = 0;
+    for (size_t counter = 0; counter < threads; counter++)
+    {
+        ranges[counter].out = buffer->nums + offset;
+        offset += ranges[counter].count;
+    }
+
+    run_workers(ranges, sizeof(parse_range_t), threads, parse_range_worker);
+
+    buffer->len = total;
+    return true;
+}
+
+bool load_int64_file_parallel(const char *path, int64_buffer_t *buffer, size_t threads)
+{
+    mapped_file_t file;
+    if (!map_file(path, &file))
+    {
+        return false;
+    }
+
+    if (file.len)
+    {
+        madvise((void *)file.data, file.len, MADV_WILLNEED);
+    }
+
+    bool parsed = parse_int64_parallel(file.data, file.len, buffer, threads);
+
+    unmap_file(&file);
+    return parsed;
+}
+
+#endif /* CA4DBF9E_B6F9_45D7_843F_443B6E1D6018 */
@@ -0,0 +1,233 @@
+#ifndef DFE69FB9_4DC2_475D_AC5B_363541FFEEB1
+#define DFE69FB9_4DC2_475D_AC5B_363541FFEEB1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "../Sorting/sort_template.h"
+#include "./eytzinger.h"
+#include "./search_kernel.h"
+
+/*
+
+A single search over a large array is a chain of dependent cache misses: the address of the
+next probe is only known once the current one has arrived. A batch of independent queries
+does not have that problem, as long as the searches are interleaved so that the processor
+sees the loads of many of them at once.
+
+1. Interleaved: groups of BATCH_SEARCH_GROUP queries advance through the branchless kernel
+in lockstep. All of them take the same number of steps (it depends only on the length),
+so the group shares one loop, and at every step both candidate probes of the following
+step are prefetched. With 16 searches in flight, the misses overlap instead of adding up.
+2. Eytzinger: the same lockstep over an eytzinger_t index, where the next probes of a query
+are adjacent and a single prefetch covers them.
+3. Sorted queries: for batches that are large compared to the array, the queries are
+sorted first (keeping their original indices) and answered in one left-to-right sweep,
+galloping forward from the previous answer. Consecutive answers are then close together,
+so the sweep costs O(count log(len / count)) comparisons and touches the array sequentially.
+
+All variants compute lower bounds (ranks); batch_search turns them into exact-match
+positions, -1 for keys that are not present.
+
+*/
+
+#define BATCH_SEARCH_GROUP 16
+
+typedef enum
+{
+    BATCH_INTERLEAVED = 0,
+    BATCH_SORTED_QUERIES = 1
+} batch_mode_t;
+
+static void lower_bound_group(const int64_t *nums, size_t len, const int64_t *queries, size_t group, int64_t *results)
+{
+    const int64_t *base[BATCH_SEARCH_GROUP];
+    for (size_t lane = 0; lane < group; lane++)
+    {
+        base[lane] = nums;
+    }
+
+    size_t remaining = len;
+    while (remaining > 1)
+    {
+        size_t half = remaining / 2;
+        size_t next_half = (remaining - half) / 2;
+
+        for (size_t lane = 0; lane < group; lane++)
+        {
+            base[lane] = (base[lane][half - 1] < queries[lane]) ? base[lane] + half : base[lane];
+            if (next_half)
+            {
+                __builtin_prefetch(base[lane] + next_half - 1);
+                __builtin_prefetch(base[lane] + next_half + next_half - 1);
+            }
+        }
+
+        remaining -= half;
+    }
+
+    for (size_t lane = 0; lane < group; lane++)
+    {
+        results[lane] = (int64_t)(base[lane] - nums) + (*base[lane] < queries[lane]);
+    }
+}
+
+// results[i] = index of the first element of nums not less than queries[i]
+void batch_lower_bound(const int64_t *nums, size_t len, const int64_t *queries, size_t count, int64_t *results)
+{
+    if (!len)
+    {
+        for (size_t counter = 0; counter < count; counter++)
+        {
+            results[counter] = 0;
+        }
+        return;
+    }
+
+    for (size_t start = 0; start < count; start += BATCH_SEARCH_GROUP)
+    {
+        size_t group = count - start < BATCH_SEARCH_GROUP ? count - start : BATCH_SEARCH_GROUP;
+        lower_bound_group(nums, len, queries + start, group, results + start);
+    }
+}
+
+void batch_eytzinger_lower_bound(const eytzinger_t *index, const int64_t *queries, size_t count, int64_t *results)
+{
+    const int64_t *tree = index->tree;
+    size_t len = index->len;
+
+    // every query takes the full levels in lockstep; only the last, partial level differs
+    int full_levels = 0;
+    while (((size_t)2 << full_levels) - 1 <= len)
+    {
+        full_levels++;
+    }
+
+    for (size_t start = 0; start < count; start += BATCH_SEARCH_GROUP)
+    {
+        size_t group = count - start < BATCH_SEARCH_GROUP ? count - start : BATCH_SEARCH_GROUP;
+        const int64_t *lane_queries = queries + start;
+        size_t k[BATCH_SEARCH_GROUP];
+
+        for (size_t lane = 0; lane < group; lane++)
+        {
+            k[lane] = 1;
+        }
+
+        for (int level = 0; level < full_levels; level++)
+        {
+            for (size_t lane = 0; lane < group; lane++)
+            {
+                __builtin_prefetch(tree + k[lane] * EYTZINGER_PREFETCH_STRIDE);
+                k[lane] = 2 * k[lane] + (tree[k[lane]] < lane_queries[lane]);
+            }
+        }
+
+        for (size_t lane = 0; lane < group; lane++)
+        {
+            size_t slot = k[lane];
+            if (slot <= len)
+            {
+                slot = 2 * slot + (tree[slot] < lane_queries[lane]);
+            }
+            slot >>= __builtin_ffsll((long long)~slot);
+            results[start + lane] = index->positions[slot];
+        }
+    }
+}
+
+typedef struct
+{
+    int64_t query;
+    size_t index;
+} batch_query_t;
+
+#define BATCH_QUERY_LESS(a, b) ((a).query < (b).query)
+DEFINE_SORT(batch_sort_queries, batch_query_t, BATCH_QUERY_LESS)
+
+// lower bound of x in nums[from, len), searching exponentially forward from from
+static size_t gallop_lower_bound(const int64_t *nums, size_t len, size_t from, int64_t x)
+{
+    size_t step = 1;
+    size_t bound = from;
+    while (bound < len && nums[bound] < x)
+    {
+        from = bound + 1;
+        bound += step;
+        step <<= 1;
+    }
+    if (bound > len)
+    {
+        bound = len;
+    }
+
+    return from + branchless_lower_bound(nums + from, bound - from, x);
+}
+
+bool batch_lower_bound_sorted(const int64_t *nums, size_t len, const int64_t *queries, size_t count, int64_t *results)
+{
+    batch_query_t *order = (batch_query_t *)malloc(sizeof(batch_query_t) * (count ? count : 1));
+    if (!order)
+    {
+        return false;
+    }
+
+    for (size_t counter = 0; counter < count; counter++)
+    {
+        order[counter].query = queries[counter];
+        order[counter].index = counter;
+    }
+    batch_sort_queries(order, count);
+
+    size_t cursor = 0;
+    for (size_t counter = 0; counter < count; counter++)
+    {
+        cursor = gallop_lower_bound(nums, len, cursor, order[counter].query);
+        results[order[counter].index] = (int64_t)cursor;
+    }
+
+    free(order);
+    return true;
+}
+
+// turns lower bounds into positions of exact matches, -1 where the key is absent
+void lower_bounds_to_matches(const int64_t *nums, size_t len, const int64_t *queries, size_t count, int64_t *results)
+{
+    for (size_t counter = 0; counter < count; counter++)
+    {
+        int64_t position = results[counter];
+        if ((size_t)position >= len || nums[position] != queries[counter])
+        {
+            results[counter] = -1;
+        }
+    }
+}
+
+bool batch_search(const int64_t *nums, size_t len, const int64_t *queries, size_t count, int64_t *results, batch_mode_t mode)
+{
+    if (mode == BATCH_SORTED_QUERIES)
+    {
+        if (!batch_lower_bound_sorted(nums, len, queries, count, results))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        batch_lower_bound(nums, len, queries, count, results);
+    }
+
+    lower_bounds_to_matches(nums, len, queries, count, results);
+    return true;
+}
+
+bool batch_eytzinger_search(const eytzinger_t *index, const int64_t *sorted, const int64_t *queries, size_t count, int64_t *results)
+{
+    batch_eytzinger_lower_bound(index, queries, count, results);
+    lower_bounds_to_matches(sorted, index->len, queries, count, results);
+    return true;
+}
+
+#endif /* DFE69FB9_4DC2_475D_AC5B_363541FFEEB1 */
@@ -1,137 +1,443 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include "../../Strix/header/strix.h"
+#include <stdint.h>
+#include <string.h>
+#include "../IO/i64_format.h"
+#include "../IO/int_writer.h"
+#include "../Sorting/natural_merge_sort.h"
+#include "./batch_search.h"
+#include "./bloom_filter.h"
+#include "./cuckoo_filter.h"
+#include "./eytzinger.h"
+#include "./learned_index.h"
+#include "./perfect_hash.h"
+#include "./range_query.h"
+#include "./static_btree.h"
 
-void insertion_sort(int64_t *nums, int64_t len)
+// position of the first element equal to num, or -1
+int64_t binary_search(int64_t *num_arr, int64_t num, int64_t len)
 {
-    if (!nums || !len)
+    if (!num_arr || !len)
     {
-        return;
+        return -1;
     }
-    for (int64_t counter = 1; counter < len; counter++)
+
+    int64_t position = lower_bound(num_arr, len, num);
+    if (position == len || num_arr[position] != num)
     {
-        int64_t j = counter - 1;
-        while (j >= 0 && nums[j] > nums[j + 1])
+        return -1;
+    }
+
+    return position;
+}
+
+/*
+
+Builds the perfect hash index over the distinct keys of the sorted array, each mapped to the
+position of its first copy. With a path, an index saved there by an earlier run is mapped
+instead, as long as it was built from the same keys and positions; otherwise a fresh one is
+built and saved there.
+
+*/
+
+bool load_perfect_hash(perfect_hash_t *index, const int64_t *nums, int64_t len, const char *path)
+{
+    int64_t *keys = (int64_t *)malloc(sizeof(int64_t) * (len ? (size_t)len * 2 : 1));
+    if (!keys)
+    {
+        return false;
+    }
+    int64_t *positions = keys + len;
+
+    size_t distinct = 0;
+    for (int64_t counter = 0; counter < len; counter++)
+    {
+        if (!counter || nums[counter] != nums[counter - 1])
         {
-            int64_t temp = nums[j + 1];
-            nums[j + 1] = nums[j];
-            nums[j] = temp;
-            j--;
+            keys[distinct] = nums[counter];
+            positions[distinct] = counter;
+            distinct++;
         }
     }
+
+    bool stale = false;
+    if (path && perfect_hash_map(index, path, distinct, perfect_hash_checksum(keys, positions, distinct), &stale))
+    {
+        free(keys);
+        return true;
+    }
+    if (stale)
+    {
+        fprintf(stderr, "perfect_hash: %s was built from other keys, rebuilding it\n", path);
+    }
+
+    bool built = perfect_hash_build(index, keys, positions, distinct, 0, 0);
+    free(keys);
+    if (built && path && !perfect_hash_save(index, path))
+    {
+        perfect_hash_free(index);
+        return false;
+    }
+
+    return built;
 }
 
-int64_t binary_search(int64_t *num_arr, int64_t num, int64_t len)
+// whether answer_queries knows mode
+bool known_mode(const char *mode)
 {
-    if (!num_arr || !len)
+    static const char *modes[] = {"binary", "eytzinger", "btree", "learned", "sorted"};
+    for (size_t counter = 0; counter < sizeof(modes) / sizeof(modes[0]); counter++)
     {
-        return -1;
+        if (!strcmp(mode, modes[counter]))
+        {
+            return true;
+        }
     }
+    return !strncmp(mode, "perfect", 7) && (!mode[7] || mode[7] == '=');
+}
 
-    int64_t front = 0;
-    int64_t end = len - 1;
+bool answer_queries(const int64_t *nums, int64_t len, const int64_t *queries, size_t count, const char *mode, int64_t *results)
+{
+    if (!strcmp(mode, "eytzinger"))
+    {
+        eytzinger_t index;
+        if (!eytzinger_build(&index, nums, (size_t)len))
+        {
+            return false;
+        }
+        batch_eytzinger_search(&index, nums, queries, count, results);
+        eytzinger_free(&index);
+        return true;
+    }
 
-    while (front <= end)
+    if (!strcmp(mode, "btree"))
     {
-        int64_t mid = (front + end) / 2;
+        static_btree_t index;
+        if (!static_btree_build(&index, nums, (size_t)len))
+        {
+            return false;
+        }
+
+        size_t bytes = static_btree_memory(&index);
+        fprintf(stderr, "static_btree: %zu bytes besides the sorted keys (%.2f%% of them), leaves included\n",
+                bytes, len ? 100.0 * (double)bytes / (double)(sizeof(int64_t) * (size_t)len) : 0.0);
 
-        if (num_arr[mid] == num)
+        for (size_t counter = 0; counter < count; counter++)
         {
-            return (int64_t)mid;
+            results[counter] = static_btree_search(&index, queries[counter]);
         }
-        else if (num_arr[mid] > num)
+        static_btree_free(&index);
+        return true;
+    }
+
+    if (!strcmp(mode, "learned"))
+    {
+        learned_index_t index;
+        if (!learned_index_build(&index, nums, (size_t)len, 0))
         {
-            end = mid - 1;
+            return false;
         }
-        else
+
+        fprintf(stderr, "learned_index: %zu segments%s\n", index.segment_count,
+                index.fallback ? ", keys too skewed, using binary search" : "");
+
+        for (size_t counter = 0; counter < count; counter++)
         {
-            front = mid + 1;
+            results[counter] = learned_index_search(&index, queries[counter]);
         }
+        learned_index_free(&index);
+        return true;
     }
 
-    return -1;
-}
-
-int main(int argc, char **argv)
-{
-    if (argc < 3)
+    if (!strncmp(mode, "perfect", 7) && (!mode[7] || mode[7] == '='))
     {
-        return EXIT_FAILURE;
+        perfect_hash_t index;
+        if (!load_perfect_hash(&index, nums, len, mode[7] ? mode + 8 : NULL))
+        {
+            return false;
+        }
+
+        fprintf(stderr, "perfect_hash: %.2f bits per key, %zu bytes with the entries\n",
+                perfect_hash_bits_per_key(&index), index.memory_len);
+
+        for (size_t counter = 0; counter < count; counter++)
+        {
+            results[counter] = perfect_hash_find(&index, queries[counter]);
+        }
+        perfect_hash_free(&index);
+        return true;
     }
-    strix_t *input_strix = conv_file_to_strix(argv[2]);
-    if (!input_strix)
+
+    if (!strcmp(mode, "sorted"))
     {
-        return EXIT_FAILURE;
+        return batch_search(nums, (size_t)len, queries, count, results, BATCH_SORTED_QUERIES);
     }
 
-    strix_arr_t *lines = strix_split_by_delim(input_strix, '\n');
-    if (!lines)
+    if (strcmp(mode, "binary"))
     {
-        strix_free(input_strix);
-        return EXIT_FAILURE;
+        fprintf(stderr, "unknown mode %s\n", mode);
+        return false;
     }
 
-    strix_free(input_strix);
+    if (count == 1)
+    {
+        results[0] = binary_search((int64_t *)nums, queries[0], len);
+        return true;
+    }
 
-    int64_t num_len = 0;
+    return batch_search(nums, (size_t)len, queries, count, results, BATCH_INTERLEAVED);
+}
 
-    for (int64_t counter = 0; counter < lines->len; counter++)
+// *cuckoo and *bits_per_key (0 for the default) from filter, or false with a message
+bool parse_filter(const char *filter, bool *cuckoo, size_t *bits_per_key)
+{
+    *cuckoo = !strcmp(filter, "cuckoo");
+    *bits_per_key = 0;
+    if (!*cuckoo && strcmp(filter, "bloom"))
     {
-        strix_t *line = lines->strix_arr[counter];
-        position_t *pos = strix_find_all(line, " ");
-        if (!pos)
+        // bloom=<bits per key>, a positive number and nothing else
+        char *end = NULL;
+        bool digits = !strncmp(filter, "bloom=", 6) && filter[6] >= '0' && filter[6] <= '9';
+        unsigned long long bits = digits ? strtoull(filter + 6, &end, 10) : 0;
+        if (!digits || *end || !bits || bits > SIZE_MAX)
         {
-            strix_free(input_strix);
-            strix_free_strix_arr(lines);
-            return EXIT_FAILURE;
+            fprintf(stderr, "unknown filter %s, expected bloom, bloom=<bits per key> or cuckoo\n", filter);
+            return false;
         }
+        *bits_per_key = (size_t)bits;
+    }
+    return true;
+}
+
+/*
+
+Runs the queries through a membership filter over the keys first (filter is "bloom",
+"bloom=bits per key" or "cuckoo"). Rejected queries are answered -1 right away; only the
+rest reach answer_queries.
 
-        num_len += (pos->len + 1);
+*/
 
-        strix_position_free(pos);
+bool answer_filtered(const int64_t *nums, int64_t len, const int64_t *queries, size_t count, const char *mode, const char *filter, int64_t *results)
+{
+    bool cuckoo;
+    size_t bits_per_key;
+    if (!parse_filter(filter, &cuckoo, &bits_per_key))
+    {
+        return false;
     }
 
-    int64_t *nums = (int64_t *)malloc(sizeof(int64_t) * num_len);
-    if (!nums)
+    bloom_filter_t bloom;
+    cuckoo_filter_t cuckoo_filter;
+    if (cuckoo ? !cuckoo_filter_init(&cuckoo_filter, (size_t)len) : !bloom_filter_init(&bloom, (size_t)len, bits_per_key))
     {
-        strix_free(input_strix);
-        strix_free_strix_arr(lines);
-        return EXIT_FAILURE;
+        return false;
     }
 
-    int64_t nums_written = 0;
+    // the keys are sorted, so the distinct ones are those that differ from their predecessor
+    bool added = true;
+    for (int64_t counter = 0; counter < len && added; counter++)
+    {
+        if (!counter || nums[counter] != nums[counter - 1])
+        {
+            if (cuckoo)
+            {
+                added = cuckoo_filter_add(&cuckoo_filter, nums[counter]);
+            }
+            else
+            {
+                bloom_filter_add(&bloom, nums[counter]);
+            }
+        }
+    }
 
-    for (int64_t counter = 0; counter < lines->len; counter++)
+    int64_t *passed = (int64_t *)malloc(sizeof(int64_t) * (count ? count * 3 : 1));
+    bool answered = false;
+    if (added && passed)
     {
-        strix_t *line = lines->strix_arr[counter];
-        strix_arr_t *num_arr = strix_split_by_delim(line, ' ');
-        if (!num_arr)
+        int64_t *passed_index = passed + count;
+        int64_t *passed_results = passed + 2 * count;
+        size_t passed_count = 0;
+
+        for (size_t counter = 0; counter < count; counter++)
         {
-            strix_free(input_strix);
-            strix_free_strix_arr(lines);
-            free(nums);
-            return EXIT_FAILURE;
+            if (cuckoo ? cuckoo_filter_contains(&cuckoo_filter, queries[counter]) : bloom_filter_contains(&bloom, queries[counter]))
+            {
+                passed[passed_count] = queries[counter];
+                passed_index[passed_count] = (int64_t)counter;
+                passed_count++;
+            }
+            results[counter] = -1;
         }
 
-        for (int64_t index = nums_written; index < num_arr->len + nums_written; index++)
+        fprintf(stderr, "%s filter: %zu bytes, rejected %zu of %zu queries\n", cuckoo ? "cuckoo" : "bloom",
+                cuckoo ? cuckoo_filter_memory(&cuckoo_filter) : bloom_filter_memory(&bloom), count - passed_count, count);
+
+        answered = answer_queries(nums, len, passed, passed_count, mode, passed_results);
+        for (size_t counter = 0; answered && counter < passed_count; counter++)
         {
-            nums[index] = strix_to_signed_int(num_arr->strix_arr[index - nums_written]);
+            results[passed_index[counter]] = passed_results[counter];
         }
+    }
 
-        nums_written += num_arr->len;
+    free(passed);
+    if (cuckoo)
+    {
+        cuckoo_filter_free(&cuckoo_filter);
+    }
+    else
+    {
+        bloom_filter_free(&bloom);
     }
+    return answered;
+}
 
-    strix_free_strix_arr(lines);
+// the queries are consecutive pairs low, high; results[i] is the number of keys in the i-th range
+bool answer_ranges(const int64_t *nums, int64_t len, const int64_t *queries, size_t count, int64_t *results)
+{
+    if (count % 2)
+    {
+        fprintf(stderr, "range reads the queries as pairs low high, but their number, %zu, is odd\n", count);
+        return false;
+    }
 
-    for (int64_t counter = 0; counter < num_len; counter++)
+    size_t ranges = count / 2;
+    int64_t *lows = (int64_t *)malloc(sizeof(int64_t) * (ranges ? ranges * 2 : 1));
+    if (!lows)
     {
-        fprintf(stdout, "%ld\n", nums[counter]);
+        return false;
     }
+    int64_t *highs = lows + ranges;
+
+    for (size_t counter = 0; counter < ranges; counter++)
+    {
+        lows[counter] = queries[2 * counter];
+        highs[counter] = queries[2 * counter + 1];
+    }
+
+    batch_count_in_range(nums, (size_t)len, lows, highs, ranges, results);
+    free(lows);
+    return true;
+}
 
-    insertion_sort(nums, num_len);
+/*
 
-    fprintf(stdout, "%ld\n", binary_search(nums, strtoll(argv[1], NULL, 10), num_len));
+binary_search <query | @queries> <input> [binary | eytzinger | btree | learned | perfect[=index] | sorted | range]
+              [bloom[=bits per key] | cuckoo]
 
-    free(nums);
-    return EXIT_SUCCESS;
-}
\ No newline at end of file
+The input may be text or an .i64 file. The program echoes the input, sorts it (unless the
+.i64 header says it is sorted already) and prints the position of query in the sorted array,
+or -1. With @queries, every value of the query file (text or .i64) is looked up and one
+result is printed per query, in query order. sorted answers the batch by sorting the queries
+first, which pays off for batches that are large compared to the input. btree reports the
+memory used by the index on standard error, learned the number of segments of its model.
+perfect answers from a minimal perfect hash index; perfect=index maps the index saved in
+the file index, or builds and saves it there on the first run. range reads the queries as
+pairs low high and prints, per pair, how many keys lie in [low, high]. With duplicates, the
+position printed is always that of the first copy.
+
+The last argument puts a membership filter in front of the search, which answers most
+misses without touching the sorted array: a blocked Bloom filter (10 bits per key unless
+given) or a cuckoo filter.
+
+*/
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        return EXIT_FAILURE;
+    }
+
+    // the arguments are checked before anything is read or echoed
+    const char *mode = argc > 3 ? argv[3] : "binary";
+    bool ranges = !strcmp(mode, "range");
+    bool cuckoo;
+    size_t bits_per_key;
+    if (ranges && argc > 4)
+    {
+        fprintf(stderr, "range counts keys and takes no filter, got %s\n", argv[4]);
+        return EXIT_FAILURE;
+    }
+    if (!ranges && !known_mode(mode))
+    {
+        fprintf(stderr, "unknown mode %s\n", mode);
+        return EXIT_FAILURE;
+    }
+    if (argc > 4 && !parse_filter(argv[4], &cuckoo, &bits_per_key))
+    {
+        return EXIT_FAILURE;
+    }
+
+    int64_input_t input;
+    if (!load_int64_input(argv[2], &input, true))
+    {
+        return EXIT_FAILURE;
+    }
+
+    int64_t *nums = input.nums;
+    int64_t num_len = (int64_t)input.len;
+
+    int_writer_t writer;
+    if (!int_writer_init(&writer, STDOUT_FILENO, 0))
+    {
+        free_int64_input(&input);
+        return EXIT_FAILURE;
+    }
+
+    int_writer_put_int64_array(&writer, nums, (size_t)num_len, '\n');
+
+    if (!input.sorted && !natural_merge_sort(nums, num_len))
+    {
+        int_writer_close(&writer);
+        free_int64_input(&input);
+        return EXIT_FAILURE;
+    }
+
+    int64_input_t query_input;
+    memset(&query_input, 0, sizeof(query_input));
+    int64_t single_query = 0;
+    const int64_t *queries = &single_query;
+    size_t query_len = 1;
+
+    if (argv[1][0] == '@')
+    {
+        if (!load_int64_input(argv[1] + 1, &query_input, false))
+        {
+            int_writer_close(&writer);
+            free_int64_input(&input);
+            return EXIT_FAILURE;
+        }
+        queries = query_input.nums;
+        query_len = query_input.len;
+    }
+    else
+    {
+        single_query = strtoll(argv[1], NULL, 10);
+    }
+
+    int64_t *results = (int64_t *)malloc(sizeof(int64_t) * (query_len ? query_len : 1));
+    bool answered = false;
+    if (results && ranges)
+    {
+        answered = answer_ranges(nums, num_len, queries, query_len, results);
+    }
+    else if (results && argc > 4)
+    {
+        answered = answer_filtered(nums, num_len, queries, query_len, mode, argv[4], results);
+    }
+    else if (results)
+    {
+        answered = answer_queries(nums, num_len, queries, query_len, mode, results);
+    }
+
+    if (answered)
+    {
+        int_writer_put_int64_array(&writer, results, ranges ? query_len / 2 : query_len, '\n');
+    }
+
+    bool written = int_writer_close(&writer) && answered;
+    free(results);
+    free_int64_input(&query_input);
+    free_int64_input(&input);
+    return written ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,169 @@
+#ifndef D3DAAA79_3120_46E2_B779_CC7E5B05607C
+#define D3DAAA79_3120_46E2_B779_CC7E5B05607C
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../IO/hash_mix.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/*
+
+Most lookups against the sorted array are misses, and a miss pays for the whole chain of
+probes just to learn that the key is absent. A Bloom filter built next to the array rejects
+almost all of them first.
+
+A classic Bloom filter sets k bits anywhere in the array, so a lookup costs k cache misses.
+The split block Bloom filter confines every key to one block of 256 bits (eight 32-bit words,
+half a cache line), and sets exactly one bit in each word:
+
+1. The upper half of a 64-bit hash picks the block, the lower half h is the same for all
+eight words.
+2. Word i gets bit (h * salt[i]) >> 27, with eight fixed odd salts.
+
+A lookup is therefore one cache line access. With AVX2 the eight multiplies, shifts and
+bit tests are one vector operation each, and the test is a single vptest; without AVX2 the
+eight words are checked in a loop.
+
+The false positive rate depends on the bits spent per key:
+
+    bits per key     6      8      10     12     16
+    false positives  ~10%   ~3.3%  ~1.3%  ~0.5%  ~0.13%
+
+Confining the bits to a block costs a little accuracy compared to a classic filter of the
+same size, and buys one cache miss instead of k. Keys can be added, not removed; see
+cuckoo_filter.h for a filter with deletes.
+
+*/
+
+#define BLOOM_BLOCK_WORDS 8
+#define BLOOM_DEFAULT_BITS_PER_KEY 10
+
+typedef struct
+{
+    uint32_t (*blocks)[BLOOM_BLOCK_WORDS];
+    size_t block_count;
+} bloom_filter_t;
+
+static const uint32_t bloom_salts[BLOOM_BLOCK_WORDS] = {
+    0x47B6137BU, 0x44974D91U, 0x8824AD5BU, 0xA2B7289DU,
+    0x705495C7U, 0x2DF1424BU, 0x9EFC4947U, 0x5C6BFB31U};
+
+static inline uint64_t bloom_hash(int64_t key)
+{
+    return fmix64((uint64_t)key);
+}
+
+/*
+
+Sizes the filter for expected keys at bits_per_key bits each (0 picks
+BLOOM_DEFAULT_BITS_PER_KEY). Adding more keys than expected works, at a growing false
+positive rate.
+
+*/
+
+bool bloom_filter_init(bloom_filter_t *filter, size_t expected, size_t bits_per_key)
+{
+    if (!filter)
+    {
+        return false;
+    }
+
+    if (!bits_per_key)
+    {
+        bits_per_key = BLOOM_DEFAULT_BITS_PER_KEY;
+    }
+
+    size_t blocks = (expected * bits_per_key + 255) / 256;
+    filter->block_count = blocks ? blocks : 1;
+    filter->blocks = (uint32_t(*)[BLOOM_BLOCK_WORDS])aligned_alloc(64, sizeof(*filter->blocks) * ((filter->block_count + 1) & ~(size_t)1));
+    if (!filter->blocks)
+    {
+        return false;
+    }
+
+    memset(filter->blocks, 0, sizeof(*filter->blocks) * filter->block_count);
+    return true;
+}
+
+void bloom_filter_free(bloom_filter_t *filter)
+{
+    if (!filter)
+    {
+        return;
+    }
+
+    free(filter->blocks);
+    filter->blocks = NULL;
+    filter->block_count = 0;
+}
+
+static inline uint32_t *bloom_block(const bloom_filter_t *filter, uint64_t hash)
+{
+    return filter->blocks[((hash >> 32) * filter->block_count) >> 32];
+}
+
+#ifdef __AVX2__
+static inline __m256i bloom_mask(uint32_t hash)
+{
+    __m256i salts = _mm256_loadu_si256((const __m256i *)bloom_salts);
+    __m256i shifts = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32((int)hash), salts), 27);
+    return _mm256_sllv_epi32(_mm256_set1_epi32(1), shifts);
+}
+#endif
+
+void bloom_filter_add(bloom_filter_t *filter, int64_t key)
+{
+    uint64_t hash = bloom_hash(key);
+    uint32_t *block = bloom_block(filter, hash);
+
+#ifdef __AVX2__
+    __m256i words = _mm256_load_si256((const __m256i *)block);
+    _mm256_store_si256((__m256i *)block, _mm256_or_si256(words, bloom_mask((uint32_t)hash)));
+#else
+    for (int word = 0; word < BLOOM_BLOCK_WORDS; word++)
+    {
+        block[word] |= (uint32_t)1 << (((uint32_t)hash * bloom_salts[word]) >> 27);
+    }
+#endif
+}
+
+void bloom_filter_add_all(bloom_filter_t *filter, const int64_t *keys, size_t len)
+{
+    for (size_t counter = 0; counter < len; counter++)
+    {
+        bloom_filter_add(filter, keys[counter]);
+    }
+}
+
+// false means key was never added; true means it probably was
+bool bloom_filter_contains(const bloom_filter_t *filter, int64_t key)
+{
+    uint64_t hash = bloom_hash(key);
+    const uint32_t *block = bloom_block(filter, hash);
+
+#ifdef __AVX2__
+    __m256i words = _mm256_load_si256((const __m256i *)block);
+    return _mm256_testc_si256(words, bloom_mask((uint32_t)hash));
+#else
+    bool present = true;
+    for (int word = 0; word < BLOOM_BLOCK_WORDS; word++)
+    {
+        present &= (block[word] >> (((uint32_t)hash * bloom_salts[word]) >> 27)) & 1;
+    }
+    return present;
+#endif
+}
+
+size_t bloom_filter_memory(const bloom_filter_t *filter)
+{
+    return sizeof(*filter->blocks) * filter->block_count;
+}
+
+#endif /* D3DAAA79_3120_46E2_B779_CC7E5B05607C */
@@ -0,0 +1,264 @@
+#ifndef A7C1F20F_CE6D_47AE_966D_F15AE232F34B
+#define A7C1F20F_CE6D_47AE_966D_F15AE232F34B
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../IO/hash_mix.h"
+
+/*
+
+A membership filter that, unlike the Bloom filter, supports deleting keys.
+
+The cuckoo filter stores a 16-bit fingerprint of every key in one of two candidate buckets of
+CUCKOO_BUCKET_SLOTS slots each. The second bucket is derived from the first and the
+fingerprint alone (partial-key cuckoo hashing),
+
+    i1 = hash(key) mod buckets
+    i2 = i1 xor hash(fingerprint) mod buckets
+
+so that a fingerprint can be moved to its other bucket without knowing the key. Inserting
+into two full buckets evicts a random fingerprint and moves it to its alternative bucket,
+repeating up to CUCKOO_MAX_KICKS times. A fingerprint that still has no place is parked in a
+single victim slot; while it is occupied the filter reports itself full.
+
+A bucket is 8 bytes, so the lookup reads at most two cache lines and compares all four
+fingerprints of a bucket with a few word operations (a SWAR test for a zero lane).
+Deleting removes one copy of the key's fingerprint; deleting a key that was never added may
+remove another key's fingerprint, so only delete keys that were inserted.
+
+With 16-bit fingerprints and buckets of four, the false positive rate is at most
+8 / 2^16, about 0.012%. The bucket count is a power of two (the xor above needs it), so a
+filter costs between 17 and 34 bits per key.
+
+*/
+
+#define CUCKOO_BUCKET_SLOTS 4
+#define CUCKOO_MAX_KICKS 500
+#define CUCKOO_LOAD_FACTOR 0.95
+
+typedef struct
+{
+    uint64_t *buckets; // four 16-bit fingerprints each, 0 meaning empty
+    size_t bucket_mask;
+    size_t count;
+    uint64_t random;
+    bool has_victim;
+    uint16_t victim_fingerprint;
+    size_t victim_bucket;
+} cuckoo_filter_t;
+
+static inline uint16_t cuckoo_fingerprint(uint64_t hash)
+{
+    uint16_t fingerprint = (uint16_t)(hash >> 48);
+    return fingerprint ? fingerprint : 1;
+}
+
+static inline size_t cuckoo_alternate(const cuckoo_filter_t *filter, size_t bucket, uint16_t fingerprint)
+{
+    return (bucket ^ (size_t)splitmix64_mix(fingerprint)) & filter->bucket_mask;
+}
+
+// nonzero if one of the four fingerprints in bucket equals fingerprint
+static inline uint64_t cuckoo_bucket_has(uint64_t bucket, uint16_t fingerprint)
+{
+    uint64_t diff = bucket ^ (0x0001000100010001ULL * fingerprint);
+    return (diff - 0x0001000100010001ULL) & ~diff & 0x8000800080008000ULL;
+}
+
+// sizes the filter for expected keys at CUCKOO_LOAD_FACTOR
+bool cuckoo_filter_init(cuckoo_filter_t *filter, size_t expected)
+{
+    if (!filter)
+    {
+        return false;
+    }
+
+    size_t needed = (size_t)((double)expected / (CUCKOO_BUCKET_SLOTS * CUCKOO_LOAD_FACTOR)) + 1;
+    size_t buckets = 1;
+    while (buckets < needed)
+    {
+        buckets <<= 1;
+    }
+
+    filter->buckets = (uint64_t *)calloc(buckets, sizeof(uint64_t));
+    if (!filter->buckets)
+    {
+        return false;
+    }
+
+    filter->bucket_mask = buckets - 1;
+    filter->count = 0;
+    filter->random = 0x2545F4914F6CDD1DULL;
+    filter->has_victim = false;
+    return true;
+}
+
+void cuckoo_filter_free(cuckoo_filter_t *filter)
+{
+    if (!filter)
+    {
+        return;
+    }
+
+    free(filter->buckets);
+    filter->buckets = NULL;
+    filter->count = 0;
+}
+
+// puts fingerprint into a free slot of bucket, if there is one
+static bool cuckoo_bucket_put(cuckoo_filter_t *filter, size_t bucket, uint16_t fingerprint)
+{
+    uint64_t slots = filter->buckets[bucket];
+    for (int slot = 0; slot < CUCKOO_BUCKET_SLOTS; slot++)
+    {
+        if (!((slots >> (16 * slot)) & 0xFFFF))
+        {
+            filter->buckets[bucket] = slots | ((uint64_t)fingerprint << (16 * slot));
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// removes one copy of fingerprint from bucket, if there is one
+static bool cuckoo_bucket_remove(cuckoo_filter_t *filter, size_t bucket, uint16_t fingerprint)
+{
+    uint64_t slots = filter->buckets[bucket];
+    for (int slot = 0; slot < CUCKOO_BUCKET_SLOTS; slot++)
+    {
+        if (((slots >> (16 * slot)) & 0xFFFF) == fingerprint)
+        {
+            filter->buckets[bucket] = slots & ~((uint64_t)0xFFFF << (16 * slot));
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// false if the filter is full; the key is then not added
+bool cuckoo_filter_add(cuckoo_filter_t *filter, int64_t key)
+{
+    if (filter->has_victim)
+    {
+        return false;
+    }
+
+    uint64_t hash = splitmix64_mix((uint64_t)key);
+    uint16_t fingerprint = cuckoo_fingerprint(hash);
+    size_t bucket = (size_t)hash & filter->bucket_mask;
+
+    if (cuckoo_bucket_put(filter, bucket, fingerprint) ||
+        cuckoo_bucket_put(filter, cuckoo_alternate(filter, bucket, fingerprint), fingerprint))
+    {
+        filter->count++;
+        return true;
+    }
+
+    // both buckets are full: evict fingerprints along a random walk
+    filter->count++;
+    bucket = (filter->random & 1) ? cuckoo_alternate(filter, bucket, fingerprint) : bucket;
+    for (int kick = 0; kick < CUCKOO_MAX_KICKS; kick++)
+    {
+        filter->random ^= filter->random << 13;
+        filter->random ^= filter->random >> 7;
+        filter->random ^= filter->random << 17;
+
+        int slot = (int)(filter->random % CUCKOO_BUCKET_SLOTS);
+        uint64_t slots = filter->buckets[bucket];
+        uint16_t evicted = (uint16_t)(slots >> (16 * slot));
+        filter->buckets[bucket] = (slots & ~((uint64_t)0xFFFF << (16 * slot))) | ((uint64_t)fingerprint << (16 * slot));
+
+        fingerprint = evicted;
+        bucket = cuckoo_alternate(filter, bucket, fingerprint);
+        if (cuckoo_bucket_put(filter, bucket, fingerprint))
+        {
+            return true;
+        }
+    }
+
+    // the key itself is in; the fingerprint evicted last waits in the victim slot
+    filter->has_victim = true;
+    filter->victim_fingerprint = fingerprint;
+    filter->victim_bucket = bucket;
+    return true;
+}
+
+bool cuckoo_filter_add_all(cuckoo_filter_t *filter, const int64_t *keys, size_t len)
+{
+    for (size_t counter = 0; counter < len; counter++)
+    {
+        if (!cuckoo_filter_add(filter, keys[counter]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// false means key is not in the filter; true means it probably is
+bool cuckoo_filter_contains(const cuckoo_filter_t *filter, int64_t key)
+{
+    uint64_t hash = splitmix64_mix((uint64_t)key);
+    uint16_t fingerprint = cuckoo_fingerprint(hash);
+    size_t first = (size_t)hash & filter->bucket_mask;
+    size_t second = cuckoo_alternate(filter, first, fingerprint);
+
+    if (cuckoo_bucket_has(filter->buckets[first], fingerprint) ||
+        cuckoo_bucket_has(filter->buckets[second], fingerprint))
+    {
+        return true;
+    }
+
+    return filter->has_victim && filter->victim_fingerprint == fingerprint &&
+           (filter->victim_bucket == first || filter->victim_bucket == second);
+}
+
+// removes a key that was added before; false if its fingerprint is not found
+bool cuckoo_filter_remove(cuckoo_filter_t *filter, int64_t key)
+{
+    uint64_t hash = splitmix64_mix((uint64_t)key);
+    uint16_t fingerprint = cuckoo_fingerprint(hash);
+    size_t first = (size_t)hash & filter->bucket_mask;
+    size_t second = cuckoo_alternate(filter, first, fingerprint);
+
+    if (filter->has_victim && filter->victim_fingerprint == fingerprint &&
+        (filter->victim_bucket == first || filter->victim_bucket == second))
+    {
+        filter->has_victim = false;
+        filter->count--;
+        return true;
+    }
+
+    if (!cuckoo_bucket_remove(filter, first, fingerprint) && !cuckoo_bucket_remove(filter, second, fingerprint))
+    {
+        return false;
+    }
+    filter->count--;
+
+    // a slot was freed, so the victim may fit again
+    if (filter->has_victim)
+    {
+        size_t victim_bucket = filter->victim_bucket;
+        if (cuckoo_bucket_put(filter, victim_bucket, filter->victim_fingerprint) ||
+            cuckoo_bucket_put(filter, cuckoo_alternate(filter, victim_bucket, filter->victim_fingerprint), filter->victim_fingerprint))
+        {
+            filter->has_victim = false;
+        }
+    }
+
+    return true;
+}
+
+size_t cuckoo_filter_memory(const cuckoo_filter_t *filter)
+{
+    return sizeof(uint64_t) * (filter->bucket_mask + 1);
+}
+
+#endif /* A7C1F20F_CE6D_47AE_966D_F15AE232F34B */
@@ -0,0 +1,133 @@
+#ifndef D5A7B7B5_251A_4593_AB90_F9DE9EA8D238
+#define D5A7B7B5_251A_4593_AB90_F9DE9EA8D238
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+
+Binary search over a sorted array touches positions n/2, n/4 or 3n/4, ... which are far apart,
+so every probe after the first few is a cache miss, and the processor cannot start the next
+load before the comparison has been resolved.
+
+The Eytzinger layout stores the same keys in the order of a breadth-first walk over the
+implicit search tree (1-indexed, like a binary heap): the root is at 1, and the children
+of node k are at 2k and 2k + 1. This has two consequences:
+
+1. The descent is k = 2k + (tree[k] < x), which compiles to a compare and an add,
+without a branch to mispredict.
+2. The 8 descendants of node k three levels down occupy tree[8k, 8k + 8), which is
+exactly one cache line when tree[0] is cache-line aligned. Prefetching that line while the
+current level is compared keeps several misses in flight, and the memory latency is hidden
+behind the next three iterations.
+
+After the loop, k has walked past the answer: the lower bound is the node where the path
+turned left for the last time, which is found by stripping the trailing ones (plus one
+zero) from k. Each tree slot also remembers its index in the sorted array, so the result
+is reported as a position in the original array.
+
+*/
+
+#define EYTZINGER_PREFETCH_STRIDE 8 // three levels ahead: 8 keys, one cache line
+
+typedef struct
+{
+    int64_t *tree;      // tree[1, len]; tree[0] is unused
+    int64_t *positions; // positions[k] is the index of tree[k] in the sorted array
+    size_t len;
+} eytzinger_t;
+
+static size_t eytzinger_fill(eytzinger_t *index, const int64_t *sorted, size_t next, size_t k)
+{
+    if (k <= index->len)
+    {
+        next = eytzinger_fill(index, sorted, next, 2 * k);
+        index->tree[k] = sorted[next];
+        index->positions[k] = (int64_t)next;
+        next++;
+        next = eytzinger_fill(index, sorted, next, 2 * k + 1);
+    }
+
+    return next;
+}
+
+bool eytzinger_build(eytzinger_t *index, const int64_t *sorted, size_t len)
+{
+    if (!index || (!sorted && len))
+    {
+        return false;
+    }
+
+    size_t bytes = sizeof(int64_t) * (len + 1);
+    bytes = (bytes + 63) & ~(size_t)63;
+
+    index->tree = (int64_t *)aligned_alloc(64, bytes);
+    index->positions = (int64_t *)malloc(sizeof(int64_t) * (len + 1));
+    if (!index->tree || !index->positions)
+    {
+        free(index->tree);
+        free(index->positions);
+        return false;
+    }
+
+    index->len = len;
+    index->tree[0] = 0;
+    index->positions[0] = (int64_t)len; // slot 0 means "past the end"
+    eytzinger_fill(index, sorted, 0, 1);
+    return true;
+}
+
+void eytzinger_free(eytzinger_t *index)
+{
+    if (!index)
+    {
+        return;
+    }
+
+    free(index->tree);
+    free(index->positions);
+    index->tree = NULL;
+    index->positions = NULL;
+    index->len = 0;
+}
+
+// slot of the first key not less than x, or 0 if every key is less than x
+static inline size_t eytzinger_lower_bound_slot(const eytzinger_t *index, int64_t x)
+{
+    const int64_t *tree = index->tree;
+    size_t len = index->len;
+    size_t k = 1;
+
+    while (k <= len)
+    {
+        __builtin_prefetch(tree + k * EYTZINGER_PREFETCH_STRIDE);
+        k = 2 * k + (tree[k] < x);
+    }
+
+    // the answer is where the path last went left: drop the trailing ones and that zero
+    k >>= __builtin_ffsll((long long)~k);
+    return k;
+}
+
+// position of the first key not less than x in the sorted array, or len
+int64_t eytzinger_lower_bound(const eytzinger_t *index, int64_t x)
+{
+    return index->positions[eytzinger_lower_bound_slot(index, x)];
+}
+
+// position of a key equal to x (the first one, if there are several), or -1
+int64_t eytzinger_search(const eytzinger_t *index, int64_t x)
+{
+    size_t k = eytzinger_lower_bound_slot(index, x);
+    if (!k || index->tree[k] != x)
+    {
+        return -1;
+    }
+
+    return index->positions[k];
+}
+
+#endif /* D5A7B7B5_251A_4593_AB90_F9DE9EA8D238 */
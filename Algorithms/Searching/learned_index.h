@@ -0,0 +1,248 @@
+#ifndef C9E1AF74_A204_42E1_94FC_98A94E8CF0D7
+#define C9E1AF74_A204_42E1_94FC_98A94E8CF0D7
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "./search_kernel.h"
+
+/*
+
+Binary search assumes nothing about the keys. But random_gen.py draws them uniformly, and
+timestamps or sequential ids are close to uniform as well: for such keys the position of x
+is almost a linear function of x, and one multiplication predicts it.
+
+The learned index (in the style of the PGM index) approximates the map key -> position by a
+piecewise linear function whose error is guaranteed to be at most epsilon:
+
+1. The sorted array is cut into segments greedily with the shrinking cone method. A segment
+starts at its first key with the exact position; every further key narrows the interval
+of slopes that keep all keys of the segment within epsilon of their true position. When
+the interval becomes empty, the key starts the next segment. Only the first occurrence of
+every key is modelled, so a lookup of a present key lands on its lower bound.
+2. A lookup finds its segment by a search over the (few, cache resident) segment start keys,
+predicts a position, and finishes with the branchless kernel on the window of 2 epsilon + 3
+slots around it; with epsilon = 32 that is a handful of cache lines, the same for every n.
+3. The window is verified against its neighbours. Keys that are not in the array can fall
+just outside the window (for instance behind a long run of duplicates); those are rare and
+answered by a full search.
+
+On uniform keys a few segments cover the whole array. On skewed keys the number of segments
+grows towards n / epsilon; once the model is no longer at least LEARNED_INDEX_MIN_COMPRESSION
+times smaller than the data, the index is discarded and plain binary search is used instead.
+
+*/
+
+#define LEARNED_INDEX_DEFAULT_EPSILON 32
+#define LEARNED_INDEX_MIN_COMPRESSION 16
+
+typedef struct
+{
+    int64_t key;
+    double slope;
+    size_t position;
+} learned_segment_t;
+
+typedef struct
+{
+    const int64_t *nums;
+    size_t len;
+    size_t epsilon;
+    learned_segment_t *segments;
+    int64_t *segment_keys;
+    size_t segment_count;
+    bool fallback;
+} learned_index_t;
+
+static inline double key_distance(int64_t from, int64_t to)
+{
+    return (double)((uint64_t)to - (uint64_t)from);
+}
+
+static bool learned_index_push(learned_segment_t **segments, size_t *count, size_t *capacity, int64_t key, size_t position, double slope)
+{
+    if (*count == *capacity)
+    {
+        size_t grown = *capacity ? *capacity * 2 : 64;
+        learned_segment_t *resized = (learned_segment_t *)realloc(*segments, sizeof(learned_segment_t) * grown);
+        if (!resized)
+        {
+            return false;
+        }
+        *segments = resized;
+        *capacity = grown;
+    }
+
+    (*segments)[*count].key = key;
+    (*segments)[*count].position = position;
+    (*segments)[*count].slope = slope;
+    (*count)++;
+    return true;
+}
+
+/*
+
+Builds the model over sorted, which must stay alive and unchanged while the index is used.
+epsilon = 0 picks LEARNED_INDEX_DEFAULT_EPSILON.
+
+*/
+
+bool learned_index_build(learned_index_t *index, const int64_t *sorted, size_t len, size_t epsilon)
+{
+    if (!index || (!sorted && len))
+    {
+        return false;
+    }
+
+    index->nums = sorted;
+    index->len = len;
+    index->epsilon = epsilon ? epsilon : LEARNED_INDEX_DEFAULT_EPSILON;
+    index->segments = NULL;
+    index->segment_keys = NULL;
+    index->segment_count = 0;
+    index->fallback = false;
+
+    if (!len)
+    {
+        return true;
+    }
+
+    learned_segment_t *segments = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    double eps = (double)index->epsilon;
+
+    int64_t start_key = sorted[0];
+    size_t start_position = 0;
+    double slope_low = 0.0;
+    double slope_high = INFINITY;
+
+    for (size_t position = 1; position < len; position++)
+    {
+        if (sorted[position] == sorted[position - 1])
+        {
+            continue;
+        }
+
+        double dx = key_distance(start_key, sorted[position]);
+        double dy = (double)position - (double)start_position;
+        double low = (dy - eps) / dx;
+        double high = (dy + eps) / dx;
+
+        if (low > slope_high || high < slope_low)
+        {
+            double slope = slope_high == INFINITY ? slope_low : (slope_low + slope_high) / 2;
+            if (!learned_index_push(&segments, &count, &capacity, start_key, start_position, slope))
+            {
+                free(segments);
+                return false;
+            }
+
+            // too many segments: the data is too skewed for the model to pay off
+            if (count * LEARNED_INDEX_MIN_COMPRESSION > len)
+            {
+                free(segments);
+                index->fallback = true;
+                return true;
+            }
+
+            start_key = sorted[position];
+            start_position = position;
+            slope_low = 0.0;
+            slope_high = INFINITY;
+            continue;
+        }
+
+        slope_low = low > slope_low ? low : slope_low;
+        slope_high = high < slope_high ? high : slope_high;
+    }
+
+    double slope = slope_high == INFINITY ? slope_low : (slope_low + slope_high) / 2;
+    if (!learned_index_push(&segments, &count, &capacity, start_key, start_position, slope))
+    {
+        free(segments);
+        return false;
+    }
+
+    index->segment_keys = (int64_t *)malloc(sizeof(int64_t) * count);
+    if (!index->segment_keys)
+    {
+        free(segments);
+        return false;
+    }
+    for (size_t counter = 0; counter < count; counter++)
+    {
+        index->segment_keys[counter] = segments[counter].key;
+    }
+
+    index->segments = segments;
+    index->segment_count = count;
+    return true;
+}
+
+void learned_index_free(learned_index_t *index)
+{
+    if (!index)
+    {
+        return;
+    }
+
+    free(index->segments);
+    free(index->segment_keys);
+    index->segments = NULL;
+    index->segment_keys = NULL;
+    index->segment_count = 0;
+}
+
+// index of the first key not less than x, or len
+int64_t learned_index_lower_bound(const learned_index_t *index, int64_t x)
+{
+    const int64_t *nums = index->nums;
+    size_t len = index->len;
+
+    if (index->fallback || !len)
+    {
+        return (int64_t)branchless_lower_bound(nums, len, x);
+    }
+    if (x <= nums[0])
+    {
+        return 0;
+    }
+
+    // the last segment starting at or before x; there is one, since x > nums[0]
+    const learned_segment_t *segment = index->segments +
+                                       branchless_upper_bound(index->segment_keys, index->segment_count, x) - 1;
+
+    double predicted = (double)segment->position + segment->slope * key_distance(segment->key, x);
+    size_t guess = predicted <= 0.0 ? 0 : predicted >= (double)len ? len : (size_t)(predicted + 0.5);
+
+    // one extra slot on each side absorbs the rounding of the prediction
+    size_t reach = index->epsilon + 1;
+    size_t low = guess > reach ? guess - reach : 0;
+    size_t high = len - guess > reach + 1 ? guess + reach + 1 : len;
+
+    size_t position = low + branchless_lower_bound(nums + low, high - low, x);
+    if ((position == low && low > 0 && nums[low - 1] >= x) || (position == high && high < len && nums[high] < x))
+    {
+        return (int64_t)branchless_lower_bound(nums, len, x);
+    }
+
+    return (int64_t)position;
+}
+
+// position of a key equal to x (the first one, if there are several), or -1
+int64_t learned_index_search(const learned_index_t *index, int64_t x)
+{
+    int64_t position = learned_index_lower_bound(index, x);
+    if ((size_t)position == index->len || index->nums[position] != x)
+    {
+        return -1;
+    }
+
+    return position;
+}
+
+#endif /* C9E1AF74_A204_42E1_94FC_98A94E8CF0D7 */
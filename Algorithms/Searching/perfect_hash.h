@@ -0,0 +1,611 @@
+#ifndef E989C8CF_DE42_4A24_9FCB_C202F7AD7664
+#define E989C8CF_DE42_4A24_9FCB_C202F7AD7664
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../IO/hash_mix.h"
+#include "../IO/i64_format.h"
+#include "../IO/parallel_parser.h"
+#include "../Sorting/sort_template.h"
+
+/*
+
+For exact-match lookups against a fixed set of keys, sorting and O(log n) probes are more
+than needed. A minimal perfect hash function (MPHF) maps each of the n keys to its own slot
+in [0, n), without collisions and without storing the keys in the function itself. The
+construction follows BBHash:
+
+1. Level 0 is a bit array of gamma * n bits. Every key hashes to one bit; bits hit by exactly
+one key are kept, bits hit by two or more are cleared and their keys move on.
+2. The keys that collided repeat the process on a level of gamma * (remaining) bits, with a
+different hash, until none are left or PERFECT_HASH_MAX_LEVELS is reached. The (few) keys
+still left after that are stored, sorted, behind the hashed slots and found by a search.
+3. The slot of a key is the number of set bits before its bit, over all levels laid end to end.
+A rank sample (the count of set bits before every block of 512 bits) makes that one sample
+plus at most eight popcounts.
+
+With gamma = 1 the levels take about 3 bits per key, and the rank samples an eighth of that
+again. Since an MPHF maps any key to some slot, the keys are also stored in slot order, each next
+to its value (for binary_search, the position in the sorted array); a lookup verifies the
+single slot its key maps to, and the value comes with the same cache line.
+
+Building is parallel: the threads set the bits of one level with atomic ORs (a bit that was
+already set goes to the collision array), then each thread collects the keys of its range
+that collided, count-then-fill, like the parallel parser.
+
+The index is a single block of memory laid out exactly like the file it is saved to:
+
+    offset  size          field
+         0  256           perfect_hash_header_t
+       256  8 words       level bits, all levels back to back
+            8 (words/8+1) rank samples
+           16 count       key and value of every slot
+
+so saving it is a single write, and a service can map the file and use it right away.
+Like .i64 files, the format is little-endian and mapping requires a little-endian host. The
+header keeps the key count and a checksum of the keys and values, so a saved index is only
+mapped for the data it was built from.
+
+*/
+
+#define PERFECT_HASH_MAGIC "MPHF64\0\1"
+#define PERFECT_HASH_VERSION 2
+#define PERFECT_HASH_MAX_LEVELS 24
+#define PERFECT_HASH_DEFAULT_GAMMA 1.0
+#define PERFECT_HASH_RANK_WORDS 8 // one rank sample per 512 bits
+#define PERFECT_HASH_MIN_KEYS_PER_THREAD (1 << 16)
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t levels;
+    uint64_t count;                                // keys, and slots
+    uint64_t placed;                               // keys placed by the levels; the rest are searched
+    uint64_t words;                                // 64-bit words of level bits
+    double gamma;
+    uint64_t level_bits[PERFECT_HASH_MAX_LEVELS];  // size of every level, a multiple of 64
+    uint64_t checksum;                             // of the keys and values, perfect_hash_checksum
+    uint8_t padding[8];
+} perfect_hash_header_t;
+
+_Static_assert(sizeof(perfect_hash_header_t) == 256, "the index header must be four cache lines");
+
+typedef struct
+{
+    int64_t key;
+    int64_t value;
+} perfect_hash_entry_t;
+
+typedef struct
+{
+    const perfect_hash_header_t *header;
+    const uint64_t *bits;
+    const uint64_t *ranks;
+    const perfect_hash_entry_t *entries;
+    uint64_t level_offsets[PERFECT_HASH_MAX_LEVELS];
+    void *memory;
+    size_t memory_len;
+    bool mapped;
+} perfect_hash_t;
+
+static inline uint64_t perfect_hash_mix(int64_t key, uint32_t level)
+{
+    return splitmix64_mix((uint64_t)key + SPLITMIX64_GAMMA * (level + 1));
+}
+
+// an order-independent checksum of len keys and their values (or i for keys[i], if values is NULL)
+uint64_t perfect_hash_checksum(const int64_t *keys, const int64_t *values, size_t len)
+{
+    uint64_t checksum = len;
+    for (size_t counter = 0; counter < len; counter++)
+    {
+        int64_t value = values ? values[counter] : (int64_t)counter;
+        checksum += perfect_hash_mix(keys[counter] ^ (int64_t)perfect_hash_mix(value, 0), PERFECT_HASH_MAX_LEVELS);
+    }
+    return checksum;
+}
+
+// bit of key in a level of bits bits; a multiply instead of a modulo
+static inline uint64_t perfect_hash_bit(int64_t key, uint32_t level, uint64_t bits)
+{
+    return (uint64_t)(((unsigned __int128)perfect_hash_mix(key, level) * bits) >> 64);
+}
+
+static inline size_t perfect_hash_rank_count(uint64_t words)
+{
+    return (size_t)(words / PERFECT_HASH_RANK_WORDS + 1);
+}
+
+static size_t perfect_hash_memory_len(uint64_t words, uint64_t count)
+{
+    return sizeof(perfect_hash_header_t) +
+           sizeof(uint64_t) * ((size_t)words + perfect_hash_rank_count(words)) +
+           sizeof(perfect_hash_entry_t) * (size_t)count;
+}
+
+// points the index into a block laid out as described above
+static void perfect_hash_attach(perfect_hash_t *index, void *memory, size_t memory_len, bool mapped)
+{
+    const perfect_hash_header_t *header = (const perfect_hash_header_t *)memory;
+
+    index->header = header;
+    index->bits = (const uint64_t *)((const char *)memory + sizeof(perfect_hash_header_t));
+    index->ranks = index->bits + header->words;
+    index->entries = (const perfect_hash_entry_t *)(index->ranks + perfect_hash_rank_count(header->words));
+    index->memory = memory;
+    index->memory_len = memory_len;
+    index->mapped = mapped;
+
+    uint64_t offset = 0;
+    for (uint32_t level = 0; level < header->levels; level++)
+    {
+        index->level_offsets[level] = offset;
+        offset += header->level_bits[level];
+    }
+}
+
+// slot of key; keys that are not in the set get an arbitrary slot, or -1
+int64_t perfect_hash_slot(const perfect_hash_t *index, int64_t key)
+{
+    const perfect_hash_header_t *header = index->header;
+    const uint64_t *bits = index->bits;
+
+    for (uint32_t level = 0; level < header->levels; level++)
+    {
+        uint64_t bit = index->level_offsets[level] + perfect_hash_bit(key, level, header->level_bits[level]);
+        uint64_t word = bit / 64;
+        if (bits[word] & ((uint64_t)1 << (bit % 64)))
+        {
+            uint64_t rank = index->ranks[word / PERFECT_HASH_RANK_WORDS];
+            for (uint64_t before = word - word % PERFECT_HASH_RANK_WORDS; before < word; before++)
+            {
+                rank += (uint64_t)__builtin_popcountll(bits[before]);
+            }
+            rank += (uint64_t)__builtin_popcountll(bits[word] & (((uint64_t)1 << (bit % 64)) - 1));
+            return (int64_t)rank;
+        }
+    }
+
+    // the keys no level could place sit sorted in the last slots
+    size_t low = (size_t)header->placed;
+    size_t high = (size_t)header->count;
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (index->entries[mid].key < key)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return low < header->count ? (int64_t)low : -1;
+}
+
+// value stored with key, or -1 if key is not in the set
+int64_t perfect_hash_find(const perfect_hash_t *index, int64_t key)
+{
+    int64_t slot = perfect_hash_slot(index, key);
+    if (slot < 0 || index->entries[slot].key != key)
+    {
+        return -1;
+    }
+
+    return index->entries[slot].value;
+}
+
+typedef struct
+{
+    const int64_t *keys;
+    size_t begin;
+    size_t end;
+    uint64_t *level;
+    uint64_t *collide;
+    uint64_t level_bits;
+    uint32_t level_index;
+    size_t survivors;
+    int64_t *out;
+    const perfect_hash_t *index;
+    const int64_t *values;
+    perfect_hash_entry_t *entries;
+} perfect_hash_task_t;
+
+static void *perfect_hash_mark_worker(void *arg)
+{
+    perfect_hash_task_t *task = (perfect_hash_task_t *)arg;
+    for (size_t counter = task->begin; counter < task->end; counter++)
+    {
+        uint64_t bit = perfect_hash_bit(task->keys[counter], task->level_index, task->level_bits);
+        uint64_t mask = (uint64_t)1 << (bit % 64);
+        if (__atomic_fetch_or(task->level + bit / 64, mask, __ATOMIC_RELAXED) & mask)
+        {
+            __atomic_fetch_or(task->collide + bit / 64, mask, __ATOMIC_RELAXED);
+        }
+    }
+    return NULL;
+}
+
+static inline bool perfect_hash_collided(const perfect_hash_task_t *task, int64_t key)
+{
+    uint64_t bit = perfect_hash_bit(key, task->level_index, task->level_bits);
+    return (task->collide[bit / 64] >> (bit % 64)) & 1;
+}
+
+static void *perfect_hash_count_worker(void *arg)
+{
+    perfect_hash_task_t *task = (perfect_hash_task_t *)arg;
+    size_t survivors = 0;
+    for (size_t counter = task->begin; counter < task->end; counter++)
+    {
+        survivors += perfect_hash_collided(task, task->keys[counter]);
+    }
+    task->survivors = survivors;
+    return NULL;
+}
+
+static void *perfect_hash_move_worker(void *arg)
+{
+    perfect_hash_task_t *task = (perfect_hash_task_t *)arg;
+    int64_t *out = task->out;
+    for (size_t counter = task->begin; counter < task->end; counter++)
+    {
+        if (perfect_hash_collided(task, task->keys[counter]))
+        {
+            *out++ = task->keys[counter];
+        }
+    }
+    return NULL;
+}
+
+static void *perfect_hash_place_worker(void *arg)
+{
+    perfect_hash_task_t *task = (perfect_hash_task_t *)arg;
+    for (size_t counter = task->begin; counter < task->end; counter++)
+    {
+        int64_t slot = perfect_hash_slot(task->index, task->keys[counter]);
+        task->entries[slot].key = task->keys[counter];
+        task->entries[slot].value = task->values ? task->values[counter] : (int64_t)counter;
+    }
+    return NULL;
+}
+
+// cuts [0, len) into one range per task
+static size_t perfect_hash_split(perfect_hash_task_t *tasks, size_t threads, const int64_t *keys, size_t len)
+{
+    if (threads > len / PERFECT_HASH_MIN_KEYS_PER_THREAD)
+    {
+        threads = len / PERFECT_HASH_MIN_KEYS_PER_THREAD;
+    }
+    if (!threads)
+    {
+        threads = 1;
+    }
+
+    for (size_t counter = 0; counter < threads; counter++)
+    {
+        tasks[counter].keys = keys;
+        tasks[counter].begin = len / threads * counter;
+        tasks[counter].end = counter + 1 == threads ? len : len / threads * (counter + 1);
+    }
+
+    return threads;
+}
+
+#define PERFECT_HASH_KEY_LESS(a, b) ((a) < (b))
+DEFINE_SORT(perfect_hash_sort_keys, int64_t, PERFECT_HASH_KEY_LESS)
+
+/*
+
+Builds the index over len distinct keys, with values[i] stored for keys[i] (or i, if values
+is NULL). gamma = 0 picks PERFECT_HASH_DEFAULT_GAMMA; larger values trade space for fewer
+levels, hence faster lookups and builds. threads = 0 uses one thread per online core.
+Returns false when out of memory or when the keys are not distinct.
+
+*/
+
+bool perfect_hash_build(perfect_hash_t *index, const int64_t *keys, const int64_t *values, size_t len, double gamma, size_t threads)
+{
+    if (!index || (!keys && len) || !host_is_little_endian())
+    {
+        return false;
+    }
+
+    if (gamma < 1.0)
+    {
+        gamma = PERFECT_HASH_DEFAULT_GAMMA;
+    }
+    if (!threads)
+    {
+        threads = default_parse_threads();
+    }
+    if (threads > PARALLEL_PARSE_MAX_THREADS)
+    {
+        threads = PARALLEL_PARSE_MAX_THREADS;
+    }
+
+    perfect_hash_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PERFECT_HASH_MAGIC, sizeof(header.magic));
+    header.version = PERFECT_HASH_VERSION;
+    header.count = len;
+    header.gamma = gamma;
+    header.checksum = perfect_hash_checksum(keys, values, len);
+
+    // the keys still to place, and the space for the ones that collide again
+    int64_t *remaining = (int64_t *)malloc(sizeof(int64_t) * (len ? len : 1));
+    int64_t *next = (int64_t *)malloc(sizeof(int64_t) * (len ? len : 1));
+    uint64_t *levels = NULL;
+    if (!remaining || !next)
+    {
+        free(remaining);
+        free(next);
+        return false;
+    }
+    memcpy(remaining, keys, sizeof(int64_t) * len);
+
+    perfect_hash_task_t tasks[PARALLEL_PARSE_MAX_THREADS];
+    memset(tasks, 0, sizeof(tasks));
+
+    size_t left = len;
+    while (left && header.levels < PERFECT_HASH_MAX_LEVELS)
+    {
+        uint64_t words = (uint64_t)((double)left * gamma / 64) + 1;
+        uint64_t *grown = (uint64_t *)realloc(levels, sizeof(uint64_t) * (header.words + words));
+        uint64_t *collide = (uint64_t *)calloc(words, sizeof(uint64_t));
+        if (grown)
+        {
+            levels = grown;
+        }
+        if (!grown || !collide)
+        {
+            free(collide);
+            free(levels);
+            free(remaining);
+            free(next);
+            return false;
+        }
+
+        uint64_t *level = levels + header.words;
+        memset(level, 0, sizeof(uint64_t) * words);
+
+        size_t used = perfect_hash_split(tasks, threads, remaining, left);
+        for (size_t counter = 0; counter < used; counter++)
+        {
+            tasks[counter].level = level;
+            tasks[counter].collide = collide;
+            tasks[counter].level_bits = words * 64;
+            tasks[counter].level_index = header.levels;
+        }
+
+        run_workers(tasks, sizeof(perfect_hash_task_t), used, perfect_hash_mark_worker);
+        for (uint64_t word = 0; word < words; word++)
+        {
+            level[word] &= ~collide[word];
+        }
+
+        run_workers(tasks, sizeof(perfect_hash_task_t), used, perfect_hash_count_worker);
+        size_t survivors = 0;
+        for (size_t counter = 0; counter < used; counter++)
+        {
+            tasks[counter].out = next + survivors;
+            survivors += tasks[counter].survivors;
+        }
+        run_workers(tasks, sizeof(perfect_hash_task_t), used, perfect_hash_move_worker);
+        free(collide);
+
+        int64_t *swap = remaining;
+        remaining = next;
+        next = swap;
+        left = survivors;
+
+        header.level_bits[header.levels++] = words * 64;
+        header.words += words;
+    }
+    free(next);
+
+    // whatever the levels could not place is kept sorted; duplicates would end up here
+    perfect_hash_sort_keys(remaining, left);
+    for (size_t counter = 1; counter < left; counter++)
+    {
+        if (remaining[counter] == remaining[counter - 1])
+        {
+            free(levels);
+            free(remaining);
+            return false;
+        }
+    }
+    header.placed = len - left;
+
+    size_t memory_len = perfect_hash_memory_len(header.words, header.count);
+    void *memory = aligned_alloc(64, (memory_len + 63) & ~(size_t)63);
+    if (!memory)
+    {
+        free(levels);
+        free(remaining);
+        return false;
+    }
+
+    memcpy(memory, &header, sizeof(header));
+    perfect_hash_attach(index, memory, memory_len, false);
+
+    uint64_t *bits = (uint64_t *)index->bits;
+    uint64_t *ranks = (uint64_t *)index->ranks;
+    perfect_hash_entry_t *entries = (perfect_hash_entry_t *)index->entries;
+
+    if (header.words)
+    {
+        memcpy(bits, levels, sizeof(uint64_t) * header.words);
+    }
+    free(levels);
+
+    uint64_t ones = 0;
+    for (uint64_t word = 0; word < header.words; word++)
+    {
+        if (word % PERFECT_HASH_RANK_WORDS == 0)
+        {
+            ranks[word / PERFECT_HASH_RANK_WORDS] = ones;
+        }
+        ones += (uint64_t)__builtin_popcountll(bits[word]);
+    }
+    if (header.words % PERFECT_HASH_RANK_WORDS == 0)
+    {
+        ranks[header.words / PERFECT_HASH_RANK_WORDS] = ones;
+    }
+
+    // the unplaced keys go to the last slots first, so that their lookups can find them
+    for (size_t counter = 0; counter < left; counter++)
+    {
+        entries[header.placed + counter].key = remaining[counter];
+    }
+    free(remaining);
+
+    size_t used = perfect_hash_split(tasks, threads, keys, len);
+    for (size_t counter = 0; counter < used; counter++)
+    {
+        tasks[counter].index = index;
+        tasks[counter].values = values;
+        tasks[counter].entries = entries;
+    }
+    run_workers(tasks, sizeof(perfect_hash_task_t), used, perfect_hash_place_worker);
+
+    return true;
+}
+
+void perfect_hash_free(perfect_hash_t *index)
+{
+    if (!index || !index->memory)
+    {
+        return;
+    }
+
+    if (index->mapped)
+    {
+        munmap(index->memory, index->memory_len);
+    }
+    else
+    {
+        free(index->memory);
+    }
+    index->memory = NULL;
+    index->header = NULL;
+}
+
+// bits per key spent on the function itself (levels and rank samples), without the entries
+double perfect_hash_bits_per_key(const perfect_hash_t *index)
+{
+    const perfect_hash_header_t *header = index->header;
+    if (!header->count)
+    {
+        return 0.0;
+    }
+
+    return 64.0 * (double)(header->words + perfect_hash_rank_count(header->words)) / (double)header->count;
+}
+
+bool perfect_hash_save(const perfect_hash_t *index, const char *path)
+{
+    if (!index || !index->memory || !path)
+    {
+        return false;
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (!file)
+    {
+        return false;
+    }
+
+    bool written = fwrite(index->memory, 1, index->memory_len, file) == index->memory_len;
+
+    return (fclose(file) == 0) && written;
+}
+
+/*
+
+Maps a saved index read-only; it is used straight from the page cache. The index must have
+been built over count keys whose perfect_hash_checksum is checksum; an index of other data
+is not mapped, and *stale (if not NULL) tells that case apart from a missing or damaged file.
+
+*/
+
+bool perfect_hash_map(perfect_hash_t *index, const char *path, uint64_t count, uint64_t checksum, bool *stale)
+{
+    if (stale)
+    {
+        *stale = false;
+    }
+
+    if (!index || !path || !host_is_little_endian())
+    {
+        return false;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) < 0 || (size_t)info.st_size < sizeof(perfect_hash_header_t))
+    {
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return false;
+    }
+
+    const perfect_hash_header_t *header = (const perfect_hash_header_t *)map;
+    bool valid = !memcmp(header->magic, PERFECT_HASH_MAGIC, sizeof(header->magic)) &&
+                 header->version == PERFECT_HASH_VERSION &&
+                 header->levels <= PERFECT_HASH_MAX_LEVELS &&
+                 header->placed <= header->count &&
+                 header->count <= (uint64_t)info.st_size / sizeof(int64_t) &&
+                 header->words <= (uint64_t)info.st_size / sizeof(uint64_t) &&
+                 perfect_hash_memory_len(header->words, header->count) == (size_t)info.st_size;
+
+    uint64_t level_words = 0;
+    for (uint32_t level = 0; valid && level < header->levels; level++)
+    {
+        valid = header->level_bits[level] && header->level_bits[level] % 64 == 0;
+        level_words += header->level_bits[level] / 64;
+    }
+
+    if (!valid || level_words != header->words)
+    {
+        munmap(map, (size_t)info.st_size);
+        return false;
+    }
+
+    if (header->count != count || header->checksum != checksum)
+    {
+        if (stale)
+        {
+            *stale = true;
+        }
+        munmap(map, (size_t)info.st_size);
+        return false;
+    }
+
+    perfect_hash_attach(index, map, (size_t)info.st_size, true);
+    return true;
+}
+
+#endif /* E989C8CF_DE42_4A24_9FCB_C202F7AD7664 */
@@ -0,0 +1,96 @@
+#ifndef E3B6C0D2_5F7A_4C18_9E41_7A2D6B9F0C35
+#define E3B6C0D2_5F7A_4C18_9E41_7A2D6B9F0C35
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "./batch_search.h"
+#include "./search_kernel.h"
+
+/*
+
+Range queries over a sorted int64_t array, all answered with the branchless probe kernel.
+
+A key x occupies the positions [lower_bound(x), upper_bound(x)), so equal_range is two
+probes and the number of keys in [low, high] is upper_bound(high) - lower_bound(low), two
+probes as well instead of a scan over the range. Both bounds of an inclusive range are kept
+as lower bounds, the upper one being lower_bound(high + 1), so that the batched count can
+push all of them through the interleaved kernel of batch_search.h as one group.
+
+*/
+
+typedef struct
+{
+    int64_t first; // first position of the key, or where it would be inserted
+    int64_t last;  // one past its last position; last - first is the number of copies
+} index_range_t;
+
+// index of the first element not less than x, or len
+int64_t lower_bound(const int64_t *nums, int64_t len, int64_t x)
+{
+    return (int64_t)branchless_lower_bound(nums, (size_t)len, x);
+}
+
+// index of the first element greater than x, or len
+int64_t upper_bound(const int64_t *nums, int64_t len, int64_t x)
+{
+    return (int64_t)branchless_upper_bound(nums, (size_t)len, x);
+}
+
+index_range_t equal_range(const int64_t *nums, int64_t len, int64_t x)
+{
+    index_range_t range;
+    range.first = lower_bound(nums, len, x);
+    range.last = range.first + upper_bound(nums + range.first, len - range.first, x);
+    return range;
+}
+
+// number of elements in [low, high], 0 if the range is empty
+int64_t count_in_range(const int64_t *nums, int64_t len, int64_t low, int64_t high)
+{
+    if (low > high)
+    {
+        return 0;
+    }
+
+    // the keys in range start at first, so the upper bound only has to search past it
+    int64_t first = lower_bound(nums, len, low);
+    return upper_bound(nums + first, len - first, high);
+}
+
+// results[i] = number of elements in [lows[i], highs[i]]
+void batch_count_in_range(const int64_t *nums, size_t len, const int64_t *lows, const int64_t *highs, size_t count, int64_t *results)
+{
+    int64_t keys[2 * BATCH_SEARCH_GROUP];
+    int64_t bounds[2 * BATCH_SEARCH_GROUP];
+
+    for (size_t start = 0; start < count; start += BATCH_SEARCH_GROUP)
+    {
+        size_t group = count - start < BATCH_SEARCH_GROUP ? count - start : BATCH_SEARCH_GROUP;
+
+        // the upper end of [low, high] is the lower bound of high + 1; INT64_MAX has none
+        for (size_t lane = 0; lane < group; lane++)
+        {
+            int64_t high = highs[start + lane];
+            keys[lane] = lows[start + lane];
+            keys[group + lane] = high == INT64_MAX ? high : high + 1;
+        }
+
+        batch_lower_bound(nums, len, keys, 2 * group, bounds);
+
+        for (size_t lane = 0; lane < group; lane++)
+        {
+            int64_t high = highs[start + lane];
+            int64_t last = bounds[group + lane];
+            if (high == INT64_MAX)
+            {
+                last = (int64_t)len;
+            }
+
+            int64_t found = last - bounds[lane];
+            results[start + lane] = lows[start + lane] > high || found < 0 ? 0 : found;
+        }
+    }
+}
+
+#endif /* E3B6C0D2_5F7A_4C18_9E41_7A2D6B9F0C35 */
@@ -0,0 +1,60 @@
+#ifndef D9706DCD_9294_496C_B5B2_1744E329B1AE
+#define D9706DCD_9294_496C_B5B2_1744E329B1AE
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+
+The probe kernel shared by the search structures over a plain sorted array.
+
+Instead of keeping two ends and branching three ways like binary_search, it keeps a base
+pointer and a length. Every step halves the length and moves the base forward by the
+comparison result; the compiler turns that into a conditional move, so there is no branch
+to mispredict, and the number of steps depends only on len, not on the data. That is what
+lets several searches advance in lockstep.
+
+The invariant is that the answer lies in [base, base + len]; it is resolved with one last
+comparison when len reaches 1.
+
+*/
+
+// index of the first element not less than x, or len
+static inline size_t branchless_lower_bound(const int64_t *nums, size_t len, int64_t x)
+{
+    if (!len)
+    {
+        return 0;
+    }
+
+    const int64_t *base = nums;
+    while (len > 1)
+    {
+        size_t half = len / 2;
+        base = (base[half - 1] < x) ? base + half : base;
+        len -= half;
+    }
+
+    return (size_t)(base - nums) + (*base < x);
+}
+
+// index of the first element greater than x, or len
+static inline size_t branchless_upper_bound(const int64_t *nums, size_t len, int64_t x)
+{
+    if (!len)
+    {
+        return 0;
+    }
+
+    const int64_t *base = nums;
+    while (len > 1)
+    {
+        size_t half = len / 2;
+        base = (base[half - 1] <= x) ? base + half : base;
+        len -= half;
+    }
+
+    return (size_t)(base - nums) + (*base <= x);
+}
+
+#endif /* D9706DCD_9294_496C_B5B2_1744E329B1AE */
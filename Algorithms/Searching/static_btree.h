@@ -0,0 +1,205 @@
+#ifndef B62407AB_FB0B_45D5_BFB9_0F28CF2978B2
+#define B62407AB_FB0B_45D5_BFB9_0F28CF2978B2
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/*
+
+A static B+ tree (S+ tree) over a sorted int64_t array, built once after the sort.
+
+Every node is one cache line holding B = 8 keys, and has B + 1 children, so a lookup over n keys
+touches about log9(n) cache lines instead of the log2(n) of binary search: 10 instead of
+30 for 10^9 keys. Nothing is stored but keys; the tree is implicit:
+
+1. Layer 0 is a copy of the sorted array, padded with INT64_MAX to a multiple of B and
+aligned like the other layers. Its blocks of B keys are the leaves.
+2. Each layer above has one key per child but the first, per node: the separator in slot j of
+node k is the smallest key below child k (B + 1) + j + 1. Missing children get INT64_MAX.
+3. The layers are stored top to bottom in one cache-line aligned array.
+
+Inside a node, the search only needs the number of keys smaller than x, which is the index
+of the child to descend into. With AVX2 that is two 4 x 64-bit compares, a movemask and a
+popcount, and no branches at all; without AVX2 the compiler vectorizes the eight compares
+as well as it can.
+
+Because layer 0 holds the sorted array, the leaf reached by lower_bound directly gives the
+position in the sorted array. upper_bound is the lower bound of x + 1.
+
+Build with -mavx2 (or -march=native) to get the vector rank.
+
+*/
+
+#define STATIC_BTREE_B 8
+#define STATIC_BTREE_MAX_HEIGHT 32
+
+typedef struct
+{
+    int64_t *tree;
+    size_t len;                               // number of real keys
+    size_t slots;                             // total keys stored, including padding and separators
+    int height;                               // number of layers, leaves included
+    size_t offsets[STATIC_BTREE_MAX_HEIGHT];  // first slot of every layer, layer 0 being the leaves
+} static_btree_t;
+
+static inline size_t static_btree_blocks(size_t keys)
+{
+    return (keys + STATIC_BTREE_B - 1) / STATIC_BTREE_B;
+}
+
+// number of separator keys the layer above a layer of keys keys needs
+static inline size_t static_btree_parent_keys(size_t keys)
+{
+    return (static_btree_blocks(keys) + STATIC_BTREE_B) / (STATIC_BTREE_B + 1) * STATIC_BTREE_B;
+}
+
+// number of keys of x's node that are smaller than x
+static inline unsigned static_btree_rank(const int64_t *node, int64_t x)
+{
+#ifdef __AVX2__
+    __m256i key = _mm256_set1_epi64x(x);
+    __m256i low = _mm256_cmpgt_epi64(key, _mm256_load_si256((const __m256i *)node));
+    __m256i high = _mm256_cmpgt_epi64(key, _mm256_load_si256((const __m256i *)(node + 4)));
+    unsigned mask = (unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(low)) |
+                    ((unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(high)) << 4);
+    return (unsigned)__builtin_popcount(mask);
+#else
+    unsigned rank = 0;
+    for (int counter = 0; counter < STATIC_BTREE_B; counter++)
+    {
+        rank += (node[counter] < x);
+    }
+    return rank;
+#endif
+}
+
+bool static_btree_build(static_btree_t *index, const int64_t *sorted, size_t len)
+{
+    if (!index || (!sorted && len))
+    {
+        return false;
+    }
+
+    // layer sizes, from the leaves up
+    size_t sizes[STATIC_BTREE_MAX_HEIGHT];
+    size_t keys = len;
+    int height = 0;
+    do
+    {
+        sizes[height++] = static_btree_blocks(keys ? keys : 1) * STATIC_BTREE_B;
+        if (keys <= STATIC_BTREE_B)
+        {
+            break;
+        }
+        keys = static_btree_parent_keys(keys);
+    } while (height < STATIC_BTREE_MAX_HEIGHT);
+
+    // store the root first, so that a lookup walks the array forward
+    size_t slots = 0;
+    for (int layer = height - 1; layer >= 0; layer--)
+    {
+        index->offsets[layer] = slots;
+        slots += sizes[layer];
+    }
+
+    index->tree = (int64_t *)aligned_alloc(64, sizeof(int64_t) * slots);
+    if (!index->tree)
+    {
+        return false;
+    }
+    index->len = len;
+    index->slots = slots;
+    index->height = height;
+
+    int64_t *leaves = index->tree + index->offsets[0];
+    memcpy(leaves, sorted, sizeof(int64_t) * len);
+    for (size_t slot = len; slot < sizes[0]; slot++)
+    {
+        leaves[slot] = INT64_MAX;
+    }
+
+    for (int layer = 1; layer < height; layer++)
+    {
+        int64_t *keys_of_layer = index->tree + index->offsets[layer];
+        for (size_t slot = 0; slot < sizes[layer]; slot++)
+        {
+            // leftmost leaf below the child to the right of this separator
+            size_t node = (slot / STATIC_BTREE_B) * (STATIC_BTREE_B + 1) + slot % STATIC_BTREE_B + 1;
+            for (int below = layer - 1; below > 0; below--)
+            {
+                node *= (STATIC_BTREE_B + 1);
+            }
+
+            size_t leaf_slot = node * STATIC_BTREE_B;
+            keys_of_layer[slot] = leaf_slot < len ? sorted[leaf_slot] : INT64_MAX;
+        }
+    }
+
+    return true;
+}
+
+void static_btree_free(static_btree_t *index)
+{
+    if (!index)
+    {
+        return;
+    }
+
+    free(index->tree);
+    index->tree = NULL;
+    index->len = 0;
+    index->slots = 0;
+}
+
+// bytes used by the index; the leaves are a copy, so all of it comes on top of the sorted array
+size_t static_btree_memory(const static_btree_t *index)
+{
+    return sizeof(int64_t) * index->slots;
+}
+
+// index of the first key not less than x, or len
+int64_t static_btree_lower_bound(const static_btree_t *index, int64_t x)
+{
+    const int64_t *tree = index->tree;
+    size_t node = 0;
+
+    for (int layer = index->height - 1; layer > 0; layer--)
+    {
+        node = node * (STATIC_BTREE_B + 1) + static_btree_rank(tree + index->offsets[layer] + node * STATIC_BTREE_B, x);
+    }
+
+    size_t position = node * STATIC_BTREE_B + static_btree_rank(tree + index->offsets[0] + node * STATIC_BTREE_B, x);
+    return (int64_t)(position < index->len ? position : index->len);
+}
+
+// index of the first key greater than x, or len
+int64_t static_btree_upper_bound(const static_btree_t *index, int64_t x)
+{
+    if (x == INT64_MAX)
+    {
+        return (int64_t)index->len;
+    }
+
+    return static_btree_lower_bound(index, x + 1);
+}
+
+// position of a key equal to x (the first one, if there are several), or -1
+int64_t static_btree_search(const static_btree_t *index, int64_t x)
+{
+    int64_t position = static_btree_lower_bound(index, x);
+    if ((size_t)position == index->len || index->tree[index->offsets[0] + position] != x)
+    {
+        return -1;
+    }
+
+    return position;
+}
+
+#endif /* B62407AB_FB0B_45D5_BFB9_0F28CF2978B2 */
@@ -1,6 +1,11 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include "../../Strix/header/strix.h"
+#include <stdint.h>
+#include <string.h>
+#include "../IO/i64_format.h"
+#include "../IO/int_writer.h"
+#include "./natural_merge_sort.h"
+#include "./pipeline_sort.h"
 
 void insertion_sort(int64_t *nums, int64_t len)
 {
@@ -21,74 +26,113 @@ void insertion_sort(int64_t *nums, int64_t len)
     }
 }
 
-int main()
+bool sort_mapped(const char *input_path, int_writer_t *writer, bool binary_output, bool insertion, size_t *num_len)
 {
-    strix_t *input_strix = conv_file_to_strix("input.txt");
-    if (!input_strix)
+    int64_input_t input;
+    if (!load_int64_input(input_path, &input, true))
     {
-        return EXIT_FAILURE;
+        return false;
     }
 
-    strix_arr_t *lines = strix_split_by_delim(input_strix, '\n');
-    if (!lines)
+    if (!input.sorted && insertion)
     {
-        strix_free(input_strix);
-        return EXIT_FAILURE;
+        insertion_sort(input.nums, (int64_t)input.len);
+    }
+    else if (!input.sorted && !natural_merge_sort(input.nums, (int64_t)input.len))
+    {
+        free_int64_input(&input);
+        return false;
     }
 
-    strix_free(input_strix);
+    if (binary_output)
+    {
+        int_writer_put_i64(writer, input.nums, input.len);
+    }
+    else
+    {
+        int_writer_put_int64_array(writer, input.nums, input.len, '\n');
+    }
 
-    size_t num_len = 0;
-    for (size_t counter = 0; counter < lines->len; counter++)
+    *num_len = input.len;
+    free_int64_input(&input);
+    return !writer->failed;
+}
+
+bool sort_streamed(const char *input_path, int_writer_t *writer, bool binary_output, size_t *num_len)
+{
+    int input_fd = strcmp(input_path, "-") ? open(input_path, O_RDONLY) : STDIN_FILENO;
+    if (input_fd < 0)
     {
-        strix_arr_t *num_arr = strix_split_by_delim(lines->strix_arr[counter], ' ');
-        if (!num_arr)
-        {
-            strix_free_strix_arr(lines);
-            return EXIT_FAILURE;
-        }
-        num_len += num_arr->len;
-        strix_free_strix_arr(num_arr);
+        return false;
     }
 
-    int64_t *nums = (int64_t *)malloc(sizeof(int64_t) * num_len);
-    if (!nums)
+    pipeline_config_t config = {.chunk_size = 0, .parser_threads = 0, .binary_output = binary_output};
+    bool sorted = pipeline_sort(input_fd, writer, &config, num_len);
+
+    if (input_fd != STDIN_FILENO)
     {
-        strix_free_strix_arr(lines);
-        return EXIT_FAILURE;
+        close(input_fd);
     }
+    return sorted;
+}
+
+/*
+
+insertion_sort [-i] [input] [output]
+
+input defaults to input.txt ("-" reads standard input); .i64 files are mapped and sorted in
+place, text goes through the read/parse/sort/write pipeline. The output defaults to standard
+output and is written in the .i64 format when its name ends in .i64.
+
+Both paths sort with the natural merge sort. -i sorts with the insertion sort above instead,
+in O(n^2), which is only fit for small or almost sorted inputs, and serves as the reference
+the faster sorts are checked against; the input is then loaded whole, so it must be a file.
+
+*/
+
+int main(int argc, char **argv)
+{
+    int first = argc > 1 && !strcmp(argv[1], "-i") ? 2 : 1;
+    bool insertion = first == 2;
+    const char *input_path = argc > first ? argv[first] : "input.txt";
+    const char *output_path = argc > first + 1 ? argv[first + 1] : NULL;
+
+    size_t path_len = output_path ? strlen(output_path) : 0;
+    bool binary_output = path_len >= 4 && !strcmp(output_path + path_len - 4, ".i64");
 
-    size_t nums_written = 0;
-    for (size_t counter = 0; counter < lines->len; counter++)
+    int output_fd = STDOUT_FILENO;
+    if (output_path)
     {
-        strix_arr_t *num_arr_one = strix_split_by_delim(lines->strix_arr[counter], ' ');
-        if (!num_arr_one)
+        output_fd = open(output_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (output_fd < 0)
         {
-            free(nums);
-            strix_free_strix_arr(lines);
             return EXIT_FAILURE;
         }
+    }
 
-        for (size_t index = 0; index < num_arr_one->len; index++)
+    int_writer_t writer;
+    if (!int_writer_init(&writer, output_fd, 0))
+    {
+        if (output_fd != STDOUT_FILENO)
         {
-            if (nums_written < num_len)
-            {
-                nums[nums_written++] = strix_to_signed_int(num_arr_one->strix_arr[index]);
-            }
+            close(output_fd);
         }
-        strix_free_strix_arr(num_arr_one);
+        return EXIT_FAILURE;
     }
 
-    strix_free_strix_arr(lines);
-
-    insertion_sort(nums, num_len);
+    size_t num_len = 0;
+    bool sorted = is_i64_file(input_path) || insertion ? sort_mapped(input_path, &writer, binary_output, insertion, &num_len)
+                                                       : sort_streamed(input_path, &writer, binary_output, &num_len);
+    if (sorted && !binary_output)
+    {
+        int_writer_put_int64(&writer, (int64_t)num_len, '\n');
+    }
 
-    for (size_t counter = 0; counter < num_len; counter++)
+    bool written = int_writer_close(&writer) && sorted;
+    if (output_fd != STDOUT_FILENO && close(output_fd) < 0)
     {
-        fprintf(stdout, "%ld\n", nums[counter]);
+        written = false;
     }
-    printf("%ld\n", num_len);
 
-    free(nums);
-    return EXIT_SUCCESS;
-}
\ No newline at end of file
+    return written ? EXIT_SUCCESS : EXIT_FAILURE;
+}
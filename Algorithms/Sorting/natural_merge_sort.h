@@ -0,0 +1,642 @@
+#ifndef DDE4AE92_F673_4100_A2BD_0ED470B01C41
+#define DDE4AE92_F673_4100_A2BD_0ED470B01C41
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+
+Most of the input we sort is not random: appended logs and merged shards arrive as a
+handful of long sorted stretches. Insertion sort only profits from that when the
+stretches are tiny, and a plain quicksort ignores it completely.
+
+A natural merge sort (the scheme popularized by Timsort) works directly on that structure:
+
+1. The input is scanned left to right for runs. A run is either non-descending or
+strictly descending; descending runs are reversed in place (strictness keeps this stable).
+2. Runs shorter than min_run are extended with binary insertion sort, so the merge phase
+never deals with a large number of tiny runs.
+3. Every run is pushed on a merge stack. Whenever the lengths on the top of the stack stop
+growing like the Fibonacci numbers, adjacent runs are merged; this keeps the stack depth
+logarithmic in n and the merges balanced.
+4. A merge first gallops (exponential search followed by binary search) to skip the prefix
+of the left run and the suffix of the right run that are already in place, and then
+switches between one-at-a-time merging and galloping depending on how often one side wins.
+
+For an input made of k sorted runs, the merge pattern is balanced over the runs, so the
+total work is O(n log k) comparisons, down to O(n) for data that is already sorted.
+
+*/
+
+#define NATURAL_MERGE_MIN_MERGE 32
+#define NATURAL_MERGE_MIN_GALLOP 7
+#define NATURAL_MERGE_MAX_STACK 85 // enough for any 64-bit length, since run lengths grow like the Fibonacci numbers
+
+typedef struct
+{
+    int64_t *nums;
+    int64_t *tmp;
+    int64_t min_gallop;
+    int64_t stack_size;
+    int64_t run_base[NATURAL_MERGE_MAX_STACK];
+    int64_t run_len[NATURAL_MERGE_MAX_STACK];
+} merge_state_t;
+
+static inline void reverse_range(int64_t *nums, int64_t lo, int64_t hi)
+{
+    hi--;
+    while (lo < hi)
+    {
+        int64_t temp = nums[lo];
+        nums[lo++] = nums[hi];
+        nums[hi--] = temp;
+    }
+}
+
+// returns the length of the run starting at lo, reversing it first if it is strictly descending
+int64_t count_run_and_make_ascending(int64_t *nums, int64_t lo, int64_t hi)
+{
+    int64_t run_hi = lo + 1;
+    if (run_hi == hi)
+    {
+        return 1;
+    }
+
+    if (nums[run_hi++] < nums[lo])
+    {
+        while (run_hi < hi && nums[run_hi] < nums[run_hi - 1])
+        {
+            run_hi++;
+        }
+        reverse_range(nums, lo, run_hi);
+    }
+    else
+    {
+        while (run_hi < hi && nums[run_hi] >= nums[run_hi - 1])
+        {
+            run_hi++;
+        }
+    }
+
+    return run_hi - lo;
+}
+
+// sorts nums[lo, hi), given that nums[lo, start) is already sorted
+void binary_insertion_sort(int64_t *nums, int64_t lo, int64_t hi, int64_t start)
+{
+    if (start == lo)
+    {
+        start++;
+    }
+
+    for (; start < hi; start++)
+    {
+        int64_t pivot = nums[start];
+        int64_t left = lo;
+        int64_t right = start;
+
+        while (left < right)
+        {
+            int64_t mid = left + ((right - left) >> 1);
+            if (pivot < nums[mid])
+            {
+                right = mid;
+            }
+            else
+            {
+                left = mid + 1;
+            }
+        }
+
+        memmove(nums + left + 1, nums + left, sizeof(int64_t) * (start - left));
+        nums[left] = pivot;
+    }
+}
+
+int64_t min_run_length(int64_t len)
+{
+    int64_t low_bits = 0;
+    while (len >= NATURAL_MERGE_MIN_MERGE)
+    {
+        low_bits |= (len & 1);
+        len >>= 1;
+    }
+
+    return len + low_bits;
+}
+
+/*
+
+gallop_left returns the k in [0, len] such that base[k - 1] < key <= base[k], and gallop_right
+the k such that base[k - 1] <= key < base[k]. Both start at base[hint] and probe at offsets
+1, 3, 7, ... before finishing with a binary search, so they cost O(log d) for an answer at
+distance d from the hint.
+
+*/
+
+int64_t gallop_left(int64_t key, const int64_t *base, int64_t len, int64_t hint)
+{
+    int64_t last_offset = 0;
+    int64_t offset = 1;
+
+    if (key > base[hint])
+    {
+        int64_t max_offset = len - hint;
+        while (offset < max_offset && key > base[hint + offset])
+        {
+            last_offset = offset;
+            offset = (offset << 1) + 1;
+        }
+        if (offset > max_offset)
+        {
+            offset = max_offset;
+        }
+
+        last_offset += hint;
+        offset += hint;
+    }
+    else
+    {
+        int64_t max_offset = hint + 1;
+        while (offset < max_offset && key <= base[hint - offset])
+        {
+            last_offset = offset;
+            offset = (offset << 1) + 1;
+        }
+        if (offset > max_offset)
+        {
+            offset = max_offset;
+        }
+
+        int64_t temp = last_offset;
+        last_offset = hint - offset;
+        offset = hint - temp;
+    }
+
+    last_offset++;
+    while (last_offset < offset)
+    {
+        int64_t mid = last_offset + ((offset - last_offset) >> 1);
+        if (key > base[mid])
+        {
+            last_offset = mid + 1;
+        }
+        else
+        {
+            offset = mid;
+        }
+    }
+
+    return offset;
+}
+
+int64_t gallop_right(int64_t key, const int64_t *base, int64_t len, int64_t hint)
+{
+    int64_t last_offset = 0;
+    int64_t offset = 1;
+
+    if (key < base[hint])
+    {
+        int64_t max_offset = hint + 1;
+        while (offset < max_offset && key < base[hint - offset])
+        {
+            last_offset = offset;
+            offset = (offset << 1) + 1;
+        }
+        if (offset > max_offset)
+        {
+            offset = max_offset;
+        }
+
+        int64_t temp = last_offset;
+        last_offset = hint - offset;
+        offset = hint - temp;
+    }
+    else
+    {
+        int64_t max_offset = len - hint;
+        while (offset < max_offset && key >= base[hint + offset])
+        {
+            last_offset = offset;
+            offset = (offset << 1) + 1;
+        }
+        if (offset > max_offset)
+        {
+            offset = max_offset;
+        }
+
+        last_offset += hint;
+        offset += hint;
+    }
+
+    last_offset++;
+    while (last_offset < offset)
+    {
+        int64_t mid = last_offset + ((offset - last_offset) >> 1);
+        if (key < base[mid])
+        {
+            offset = mid;
+        }
+        else
+        {
+            last_offset = mid + 1;
+        }
+    }
+
+    return offset;
+}
+
+/*
+
+merge_low merges the run [base_one, base_one + len_one) with the adjacent run that follows it
+when the first one is the shorter; the first run is moved to the scratch buffer and the output
+is written from the left. merge_high is the mirror image for a shorter second run.
+
+On entry the first element of the second run is smaller than every element of the first
+run and the last element of the first run is larger than every element of the second run;
+merge_at establishes this by galloping before calling either of them.
+
+*/
+
+void merge_low(merge_state_t *state, int64_t base_one, int64_t len_one, int64_t base_two, int64_t len_two)
+{
+    int64_t *nums = state->nums;
+    int64_t *tmp = state->tmp;
+    memcpy(tmp, nums + base_one, sizeof(int64_t) * len_one);
+
+    int64_t cursor_one = 0;
+    int64_t cursor_two = base_two;
+    int64_t end_two = base_two + len_two;
+    int64_t dest = base_one;
+    int64_t min_gallop = state->min_gallop;
+
+    nums[dest++] = nums[cursor_two++];
+    bool done = (cursor_two == end_two || len_one == 1);
+
+    while (!done)
+    {
+        int64_t count_one = 0;
+        int64_t count_two = 0;
+
+        // one element at a time until one of the runs wins min_gallop times in a row
+        while (count_one < min_gallop && count_two < min_gallop)
+        {
+            if (nums[cursor_two] < tmp[cursor_one])
+            {
+                nums[dest++] = nums[cursor_two++];
+                count_two++;
+                count_one = 0;
+                if (cursor_two == end_two)
+                {
+                    done = true;
+                    break;
+                }
+            }
+            else
+            {
+                nums[dest++] = tmp[cursor_one++];
+                count_one++;
+                count_two = 0;
+                if (cursor_one == len_one - 1)
+                {
+                    done = true;
+                    break;
+                }
+            }
+        }
+
+        // galloping mode, which is kept as long as it keeps moving long stretches
+        while (!done)
+        {
+            count_one = gallop_right(nums[cursor_two], tmp + cursor_one, len_one - cursor_one, 0);
+            if (count_one)
+            {
+                memcpy(nums + dest, tmp + cursor_one, sizeof(int64_t) * count_one);
+                dest += count_one;
+                cursor_one += count_one;
+                if (cursor_one >= len_one - 1)
+                {
+                    done = true;
+                    break;
+                }
+            }
+
+            nums[dest++] = nums[cursor_two++];
+            if (cursor_two == end_two)
+            {
+                done = true;
+                break;
+            }
+
+            count_two = gallop_left(tmp[cursor_one], nums + cursor_two, end_two - cursor_two, 0);
+            if (count_two)
+            {
+                memmove(nums + dest, nums + cursor_two, sizeof(int64_t) * count_two);
+                dest += count_two;
+                cursor_two += count_two;
+                if (cursor_two == end_two)
+                {
+                    done = true;
+                    break;
+                }
+            }
+
+            nums[dest++] = tmp[cursor_one++];
+            if (cursor_one == len_one - 1)
+            {
+                done = true;
+                break;
+            }
+
+            if (min_gallop > 1)
+            {
+                min_gallop--;
+            }
+            if (count_one < NATURAL_MERGE_MIN_GALLOP && count_two < NATURAL_MERGE_MIN_GALLOP)
+            {
+                min_gallop += 2; // penalize leaving galloping mode
+                break;
+            }
+        }
+    }
+
+    state->min_gallop = min_gallop < 1 ? 1 : min_gallop;
+
+    if (cursor_one < len_one)
+    {
+        if (cursor_two < end_two)
+        {
+            // only the last element of the first run is left, and it belongs after the second run
+            memmove(nums + dest, nums + cursor_two, sizeof(int64_t) * (end_two - cursor_two));
+            nums[dest + end_two - cursor_two] = tmp[cursor_one];
+        }
+        else
+        {
+            memcpy(nums + dest, tmp + cursor_one, sizeof(int64_t) * (len_one - cursor_one));
+        }
+    }
+}
+
+void merge_high(merge_state_t *state, int64_t base_one, int64_t len_one, int64_t base_two, int64_t len_two)
+{
+    int64_t *nums = state->nums;
+    int64_t *tmp = state->tmp;
+    memcpy(tmp, nums + base_two, sizeof(int64_t) * len_two);
+
+    int64_t cursor_one = base_one + len_one - 1;
+    int64_t cursor_two = len_two - 1;
+    int64_t dest = base_two + len_two - 1;
+    int64_t min_gallop = state->min_gallop;
+
+    nums[dest--] = nums[cursor_one--];
+    bool done = (cursor_one < base_one || len_two == 1);
+
+    while (!done)
+    {
+        int64_t count_one = 0;
+        int64_t count_two = 0;
+
+        while (count_one < min_gallop && count_two < min_gallop)
+        {
+            if (tmp[cursor_two] < nums[cursor_one])
+            {
+                nums[dest--] = nums[cursor_one--];
+                count_one++;
+                count_two = 0;
+                if (cursor_one < base_one)
+                {
+                    done = true;
+                    break;
+                }
+            }
+            else
+            {
+                nums[dest--] = tmp[cursor_two--];
+                count_two++;
+                count_one = 0;
+                if (cursor_two == 0)
+                {
+                    done = true;
+                    break;
+                }
+            }
+        }
+
+        while (!done)
+        {
+            int64_t remaining_one = cursor_one - base_one + 1;
+            count_one = remaining_one - gallop_right(tmp[cursor_two], nums + base_one, remaining_one, remaining_one - 1);
+            if (count_one)
+            {
+                dest -= count_one;
+                cursor_one -= count_one;
+                memmove(nums + dest + 1, nums + cursor_one + 1, sizeof(int64_t) * count_one);
+                if (cursor_one < base_one)
+                {
+                    done = true;
+                    break;
+                }
+            }
+
+            nums[dest--] = tmp[cursor_two--];
+            if (cursor_two == 0)
+            {
+                done = true;
+                break;
+            }
+
+            count_two = cursor_two + 1 - gallop_left(nums[cursor_one], tmp, cursor_two + 1, cursor_two);
+            if (count_two)
+            {
+                dest -= count_two;
+                cursor_two -= count_two;
+                memcpy(nums + dest + 1, tmp + cursor_two + 1, sizeof(int64_t) * count_two);
+                if (cursor_two <= 0)
+                {
+                    done = true;
+                    break;
+                }
+            }
+
+            nums[dest--] = nums[cursor_one--];
+            if (cursor_one < base_one)
+            {
+                done = true;
+                break;
+            }
+
+            if (min_gallop > 1)
+            {
+                min_gallop--;
+            }
+            if (count_one < NATURAL_MERGE_MIN_GALLOP && count_two < NATURAL_MERGE_MIN_GALLOP)
+            {
+                min_gallop += 2;
+                break;
+            }
+        }
+    }
+
+    state->min_gallop = min_gallop < 1 ? 1 : min_gallop;
+
+    if (cursor_two >= 0)
+    {
+        if (cursor_one >= base_one)
+        {
+            // only the first element of the second run is left, and it belongs before the first run
+            int64_t count = cursor_one - base_one + 1;
+            memmove(nums + dest - count + 1, nums + base_one, sizeof(int64_t) * count);
+            nums[dest - count] = tmp[cursor_two];
+        }
+        else
+        {
+            memcpy(nums + base_one, tmp, sizeof(int64_t) * (cursor_two + 1));
+        }
+    }
+}
+
+// merges the runs at stack positions index and index + 1
+void merge_at(merge_state_t *state, int64_t index)
+{
+    int64_t base_one = state->run_base[index];
+    int64_t len_one = state->run_len[index];
+    int64_t base_two = state->run_base[index + 1];
+    int64_t len_two = state->run_len[index + 1];
+
+    state->run_len[index] = len_one + len_two;
+    if (index == state->stack_size - 3)
+    {
+        state->run_base[index + 1] = state->run_base[index + 2];
+        state->run_len[index + 1] = state->run_len[index + 2];
+    }
+    state->stack_size--;
+
+    // elements of the first run that are not larger than the head of the second one are already in place
+    int64_t skip = gallop_right(state->nums[base_two], state->nums + base_one, len_one, 0);
+    base_one += skip;
+    len_one -= skip;
+    if (!len_one)
+    {
+        return;
+    }
+
+    // and so are the elements of the second run that are not smaller than the tail of the first one
+    len_two = gallop_left(state->nums[base_one + len_one - 1], state->nums + base_two, len_two, len_two - 1);
+    if (!len_two)
+    {
+        return;
+    }
+
+    if (len_one <= len_two)
+    {
+        merge_low(state, base_one, len_one, base_two, len_two);
+    }
+    else
+    {
+        merge_high(state, base_one, len_one, base_two, len_two);
+    }
+}
+
+/*
+
+Keeps the invariants run_len[i - 2] > run_len[i - 1] + run_len[i] and run_len[i - 1] > run_len[i]
+on the whole stack. Checking only the top three entries is not enough to guarantee them
+further down, which is why the fourth entry from the top is examined as well.
+
+*/
+
+void merge_collapse(merge_state_t *state)
+{
+    while (state->stack_size > 1)
+    {
+        int64_t index = state->stack_size - 2;
+        int64_t *run_len = state->run_len;
+
+        if ((index > 0 && run_len[index - 1] <= run_len[index] + run_len[index + 1]) ||
+            (index > 1 && run_len[index - 2] <= run_len[index - 1] + run_len[index]))
+        {
+            if (run_len[index - 1] < run_len[index + 1])
+            {
+                index--;
+            }
+        }
+        else if (run_len[index] > run_len[index + 1])
+        {
+            break;
+        }
+
+        merge_at(state, index);
+    }
+}
+
+void merge_force_collapse(merge_state_t *state)
+{
+    while (state->stack_size > 1)
+    {
+        int64_t index = state->stack_size - 2;
+        if (index > 0 && state->run_len[index - 1] < state->run_len[index + 1])
+        {
+            index--;
+        }
+        merge_at(state, index);
+    }
+}
+
+// returns false if the scratch buffer (at most len / 2 elements) cannot be allocated
+bool natural_merge_sort(int64_t *nums, int64_t len)
+{
+    if (!nums || len < 2)
+    {
+        return true;
+    }
+
+    if (len < NATURAL_MERGE_MIN_MERGE)
+    {
+        int64_t run_len = count_run_and_make_ascending(nums, 0, len);
+        binary_insertion_sort(nums, 0, len, run_len);
+        return true;
+    }
+
+    merge_state_t state;
+    state.nums = nums;
+    state.tmp = (int64_t *)malloc(sizeof(int64_t) * (len / 2 + 1));
+    if (!state.tmp)
+    {
+        return false;
+    }
+    state.min_gallop = NATURAL_MERGE_MIN_GALLOP;
+    state.stack_size = 0;
+
+    int64_t min_run = min_run_length(len);
+    int64_t lo = 0;
+    int64_t remaining = len;
+
+    while (remaining)
+    {
+        int64_t run_len = count_run_and_make_ascending(nums, lo, len);
+
+        if (run_len < min_run)
+        {
+            int64_t forced = remaining < min_run ? remaining : min_run;
+            binary_insertion_sort(nums, lo, lo + forced, lo + run_len);
+            run_len = forced;
+        }
+
+        state.run_base[state.stack_size] = lo;
+        state.run_len[state.stack_size] = run_len;
+        state.stack_size++;
+        merge_collapse(&state);
+
+        lo += run_len;
+        remaining -= run_len;
+    }
+
+    merge_force_collapse(&state);
+
+    free(state.tmp);
+    return true;
+}
+
+#endif /* DDE4AE92_F673_4100_A2BD_0ED470B01C41 */
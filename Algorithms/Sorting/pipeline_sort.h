@@ -0,0 +1,566 @@
+#ifndef D01CCAD5_BBC8_4D62_A6B9_78CC6496EF90
+#define D01CCAD5_BBC8_4D62_A6B9_78CC6496EF90
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../IO/chunk_reader.h"
+#include "../IO/i64_format.h"
+#include "../IO/int_writer.h"
+#include "./natural_merge_sort.h"
+
+/*
+
+Reading, parsing, sorting and printing one after the other costs the sum of all four. The
+pipeline overlaps them:
+
+    reader --raw chunks--> parser threads (parse + sort a run each) --runs--> merge --blocks--> writer
+
+1. The reader thread fills chunk buffers from a fixed pool with chunk_reader_fill and queues
+them. When the pool is empty it waits, so memory for raw text stays bounded.
+2. Every parser thread takes a chunk, parses it into its own int64_t run, returns the
+chunk buffer to the pool and sorts the run. Sorting therefore runs while the reader is
+still busy with the rest of the file.
+3. Once all runs exist, they are merged with a binary heap over the run heads. The merged
+values go out in blocks through a second bounded queue to the writer thread, which
+formats them while the merge carries on.
+
+End-to-end time approaches max(read, sort) plus the final merge instead of the sum.
+
+Both queues are ring buffers whose size is a power of two, like ARRAY_QUEUE in queue.h, made
+blocking with a mutex and two condition variables.
+
+*/
+
+#define PIPELINE_DEFAULT_CHUNK_SIZE (8 << 20)
+#define PIPELINE_OUTPUT_BLOCK 65536
+#define PIPELINE_OUTPUT_BLOCKS 4
+
+typedef struct
+{
+    void **items;
+    size_t front;
+    size_t rear;
+    size_t size;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} bounded_queue_t;
+
+bool bounded_queue_init(bounded_queue_t *queue, size_t min_capacity)
+{
+    size_t size = 2;
+    while (size <= min_capacity)
+    {
+        size <<= 1; // one slot stays unused to tell a full queue from an empty one
+    }
+
+    queue->items = (void **)malloc(sizeof(void *) * size);
+    if (!queue->items)
+    {
+        return false;
+    }
+
+    queue->front = 0;
+    queue->rear = 0;
+    queue->size = size;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+    return true;
+}
+
+void bounded_queue_push(bounded_queue_t *queue, void *item)
+{
+    pthread_mutex_lock(&queue->lock);
+    while (((queue->rear + 1) & (queue->size - 1)) == queue->front)
+    {
+        pthread_cond_wait(&queue->not_full, &queue->lock);
+    }
+
+    queue->items[queue->rear] = item;
+    queue->rear = (queue->rear + 1) & (queue->size - 1);
+
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+void *bounded_queue_pop(bounded_queue_t *queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    while (queue->front == queue->rear)
+    {
+        pthread_cond_wait(&queue->not_empty, &queue->lock);
+    }
+
+    void *item = queue->items[queue->front];
+    queue->front = (queue->front + 1) & (queue->size - 1);
+
+    pthread_cond_signal(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+    return item;
+}
+
+void bounded_queue_destroy(bounded_queue_t *queue)
+{
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+    free(queue->items);
+}
+
+typedef struct
+{
+    char *data;
+    size_t len;
+} raw_chunk_t;
+
+typedef struct
+{
+    int64_t *nums;
+    size_t len;
+} output_block_t;
+
+typedef struct
+{
+    size_t chunk_size;     // bytes per raw chunk, 0 for the default
+    size_t parser_threads; // 0 for one per online core
+    bool binary_output;    // emit an .i64 file instead of text lines
+} pipeline_config_t;
+
+typedef struct
+{
+    int input_fd;
+    const pipeline_config_t *config;
+    size_t parser_threads;
+
+    bounded_queue_t free_chunks;
+    bounded_queue_t raw_chunks;
+    bounded_queue_t free_blocks;
+    bounded_queue_t full_blocks;
+
+    pthread_mutex_t runs_lock;
+    int64_buffer_t *runs;
+    size_t run_count;
+    size_t run_capacity;
+
+    int_writer_t *writer;
+    bool failed;
+} pipeline_t;
+
+static void pipeline_fail(pipeline_t *pipeline)
+{
+    pthread_mutex_lock(&pipeline->runs_lock);
+    pipeline->failed = true;
+    pthread_mutex_unlock(&pipeline->runs_lock);
+}
+
+static bool pipeline_failed(pipeline_t *pipeline)
+{
+    pthread_mutex_lock(&pipeline->runs_lock);
+    bool failed = pipeline->failed;
+    pthread_mutex_unlock(&pipeline->runs_lock);
+    return failed;
+}
+
+static void *pipeline_reader(void *arg)
+{
+    pipeline_t *pipeline = (pipeline_t *)arg;
+    chunk_reader_t reader;
+    chunk_reader_init(&reader, pipeline->input_fd);
+
+    while (!pipeline_failed(pipeline))
+    {
+        raw_chunk_t *chunk = (raw_chunk_t *)bounded_queue_pop(&pipeline->free_chunks);
+        chunk->len = chunk_reader_fill(&reader, chunk->data, pipeline->config->chunk_size);
+        if (!chunk->len)
+        {
+            bounded_queue_push(&pipeline->free_chunks, chunk);
+            break;
+        }
+        bounded_queue_push(&pipeline->raw_chunks, chunk);
+    }
+
+    if (reader.failed)
+    {
+        pipeline_fail(pipeline);
+    }
+
+    // one end marker per parser thread
+    for (size_t counter = 0; counter < pipeline->parser_threads; counter++)
+    {
+        bounded_queue_push(&pipeline->raw_chunks, NULL);
+    }
+
+    return NULL;
+}
+
+static bool pipeline_add_run(pipeline_t *pipeline, int64_buffer_t *run)
+{
+    pthread_mutex_lock(&pipeline->runs_lock);
+    if (pipeline->run_count == pipeline->run_capacity)
+    {
+        size_t capacity = pipeline->run_capacity ? pipeline->run_capacity * 2 : 16;
+        int64_buffer_t *runs = (int64_buffer_t *)realloc(pipeline->runs, sizeof(int64_buffer_t) * capacity);
+        if (!runs)
+        {
+            pipeline->failed = true;
+            pthread_mutex_unlock(&pipeline->runs_lock);
+            return false;
+        }
+        pipeline->runs = runs;
+        pipeline->run_capacity = capacity;
+    }
+
+    pipeline->runs[pipeline->run_count++] = *run;
+    pthread_mutex_unlock(&pipeline->runs_lock);
+    return true;
+}
+
+static void *pipeline_parser(void *arg)
+{
+    pipeline_t *pipeline = (pipeline_t *)arg;
+
+    raw_chunk_t *chunk;
+    while ((chunk = (raw_chunk_t *)bounded_queue_pop(&pipeline->raw_chunks)))
+    {
+        int64_buffer_t run;
+        bool parsed = int64_buffer_init(&run, chunk->len / 8 + 16) &&
+                      parse_int64_range_into(chunk->data, chunk->data + chunk->len, &run);
+        bounded_queue_push(&pipeline->free_chunks, chunk);
+
+        if (!parsed || !natural_merge_sort(run.nums, (int64_t)run.len) || !pipeline_add_run(pipeline, &run))
+        {
+            int64_buffer_free(&run);
+            pipeline_fail(pipeline);
+        }
+    }
+
+    return NULL;
+}
+
+static void *pipeline_writer(void *arg)
+{
+    pipeline_t *pipeline = (pipeline_t *)arg;
+
+    output_block_t *block;
+    while ((block = (output_block_t *)bounded_queue_pop(&pipeline->full_blocks)))
+    {
+        if (pipeline->config->binary_output)
+        {
+            int_writer_put_raw(pipeline->writer, block->nums, sizeof(int64_t) * block->len);
+        }
+        else
+        {
+            int_writer_put_int64_array(pipeline->writer, block->nums, block->len, '\n');
+        }
+        bounded_queue_push(&pipeline->free_blocks, block);
+    }
+
+    return NULL;
+}
+
+typedef struct
+{
+    int64_t head;
+    size_t run;
+} merge_head_t;
+
+static void merge_heap_sift_down(merge_head_t *heap, size_t root, size_t len)
+{
+    merge_head_t item = heap[root];
+    size_t child;
+    while ((child = 2 * root + 1) < len)
+    {
+        if (child + 1 < len && heap[child + 1].head < heap[child].head)
+        {
+            child++;
+        }
+        if (item.head <= heap[child].head)
+        {
+            break;
+        }
+        heap[root] = heap[child];
+        root = child;
+    }
+    heap[root] = item;
+}
+
+// merges all runs into blocks for the writer; the writer must be running
+static bool pipeline_merge(pipeline_t *pipeline)
+{
+    size_t run_count = pipeline->run_count;
+    merge_head_t *heap = (merge_head_t *)malloc(sizeof(merge_head_t) * (run_count + 1));
+    size_t *cursors = (size_t *)calloc(run_count + 1, sizeof(size_t));
+    if (!heap || !cursors)
+    {
+        free(heap);
+        free(cursors);
+        return false;
+    }
+
+    size_t heap_len = 0;
+    for (size_t counter = 0; counter < run_count; counter++)
+    {
+        if (pipeline->runs[counter].len)
+        {
+            heap[heap_len].head = pipeline->runs[counter].nums[0];
+            heap[heap_len++].run = counter;
+        }
+    }
+    for (size_t root = heap_len / 2; root-- > 0;)
+    {
+        merge_heap_sift_down(heap, root, heap_len);
+    }
+
+    output_block_t *block = (output_block_t *)bounded_queue_pop(&pipeline->free_blocks);
+    block->len = 0;
+
+    while (heap_len)
+    {
+        size_t run = heap[0].run;
+        int64_buffer_t *source = pipeline->runs + run;
+
+        // copy from the smallest run until its head passes the runner-up
+        int64_t limit = INT64_MAX;
+        if (heap_len > 1)
+        {
+            limit = heap[1].head;
+            if (heap_len > 2 && heap[2].head < limit)
+            {
+                limit = heap[2].head;
+            }
+        }
+
+        size_t cursor = cursors[run];
+        do
+        {
+            block->nums[block->len++] = source->nums[cursor++];
+            if (block->len == PIPELINE_OUTPUT_BLOCK)
+            {
+                bounded_queue_push(&pipeline->full_blocks, block);
+                block = (output_block_t *)bounded_queue_pop(&pipeline->free_blocks);
+                block->len = 0;
+            }
+        } while (cursor < source->len && source->nums[cursor] <= limit);
+        cursors[run] = cursor;
+
+        if (cursor == source->len)
+        {
+            heap[0] = heap[--heap_len];
+            int64_buffer_free(source);
+        }
+        else
+        {
+            heap[0].head = source->nums[cursor];
+        }
+        merge_heap_sift_down(heap, 0, heap_len);
+    }
+
+    if (block->len)
+    {
+        bounded_queue_push(&pipeline->full_blocks, block);
+    }
+    else
+    {
+        bounded_queue_push(&pipeline->free_blocks, block);
+    }
+
+    free(heap);
+    free(cursors);
+    return true;
+}
+
+static bool pipeline_put_header(pipeline_t *pipeline, size_t total)
+{
+    i64_header_t header;
+    i64_fill_header(&header, NULL, 0);
+    header.count = total;
+    header.sorted = 1;
+
+    bool first = true;
+    for (size_t counter = 0; counter < pipeline->run_count; counter++)
+    {
+        int64_buffer_t *run = pipeline->runs + counter;
+        if (!run->len)
+        {
+            continue;
+        }
+        if (first || run->nums[0] < header.min)
+        {
+            header.min = run->nums[0];
+        }
+        if (first || run->nums[run->len - 1] > header.max)
+        {
+            header.max = run->nums[run->len - 1];
+        }
+        first = false;
+    }
+
+    return int_writer_put_raw(pipeline->writer, &header, sizeof(header));
+}
+
+static void pipeline_release(pipeline_t *pipeline, raw_chunk_t *chunks, size_t chunk_count, output_block_t *blocks)
+{
+    for (size_t counter = 0; counter < chunk_count; counter++)
+    {
+        free(chunks[counter].data);
+    }
+    for (size_t counter = 0; counter < PIPELINE_OUTPUT_BLOCKS; counter++)
+    {
+        free(blocks[counter].nums);
+    }
+    for (size_t counter = 0; counter < pipeline->run_count; counter++)
+    {
+        int64_buffer_free(pipeline->runs + counter);
+    }
+    free(pipeline->runs);
+
+    bounded_queue_destroy(&pipeline->free_chunks);
+    bounded_queue_destroy(&pipeline->raw_chunks);
+    bounded_queue_destroy(&pipeline->free_blocks);
+    bounded_queue_destroy(&pipeline->full_blocks);
+    pthread_mutex_destroy(&pipeline->runs_lock);
+    free(chunks);
+}
+
+/*
+
+Sorts all integers readable from input_fd and writes them to writer, which the caller owns
+and closes. The number of values is stored in count. Returns false if anything failed; what
+was written up to that point must then be discarded.
+
+*/
+
+bool pipeline_sort(int input_fd, int_writer_t *writer, const pipeline_config_t *config, size_t *count)
+{
+    pipeline_config_t settings = *config;
+    if (settings.chunk_size < 2 * CHUNK_READER_MAX_CARRY)
+    {
+        settings.chunk_size = PIPELINE_DEFAULT_CHUNK_SIZE;
+    }
+    if (!settings.parser_threads)
+    {
+        settings.parser_threads = default_parse_threads();
+    }
+
+    pipeline_t pipeline;
+    memset(&pipeline, 0, sizeof(pipeline));
+    pipeline.input_fd = input_fd;
+    pipeline.config = &settings;
+    pipeline.parser_threads = settings.parser_threads;
+    pipeline.writer = writer;
+    pthread_mutex_init(&pipeline.runs_lock, NULL);
+
+    size_t chunk_count = settings.parser_threads + 2;
+    raw_chunk_t *chunks = (raw_chunk_t *)calloc(chunk_count, sizeof(raw_chunk_t));
+    output_block_t blocks[PIPELINE_OUTPUT_BLOCKS] = {0};
+
+    bool ready = chunks &&
+                 bounded_queue_init(&pipeline.free_chunks, chunk_count) &&
+                 bounded_queue_init(&pipeline.raw_chunks, chunk_count + settings.parser_threads) &&
+                 bounded_queue_init(&pipeline.free_blocks, PIPELINE_OUTPUT_BLOCKS) &&
+                 bounded_queue_init(&pipeline.full_blocks, PIPELINE_OUTPUT_BLOCKS + 1);
+
+    for (size_t counter = 0; ready && counter < chunk_count; counter++)
+    {
+        chunks[counter].data = (char *)malloc(settings.chunk_size);
+        ready = (chunks[counter].data != NULL);
+        if (ready)
+        {
+            bounded_queue_push(&pipeline.free_chunks, chunks + counter);
+        }
+    }
+    for (size_t counter = 0; ready && counter < PIPELINE_OUTPUT_BLOCKS; counter++)
+    {
+        blocks[counter].nums = (int64_t *)malloc(sizeof(int64_t) * PIPELINE_OUTPUT_BLOCK);
+        ready = (blocks[counter].nums != NULL);
+        if (ready)
+        {
+            bounded_queue_push(&pipeline.free_blocks, blocks + counter);
+        }
+    }
+
+    if (!ready)
+    {
+        if (chunks)
+        {
+            pipeline_release(&pipeline, chunks, chunk_count, blocks);
+        }
+        return false;
+    }
+
+    // read and parse
+    pthread_t reader;
+    pthread_t *parsers = (pthread_t *)malloc(sizeof(pthread_t) * settings.parser_threads);
+    if (!parsers || pthread_create(&reader, NULL, pipeline_reader, &pipeline))
+    {
+        free(parsers);
+        pipeline_release(&pipeline, chunks, chunk_count, blocks);
+        return false;
+    }
+
+    size_t started = 0;
+    for (; started < settings.parser_threads; started++)
+    {
+        if (pthread_create(parsers + started, NULL, pipeline_parser, &pipeline))
+        {
+            break;
+        }
+    }
+    if (!started)
+    {
+        pipeline_parser(&pipeline); // run inline so the reader can finish
+    }
+
+    pthread_join(reader, NULL);
+    for (size_t counter = 0; counter < started; counter++)
+    {
+        pthread_join(parsers[counter], NULL);
+    }
+    free(parsers);
+
+    // the reader queued one end marker per configured parser; drop the ones nobody took
+    while (pipeline.raw_chunks.front != pipeline.raw_chunks.rear)
+    {
+        bounded_queue_pop(&pipeline.raw_chunks);
+    }
+
+    if (pipeline.failed)
+    {
+        pipeline_release(&pipeline, chunks, chunk_count, blocks);
+        return false;
+    }
+
+    size_t total = 0;
+    for (size_t counter = 0; counter < pipeline.run_count; counter++)
+    {
+        total += pipeline.runs[counter].len;
+    }
+
+    // merge and write
+    if (settings.binary_output && !pipeline_put_header(&pipeline, total))
+    {
+        pipeline_release(&pipeline, chunks, chunk_count, blocks);
+        return false;
+    }
+
+    pthread_t writer_thread;
+    bool threaded = !pthread_create(&writer_thread, NULL, pipeline_writer, &pipeline);
+    bool merged = threaded && pipeline_merge(&pipeline);
+    if (threaded)
+    {
+        bounded_queue_push(&pipeline.full_blocks, NULL);
+        pthread_join(writer_thread, NULL);
+    }
+
+    pipeline_release(&pipeline, chunks, chunk_count, blocks);
+    *count = total;
+    return merged && !writer->failed;
+}
+
+#endif /* D01CCAD5_BBC8_4D62_A6B9_78CC6496EF90 */
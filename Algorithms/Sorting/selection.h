@@ -0,0 +1,335 @@
+#ifndef F54C8FA8_16BB_4259_AEA9_BFD8095D901E
+#define F54C8FA8_16BB_4259_AEA9_BFD8095D901E
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "./sort_template.h"
+
+/*
+
+Plenty of jobs sort a whole array only to read its median or its smallest few values.
+Selection answers those questions without paying for the full O(n log n) sort:
+
+1. nth_element (nums, len, nth): rearranges nums so that nums[nth] is the value that would
+be there after sorting, everything before it is not larger and everything after it is not
+smaller. This is an introselect: quickselect with a median-of-three pivot, which runs in
+expected O(n), and which switches to the median-of-medians pivot once it has recursed more
+than 2 log2(n) times, so that adversarial inputs are still O(n) in the worst case.
+
+2. partial_sort (nums, len, k): leaves the k smallest values sorted in nums[0, k) and the rest
+in arbitrary order behind them, in O(n + k log k).
+
+3. top_k: a streaming structure that keeps the k smallest values seen so far in a bounded
+max-heap, so that an input which never exists as a whole array can still be reduced in
+O(n log k) time and O(k) memory.
+
+All of them work on the int64_t buffers built by the sorting and searching programs.
+
+*/
+
+#define SELECTION_INSERTION_THRESHOLD 16
+
+#define SELECTION_INT64_LESS(a, b) ((a) < (b))
+DEFINE_SORT(selection_sort_int64, int64_t, SELECTION_INT64_LESS)
+
+static inline void selection_swap(int64_t *left, int64_t *right)
+{
+    int64_t temp = *left;
+    *left = *right;
+    *right = temp;
+}
+
+static void selection_insertion(int64_t *nums, int64_t lo, int64_t hi)
+{
+    for (int64_t counter = lo + 1; counter < hi; counter++)
+    {
+        int64_t item = nums[counter];
+        int64_t index = counter;
+        while (index > lo && item < nums[index - 1])
+        {
+            nums[index] = nums[index - 1];
+            index--;
+        }
+        nums[index] = item;
+    }
+}
+
+/*
+
+Three-way partition of nums[lo, hi) around the value nums[pivot_index]; on return
+nums[lo, *lt) < pivot, nums[*lt, *gt) == pivot and nums[*gt, hi) > pivot. Keeping the equal
+values together guarantees progress on inputs with many duplicates.
+
+*/
+
+static void selection_partition(int64_t *nums, int64_t lo, int64_t hi, int64_t pivot_index, int64_t *lt, int64_t *gt)
+{
+    int64_t pivot = nums[pivot_index];
+    int64_t less = lo;
+    int64_t index = lo;
+    int64_t greater = hi;
+
+    while (index < greater)
+    {
+        if (nums[index] < pivot)
+        {
+            selection_swap(nums + less++, nums + index++);
+        }
+        else if (nums[index] > pivot)
+        {
+            selection_swap(nums + index, nums + --greater);
+        }
+        else
+        {
+            index++;
+        }
+    }
+
+    *lt = less;
+    *gt = greater;
+}
+
+// worst-case linear selection; only reached when quickselect degenerates
+static void median_of_medians_select(int64_t *nums, int64_t lo, int64_t hi, int64_t nth)
+{
+    while (hi - lo > SELECTION_INSERTION_THRESHOLD)
+    {
+        // gather the medians of groups of five at the front
+        int64_t medians = 0;
+        for (int64_t group = lo; group < hi; group += 5)
+        {
+            int64_t end = group + 5 < hi ? group + 5 : hi;
+            selection_insertion(nums, group, end);
+            selection_swap(nums + lo + medians, nums + group + (end - group) / 2);
+            medians++;
+        }
+
+        int64_t pivot_index = lo + medians / 2;
+        median_of_medians_select(nums, lo, lo + medians, pivot_index);
+
+        int64_t lt, gt;
+        selection_partition(nums, lo, hi, pivot_index, &lt, &gt);
+        if (nth < lt)
+        {
+            hi = lt;
+        }
+        else if (nth >= gt)
+        {
+            lo = gt;
+        }
+        else
+        {
+            return;
+        }
+    }
+
+    selection_insertion(nums, lo, hi);
+}
+
+void nth_element(int64_t *nums, int64_t len, int64_t nth)
+{
+    if (!nums || nth < 0 || nth >= len)
+    {
+        return;
+    }
+
+    int64_t lo = 0;
+    int64_t hi = len;
+    int depth = 0;
+    for (int64_t temp = len; temp > 1; temp >>= 1)
+    {
+        depth += 2;
+    }
+
+    while (hi - lo > SELECTION_INSERTION_THRESHOLD)
+    {
+        if (!depth--)
+        {
+            median_of_medians_select(nums, lo, hi, nth);
+            return;
+        }
+
+        int64_t mid = lo + (hi - lo) / 2;
+        int64_t last = hi - 1;
+        if (nums[mid] < nums[lo])
+        {
+            selection_swap(nums + mid, nums + lo);
+        }
+        if (nums[last] < nums[mid])
+        {
+            selection_swap(nums + last, nums + mid);
+            if (nums[mid] < nums[lo])
+            {
+                selection_swap(nums + mid, nums + lo);
+            }
+        }
+
+        int64_t lt, gt;
+        selection_partition(nums, lo, hi, mid, &lt, &gt);
+        if (nth < lt)
+        {
+            hi = lt;
+        }
+        else if (nth >= gt)
+        {
+            lo = gt;
+        }
+        else
+        {
+            return;
+        }
+    }
+
+    selection_insertion(nums, lo, hi);
+}
+
+void partial_sort(int64_t *nums, int64_t len, int64_t k)
+{
+    if (!nums || k <= 0 || len < 2)
+    {
+        return;
+    }
+    if (k > len)
+    {
+        k = len;
+    }
+
+    if (k < len)
+    {
+        nth_element(nums, len, k - 1);
+    }
+    selection_sort_int64(nums, (size_t)k);
+}
+
+/*
+
+The streaming top-k keeps a max-heap of the k smallest values seen so far: a new value is
+only looked at further if it beats the current maximum, which for long random streams
+happens rarely, so most pushes cost a single comparison.
+
+*/
+
+typedef struct
+{
+    int64_t *heap;
+    int64_t len;
+    int64_t k;
+} top_k_t;
+
+top_k_t *create_top_k(int64_t k)
+{
+    if (k <= 0)
+    {
+        return NULL;
+    }
+
+    top_k_t *top = (top_k_t *)malloc(sizeof(top_k_t));
+    if (!top)
+    {
+        return NULL;
+    }
+
+    top->heap = (int64_t *)malloc(sizeof(int64_t) * k);
+    if (!top->heap)
+    {
+        free(top);
+        return NULL;
+    }
+
+    top->len = 0;
+    top->k = k;
+    return top;
+}
+
+static void top_k_sift_down(int64_t *heap, int64_t root, int64_t len)
+{
+    int64_t item = heap[root];
+    int64_t child;
+    while ((child = 2 * root + 1) < len)
+    {
+        if (child + 1 < len && heap[child] < heap[child + 1])
+        {
+            child++;
+        }
+        if (item >= heap[child])
+        {
+            break;
+        }
+        heap[root] = heap[child];
+        root = child;
+    }
+    heap[root] = item;
+}
+
+static void top_k_sift_up(int64_t *heap, int64_t index)
+{
+    int64_t item = heap[index];
+    while (index > 0)
+    {
+        int64_t parent = (index - 1) / 2;
+        if (heap[parent] >= item)
+        {
+            break;
+        }
+        heap[index] = heap[parent];
+        index = parent;
+    }
+    heap[index] = item;
+}
+
+void top_k_push(top_k_t *top, int64_t value)
+{
+    if (top->len < top->k)
+    {
+        top->heap[top->len] = value;
+        top_k_sift_up(top->heap, top->len++);
+    }
+    else if (value < top->heap[0])
+    {
+        top->heap[0] = value;
+        top_k_sift_down(top->heap, 0, top->len);
+    }
+}
+
+void top_k_push_all(top_k_t *top, const int64_t *nums, int64_t len)
+{
+    for (int64_t counter = 0; counter < len; counter++)
+    {
+        top_k_push(top, nums[counter]);
+    }
+}
+
+// the largest of the k smallest values seen so far; only meaningful once len > 0
+int64_t top_k_threshold(top_k_t *top)
+{
+    return top->heap[0];
+}
+
+/*
+
+Sorts the retained values ascending and returns them; the count is written to len.
+This consumes the heap order, so no more values may be pushed afterwards.
+
+*/
+
+const int64_t *top_k_result(top_k_t *top, int64_t *len)
+{
+    selection_sort_int64(top->heap, (size_t)top->len);
+    *len = top->len;
+    return top->heap;
+}
+
+void delete_top_k(top_k_t *top)
+{
+    if (!top)
+    {
+        return;
+    }
+
+    free(top->heap);
+    free(top);
+}
+
+#endif /* F54C8FA8_16BB_4259_AEA9_BFD8095D901E */
@@ -0,0 +1,235 @@
+#ifndef CB3DBFD9_EADD_4F11_BFBC_15A5429DD2AE
+#define CB3DBFD9_EADD_4F11_BFBC_15A5429DD2AE
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+
+The sorts in this directory work on bare int64_t, but the records we actually sort are
+key-plus-payload structs. Going through qsort would cost an indirect call for every
+comparison and a byte-wise swap for every exchange, and neither can be inlined.
+
+Instead, the generators below stamp out a sort for one element type at a time, in the
+same spirit as the item_t placeholders in the data structure headers, except that the
+type and the comparison are fixed at the point of use:
+
+    #define RECORD_LESS(a, b) ((a).key < (b).key)
+    DEFINE_SORT(record_sort, record_t, RECORD_LESS)
+
+    record_sort(records, len);
+
+LESS(a, b) receives two values of type T (not pointers) and must be a strict weak ordering.
+The generated sort is an introsort: median-of-three quicksort, falling back to heapsort
+once the recursion gets deeper than 2 log2(n), with insertion sort finishing the small
+partitions. It is not stable.
+
+When records are large, moving them around during the sort dominates. DEFINE_SORT_BY_KEY
+generates a sort that extracts (key, index) pairs, sorts those (ties broken by index, so
+this one is stable), and then permutes the records in place along the cycles of the
+permutation, so every record is moved exactly once:
+
+    #define RECORD_KEY(r) ((r).key)
+    DEFINE_SORT_BY_KEY(record_sort_by_key, record_t, int64_t, RECORD_KEY)
+
+    if (!record_sort_by_key(records, len)) { ... out of memory ... }
+
+*/
+
+#define SORT_TEMPLATE_INSERTION_THRESHOLD 16
+
+#define DEFINE_SORT(name, T, LESS)                                                   \
+                                                                                     \
+    static inline void name##_swap(T *left, T *right)                                \
+    {                                                                                \
+        T temp = *left;                                                              \
+        *left = *right;                                                              \
+        *right = temp;                                                               \
+    }                                                                                \
+                                                                                     \
+    static void name##_insertion(T *base, size_t lo, size_t hi)                      \
+    {                                                                                \
+        for (size_t counter = lo + 1; counter < hi; counter++)                       \
+        {                                                                            \
+            T item = base[counter];                                                  \
+            size_t index = counter;                                                  \
+            while (index > lo && LESS(item, base[index - 1]))                        \
+            {                                                                        \
+                base[index] = base[index - 1];                                       \
+                index--;                                                             \
+            }                                                                        \
+            base[index] = item;                                                      \
+        }                                                                            \
+    }                                                                                \
+                                                                                     \
+    static void name##_sift_down(T *base, size_t root, size_t len)                   \
+    {                                                                                \
+        T item = base[root];                                                         \
+        size_t child;                                                                \
+        while ((child = 2 * root + 1) < len)                                         \
+        {                                                                            \
+            if (child + 1 < len && LESS(base[child], base[child + 1]))               \
+            {                                                                        \
+                child++;                                                             \
+            }                                                                        \
+            if (!LESS(item, base[child]))                                            \
+            {                                                                        \
+                break;                                                               \
+            }                                                                        \
+            base[root] = base[child];                                                \
+            root = child;                                                            \
+        }                                                                            \
+        base[root] = item;                                                           \
+    }                                                                                \
+                                                                                     \
+    static void name##_heapsort(T *base, size_t len)                                 \
+    {                                                                                \
+        for (size_t root = len / 2; root-- > 0;)                                     \
+        {                                                                            \
+            name##_sift_down(base, root, len);                                       \
+        }                                                                            \
+        for (size_t end = len; end-- > 1;)                                           \
+        {                                                                            \
+            name##_swap(base, base + end);                                           \
+            name##_sift_down(base, 0, end);                                          \
+        }                                                                            \
+    }                                                                                \
+                                                                                     \
+    static void name##_introsort(T *base, size_t lo, size_t hi, int depth)           \
+    {                                                                                \
+        while (hi - lo > SORT_TEMPLATE_INSERTION_THRESHOLD)                          \
+        {                                                                            \
+            if (!depth--)                                                            \
+            {                                                                        \
+                name##_heapsort(base + lo, hi - lo);                                 \
+                return;                                                              \
+            }                                                                        \
+                                                                                     \
+            size_t mid = lo + (hi - lo) / 2;                                         \
+            size_t last = hi - 1;                                                    \
+            if (LESS(base[mid], base[lo]))                                           \
+            {                                                                        \
+                name##_swap(base + mid, base + lo);                                  \
+            }                                                                        \
+            if (LESS(base[last], base[mid]))                                         \
+            {                                                                        \
+                name##_swap(base + last, base + mid);                                \
+                if (LESS(base[mid], base[lo]))                                       \
+                {                                                                    \
+                    name##_swap(base + mid, base + lo);                              \
+                }                                                                    \
+            }                                                                        \
+                                                                                     \
+            /* base[lo] and base[last] now act as sentinels for the partition */     \
+            name##_swap(base + mid, base + lo + 1);                                  \
+            T pivot = base[lo + 1];                                                  \
+            size_t left = lo + 1;                                                    \
+            size_t right = last;                                                     \
+            for (;;)                                                                 \
+            {                                                                        \
+                do                                                                   \
+                {                                                                    \
+                    left++;                                                          \
+                } while (LESS(base[left], pivot));                                   \
+                do                                                                   \
+                {                                                                    \
+                    right--;                                                         \
+                } while (LESS(pivot, base[right]));                                  \
+                if (left >= right)                                                   \
+                {                                                                    \
+                    break;                                                           \
+                }                                                                    \
+                name##_swap(base + left, base + right);                              \
+            }                                                                        \
+            name##_swap(base + lo + 1, base + right);                                \
+                                                                                     \
+            /* recurse into the smaller side, loop on the larger one */              \
+            if (right - lo < hi - right - 1)                                         \
+            {                                                                        \
+                name##_introsort(base, lo, right, depth);                            \
+                lo = right + 1;                                                      \
+            }                                                                        \
+            else                                                                     \
+            {                                                                        \
+                name##_introsort(base, right + 1, hi, depth);                        \
+                hi = right;                                                          \
+            }                                                                        \
+        }                                                                            \
+    }                                                                                \
+                                                                                     \
+    static inline void name(T *base, size_t len)                                     \
+    {                                                                                \
+        if (!base || len < 2)                                                        \
+        {                                                                            \
+            return;                                                                  \
+        }                                                                            \
+        int depth = 0;                                                               \
+        for (size_t temp = len; temp > 1; temp >>= 1)                                \
+        {                                                                            \
+            depth += 2;                                                              \
+        }                                                                            \
+        name##_introsort(base, 0, len, depth);                                       \
+        name##_insertion(base, 0, len);                                              \
+    }
+
+#define SORT_TEMPLATE_PAIR_LESS(a, b) ((a).key < (b).key || (!((b).key < (a).key) && (a).index < (b).index))
+
+#define DEFINE_SORT_BY_KEY(name, T, K, KEY)                                          \
+                                                                                     \
+    typedef struct                                                                   \
+    {                                                                                \
+        K key;                                                                       \
+        size_t index;                                                                \
+    } name##_pair_t;                                                                 \
+                                                                                     \
+    DEFINE_SORT(name##_pairs, name##_pair_t, SORT_TEMPLATE_PAIR_LESS)                \
+                                                                                     \
+    static inline bool name(T *base, size_t len)                                     \
+    {                                                                                \
+        if (!base || len < 2)                                                        \
+        {                                                                            \
+            return true;                                                             \
+        }                                                                            \
+                                                                                     \
+        name##_pair_t *pairs = (name##_pair_t *)malloc(sizeof(name##_pair_t) * len); \
+        if (!pairs)                                                                  \
+        {                                                                            \
+            return false;                                                            \
+        }                                                                            \
+        for (size_t counter = 0; counter < len; counter++)                           \
+        {                                                                            \
+            pairs[counter].key = KEY(base[counter]);                                 \
+            pairs[counter].index = counter;                                          \
+        }                                                                            \
+                                                                                     \
+        name##_pairs(pairs, len);                                                    \
+                                                                                     \
+        /* position counter has to receive the record at pairs[counter].index; */    \
+        /* each cycle is walked once and marked done by setting index = counter */   \
+        for (size_t counter = 0; counter < len; counter++)                           \
+        {                                                                            \
+            if (pairs[counter].index == counter)                                     \
+            {                                                                        \
+                continue;                                                            \
+            }                                                                        \
+            T item = base[counter];                                                  \
+            size_t hole = counter;                                                   \
+            size_t source = pairs[hole].index;                                       \
+            while (source != counter)                                                \
+            {                                                                        \
+                base[hole] = base[source];                                           \
+                pairs[hole].index = hole;                                            \
+                hole = source;                                                       \
+                source = pairs[hole].index;                                          \
+            }                                                                        \
+            base[hole] = item;                                                       \
+            pairs[hole].index = hole;                                                \
+        }                                                                            \
+                                                                                     \
+        free(pairs);                                                                 \
+        return true;                                                                 \
+    }
+
+#endif /* CB3DBFD9_EADD_4F11_BFBC_15A5429DD2AE */
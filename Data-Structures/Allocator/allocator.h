@@ -3,20 +3,33 @@
 
 #include <stdlib.h>
 
+/*
+
+The custom allocator is the heap of the MemoryManager project, which sits next to this
+repository. Where it is not available, build with NO_CUSTOM_ALLOCATOR and the structures
+allocate with malloc.
+
+*/
+
+#ifndef NO_CUSTOM_ALLOCATOR
 #include "../../../MemoryManager/mem_alloc.h"
+#define CUSTOM_ALLOCATOR
+#endif
 
 typedef void *(*allocator_t)(size_t size);
 typedef void (*deallocator_t)(void *ptr);
 
 void change_allocator_to_default();
-void change_allocator_to_custom();
 
 void *default_allocator(size_t size);
 void default_deallocator(void *ptr);
+
+#ifdef CUSTOM_ALLOCATOR
+void change_allocator_to_custom();
+
 void *custom_allocator(size_t size);
 void custom_deallocator(void *ptr);
-
-#define CUSTOM_ALLOCATOR
+#endif
 
 allocator_t allocate =
 #ifndef CUSTOM_ALLOCATOR
@@ -42,6 +55,13 @@ void default_deallocator(void *ptr)
     free(ptr);
 }
 
+void change_allocator_to_default()
+{
+    allocate = default_allocator;
+    deallocate = default_deallocator;
+}
+
+#ifdef CUSTOM_ALLOCATOR
 void *custom_allocator(size_t size)
 {
     return heap_alloc(size, ALIGN_DEFAULT);
@@ -52,16 +72,11 @@ void custom_deallocator(void *ptr)
     heap_free(ptr);
 }
 
-void change_allocator_to_default()
-{
-    allocate = default_allocator;
-    deallocate = default_deallocator;
-}
-
 void change_allocator_to_custom()
 {
     allocate = custom_allocator;
     deallocate = custom_deallocator;
 }
+#endif
 
 #endif /* B4E8B570_191E_40E7_BFB3_10EB1EAE4545 */
\ No newline at end of file
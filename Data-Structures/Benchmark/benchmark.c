@@ -0,0 +1,570 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+
+benchmark [csv | json] [operations]
+
+Measures one implementation of stack.h or queue.h, the one named by the macro it is built
+with (-DSTACK_BLOCK, -DARRAY_QUEUE, ...); the implementations share their function names,
+so every one is its own program (run.sh builds and runs them all). The idealized versions,
+CANONICAL_STACK and IDEAL_QUEUE, are not real code and are left out.
+
+Every workload performs about operations (default 2^20) puts and takes:
+
+- burst: puts half of them, then takes them all back.
+- oscillation: fills all but one item of a block (BENCHMARK_BLOCK_SIZE items, the block size
+of the block stacks), then alternates two puts and two takes. Every cycle goes over the
+block boundary and back, so the block stacks allocate and free a block each time.
+- interleaved: two puts and one take, over and over, so the structure keeps growing.
+- random: puts or takes at random, seeded, and takes when the structure is empty.
+
+Whatever is left at the end is taken out as part of the workload. For every workload and
+allocator backend (allocator.h) it prints the nanoseconds per operation (the best of
+BENCHMARK_REPETITIONS runs), the allocations per operation and the peak of the live bytes
+(counting_allocator.h), including the creation of the structure, as CSV (default) or JSON
+lines. A first, untimed run checks every taken item against the order it has to come out
+in, and is the only one that goes through the counting allocator, so that the timed runs
+pay neither its call nor its block headers.
+
+*/
+
+#define BENCHMARK_DEFAULT_OPERATIONS (1 << 20)
+#define BENCHMARK_MAX_OPERATIONS (1 << 24)
+#define BENCHMARK_BLOCK_SIZE 1024
+#define BENCHMARK_REPETITIONS 5
+#define BENCHMARK_SEED 0x9E3779B97F4A7C15ULL
+
+#if defined(STACK_ONE) || defined(STACK_TWO) || defined(STACK_THREE) || defined(STACK_FOUR)
+typedef void *item_t; // the textbook versions leave the item type to their user
+#endif
+
+#if defined(STACK_ONE)
+#define MAX_SIZE BENCHMARK_MAX_OPERATIONS
+#endif
+
+#if defined(ARRAY_QUEUE) || defined(QUEUE_LINKED_LIST) || defined(CYCLIC_LIST_QUEUE) || defined(DOUBLY_LINKED_LIST_QUEUE)
+#define BENCHMARK_QUEUE
+#include "../queue.h"
+#else
+#include "../stack.h"
+#endif
+
+#include "./counting_allocator.h"
+
+/*
+
+Every implementation behind the same five operations: create (for at most capacity items),
+put, take, remove, and its name.
+
+*/
+
+#if defined(STACK_ONE)
+
+#define BENCHMARK_VARIANT "STACK_ONE"
+
+static void *benchmark_create(size_t capacity)
+{
+    (void)capacity;
+    i = 0;
+    return stack;
+}
+
+static bool benchmark_put(void *structure, item_t item)
+{
+    (void)structure;
+    return push(item);
+}
+
+static item_t benchmark_take(void *structure)
+{
+    (void)structure;
+    return pop();
+}
+
+static void benchmark_remove(void *structure)
+{
+    (void)structure;
+}
+
+#elif defined(STACK_TWO)
+
+#define BENCHMARK_VARIANT "STACK_TWO"
+
+static void *benchmark_create(size_t capacity)
+{
+    return create_stack(capacity);
+}
+
+static bool benchmark_put(void *structure, item_t item)
+{
+    return push(item, (stack_t *)structure);
+}
+
+static item_t benchmark_take(void *structure)
+{
+    return pop((stack_t *)structure);
+}
+
+static void benchmark_remove(void *structure)
+{
+    remove_stack((stack_t *)structure);
+}
+
+#elif defined(STACK_THREE)
+
+#define BENCHMARK_VARIANT "STACK_THREE"
+
+stack_t *get_node(void)
+{
+    return (stack_t *)allocate(sizeof(stack_t));
+}
+
+void return_node(stack_t *st)
+{
+    deallocate(st);
+}
+
+static void *benchmark_create(size_t capacity)
+{
+    (void)capacity;
+    return create_stack();
+}
+
+static bool benchmark_put(void *structure, item_t item)
+{
+    push(item, (stack_t *)structure);
+    return true;
+}
+
+static item_t benchmark_take(void *structure)
+{
+    return pop((stack_t *)structure);
+}
+
+static void benchmark_remove(void *structure)
+{
+    remove_stack((stack_t *)structure);
+}
+
+#elif defined(STACK_FOUR)
+
+#define BENCHMARK_VARIANT "STACK_FOUR"
+
+static void *benchmark_create(size_t capacity)
+{
+    (void)capacity;
+    return create_stack(BENCHMARK_BLOCK_SIZE);
+}
+
+static bool benchmark_put(void *structure, item_t item)
+{
+    push(item, (stack_t *)structure);
+    return true;
+}
+
+static item_t benchmark_take(void *structure)
+{
+    return pop((stack_t *)structure);
+}
+
+static void benchmark_remove(void *structure)
+{
+    remove_stack((stack_t *)structure);
+}
+
+#elif defined(STACK_ARR_STREAMLINED) || defined(STACK_ARR_BASIC) || defined(STACK_LINKED_LIST) || \
+    defined(STACK_BLOCK) || defined(STACK_BLOCK_NULL_ERR)
+
+#if defined(STACK_ARR_STREAMLINED)
+#define BENCHMARK_VARIANT "STACK_ARR_STREAMLINED"
+#elif defined(STACK_ARR_BASIC)
+#define BENCHMARK_VARIANT "STACK_ARR_BASIC"
+#elif defined(STACK_LINKED_LIST)
+#define BENCHMARK_VARIANT "STACK_LINKED_LIST"
+#elif defined(STACK_BLOCK)
+#define BENCHMARK_VARIANT "STACK_BLOCK"
+#else
+#define BENCHMARK_VARIANT "STACK_BLOCK_NULL_ERR"
+#endif
+
+static void *benchmark_create(size_t capacity)
+{
+#if defined(STACK_LINKED_LIST)
+    (void)capacity;
+    return create_stack();
+#elif defined(STACK_BLOCK) || defined(STACK_BLOCK_NULL_ERR)
+    (void)capacity;
+    return create_stack(BENCHMARK_BLOCK_SIZE);
+#else
+    return create_stack(capacity);
+#endif
+}
+
+static bool benchmark_put(void *structure, item_t item)
+{
+    return push(item, (stack_t *)structure);
+}
+
+static item_t benchmark_take(void *structure)
+{
+    return pop((stack_t *)structure);
+}
+
+static void benchmark_remove(void *structure)
+{
+    delete_stack((stack_t *)structure);
+}
+
+#elif defined(STACK_ARR_ADV)
+
+#define BENCHMARK_VARIANT "STACK_ARR_ADV"
+
+static void *benchmark_create(size_t capacity)
+{
+    return create_stack(capacity);
+}
+
+static bool benchmark_put(void *structure, item_t item)
+{
+    return push(item, (stack_t *)structure).error == STACK_OK;
+}
+
+static item_t benchmark_take(void *structure)
+{
+    return pop((stack_t *)structure).value;
+}
+
+static void benchmark_remove(void *structure)
+{
+    delete_stack((stack_t *)structure);
+}
+
+#elif defined(BENCHMARK_QUEUE)
+
+#if defined(ARRAY_QUEUE)
+#define BENCHMARK_VARIANT "ARRAY_QUEUE"
+#elif defined(QUEUE_LINKED_LIST)
+#define BENCHMARK_VARIANT "QUEUE_LINKED_LIST"
+#elif defined(CYCLIC_LIST_QUEUE)
+#define BENCHMARK_VARIANT "CYCLIC_LIST_QUEUE"
+#else
+#define BENCHMARK_VARIANT "DOUBLY_LINKED_LIST_QUEUE"
+#endif
+
+static void *benchmark_create(size_t capacity)
+{
+#if defined(ARRAY_QUEUE)
+    size_t size = 2;
+    while (size <= capacity)
+    {
+        size <<= 1; // a power of two, with one slot unused
+    }
+    return create_queue(size);
+#else
+    (void)capacity;
+    return create_queue();
+#endif
+}
+
+static bool benchmark_put(void *structure, item_t item)
+{
+    return enqueue(item, (queue_t *)structure);
+}
+
+static item_t benchmark_take(void *structure)
+{
+    return dequeue((queue_t *)structure);
+}
+
+static void benchmark_remove(void *structure)
+{
+#if defined(CYCLIC_LIST_QUEUE)
+    remove_queue((queue_t *)structure);
+#else
+    delete_queue((queue_t *)structure);
+#endif
+}
+
+#else
+#error "build with one of the stack.h or queue.h implementation macros"
+#endif
+
+#ifdef BENCHMARK_QUEUE
+#define BENCHMARK_STRUCTURE "queue"
+#else
+#define BENCHMARK_STRUCTURE "stack"
+#endif
+
+typedef enum
+{
+    WORKLOAD_BURST,
+    WORKLOAD_OSCILLATION,
+    WORKLOAD_INTERLEAVED,
+    WORKLOAD_RANDOM,
+    WORKLOAD_COUNT
+} workload_t;
+
+static const char *workload_names[WORKLOAD_COUNT] = {"burst", "oscillation", "interleaved", "random"};
+
+/*
+
+The items put are 1, 2, 3, ... A stack has to give back the most recent one still inside
+and a queue the oldest, so both are checked with the record of what is inside: for the
+stack, the values in order; for the queue, a ring of the same values.
+
+*/
+
+typedef struct
+{
+    void *structure;
+    uintptr_t *inside; // the values inside, oldest first from front
+    size_t front;
+    size_t len;
+    size_t capacity;   // of inside, a power of two
+    uintptr_t next;    // the value of the next put
+    size_t operations;
+    bool check;        // keep and compare the record, or only count
+    bool failed;
+} workload_state_t;
+
+static inline void workload_put(workload_state_t *state)
+{
+    uintptr_t value = state->next++;
+    state->failed |= !benchmark_put(state->structure, (item_t)value);
+    if (state->check)
+    {
+        state->inside[(state->front + state->len) & (state->capacity - 1)] = value;
+    }
+    state->len++;
+    state->operations++;
+}
+
+static inline void workload_take(workload_state_t *state)
+{
+    uintptr_t value = (uintptr_t)benchmark_take(state->structure);
+    if (state->check)
+    {
+#ifdef BENCHMARK_QUEUE
+        uintptr_t expected = state->inside[state->front];
+        state->front = (state->front + 1) & (state->capacity - 1);
+#else
+        uintptr_t expected = state->inside[(state->front + state->len - 1) & (state->capacity - 1)];
+#endif
+        state->failed |= value != expected;
+    }
+    state->len--;
+    state->operations++;
+}
+
+static inline uint64_t workload_random(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static void run_workload(workload_state_t *state, workload_t workload, size_t operations)
+{
+    uint64_t random = BENCHMARK_SEED;
+    switch (workload)
+    {
+    case WORKLOAD_BURST:
+        while (state->operations < operations / 2)
+        {
+            workload_put(state);
+        }
+        break;
+    case WORKLOAD_OSCILLATION:
+        while (state->len < BENCHMARK_BLOCK_SIZE - 1)
+        {
+            workload_put(state);
+        }
+        while (state->operations + state->len + 4 <= operations)
+        {
+            workload_put(state);
+            workload_put(state);
+            workload_take(state);
+            workload_take(state);
+        }
+        break;
+    case WORKLOAD_INTERLEAVED:
+        while (state->operations + state->len + 4 <= operations)
+        {
+            workload_put(state);
+            workload_put(state);
+            workload_take(state);
+        }
+        break;
+    default:
+        while (state->operations + state->len < operations)
+        {
+            if (!state->len || (workload_random(&random) & 1))
+            {
+                workload_put(state);
+            }
+            else
+            {
+                workload_take(state);
+            }
+        }
+        break;
+    }
+
+    while (state->len && !state->failed)
+    {
+        workload_take(state);
+    }
+}
+
+typedef struct
+{
+    double ns_per_operation;
+    double allocations_per_operation;
+    size_t peak_bytes;
+    size_t operations;
+} workload_result_t;
+
+static inline double elapsed_ns(const struct timespec *start, const struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) * 1e9 + (double)(end->tv_nsec - start->tv_nsec);
+}
+
+static bool measure_workload(workload_t workload, size_t operations, uintptr_t *inside, size_t capacity, workload_result_t *result)
+{
+    *result = (workload_result_t){0, 0, 0, 0};
+    for (size_t repetition = 0; repetition <= BENCHMARK_REPETITIONS; repetition++)
+    {
+        // the first run checks every item and counts the allocations, and is not timed
+        if (!repetition)
+        {
+            start_counting_allocations();
+            reset_allocation_counts();
+        }
+        workload_state_t state = {benchmark_create(operations), inside, 0, 0, capacity, 1, 0, !repetition, false};
+        if (!state.structure)
+        {
+            if (!repetition)
+            {
+                stop_counting_allocations();
+            }
+            return false;
+        }
+
+        struct timespec start;
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        run_workload(&state, workload, operations);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        benchmark_remove(state.structure);
+
+        if (!repetition)
+        {
+            stop_counting_allocations();
+            result->operations = state.operations;
+            result->allocations_per_operation = (double)allocation_counts.allocations / (double)state.operations;
+            result->peak_bytes = allocation_counts.peak_bytes;
+            if (state.failed || allocation_counts.live_bytes)
+            {
+                return false;
+            }
+            continue;
+        }
+        if (state.failed)
+        {
+            return false;
+        }
+
+        double ns = elapsed_ns(&start, &end) / (double)state.operations;
+        if (repetition == 1 || ns < result->ns_per_operation)
+        {
+            result->ns_per_operation = ns;
+        }
+    }
+
+    return true;
+}
+
+static void print_result(bool json, const char *backend, workload_t workload, const workload_result_t *result)
+{
+    if (json)
+    {
+        printf("{\"structure\":\"%s\",\"variant\":\"%s\",\"allocator\":\"%s\",\"workload\":\"%s\","
+               "\"operations\":%zu,\"ns_per_op\":%.3f,\"allocs_per_op\":%.6f,\"peak_bytes\":%zu}\n",
+               BENCHMARK_STRUCTURE, BENCHMARK_VARIANT, backend, workload_names[workload], result->operations,
+               result->ns_per_operation, result->allocations_per_operation, result->peak_bytes);
+    }
+    else
+    {
+        printf("%s,%s,%s,%s,%zu,%.3f,%.6f,%zu\n", BENCHMARK_STRUCTURE, BENCHMARK_VARIANT, backend,
+               workload_names[workload], result->operations, result->ns_per_operation,
+               result->allocations_per_operation, result->peak_bytes);
+    }
+}
+
+static bool run_backend(bool json, const char *backend, size_t operations, uintptr_t *inside, size_t capacity)
+{
+    bool measured = true;
+    for (int workload = 0; workload < WORKLOAD_COUNT && measured; workload++)
+    {
+        workload_result_t result;
+        measured = measure_workload((workload_t)workload, operations, inside, capacity, &result);
+        if (measured)
+        {
+            print_result(json, backend, (workload_t)workload, &result);
+        }
+        else
+        {
+            fprintf(stderr, "%s: %s failed the %s workload\n", BENCHMARK_VARIANT, backend, workload_names[workload]);
+        }
+    }
+    return measured;
+}
+
+int main(int argc, char **argv)
+{
+    bool json = argc > 1 && !strcmp(argv[1], "json");
+    if (argc > 1 && !json && strcmp(argv[1], "csv"))
+    {
+        return EXIT_FAILURE;
+    }
+
+    size_t operations = argc > 2 ? (size_t)atol(argv[2]) : BENCHMARK_DEFAULT_OPERATIONS;
+    if (operations < 4 * BENCHMARK_BLOCK_SIZE || operations > BENCHMARK_MAX_OPERATIONS)
+    {
+        return EXIT_FAILURE;
+    }
+
+    size_t capacity = 1;
+    while (capacity <= operations)
+    {
+        capacity <<= 1;
+    }
+    uintptr_t *inside = (uintptr_t *)malloc(sizeof(uintptr_t) * capacity);
+    if (!inside)
+    {
+        return EXIT_FAILURE;
+    }
+
+    if (!json)
+    {
+        printf("structure,variant,allocator,workload,operations,ns_per_op,allocs_per_op,peak_bytes\n");
+    }
+
+    change_allocator_to_default();
+    bool measured = run_backend(json, "default", operations, inside, capacity);
+#ifdef CUSTOM_ALLOCATOR
+    change_allocator_to_custom();
+    measured = run_backend(json, "custom", operations, inside, capacity) && measured;
+#else
+    fprintf(stderr, "%s: built without the custom allocator, measured malloc only\n", BENCHMARK_VARIANT);
+#endif
+
+    free(inside);
+    return measured ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,86 @@
+#ifndef BEB2B1C4_87CD_475C_99EE_18E3B08D5501
+#define BEB2B1C4_87CD_475C_99EE_18E3B08D5501
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../Allocator/allocator.h"
+
+/*
+
+Counts what the structures ask of their allocator, by putting itself in front of whichever
+backend allocate and deallocate point to (allocator.h). Every block gets a header that holds
+its size, so deallocations can subtract what they return, and the peak of the live bytes is
+the memory the structure needed at its largest. The header is not counted.
+
+*/
+
+#define COUNTING_HEADER_SIZE 16 // keeps the blocks aligned like the backend's
+
+typedef struct
+{
+    size_t allocations;
+    size_t deallocations;
+    size_t live_bytes;
+    size_t peak_bytes;
+} allocation_counts_t;
+
+allocation_counts_t allocation_counts;
+
+static allocator_t counted_allocate;
+static deallocator_t counted_deallocate;
+
+static void *counting_allocator(size_t size)
+{
+    char *block = (char *)counted_allocate(size + COUNTING_HEADER_SIZE);
+    if (!block)
+    {
+        return NULL;
+    }
+
+    *(size_t *)block = size;
+    allocation_counts.allocations++;
+    allocation_counts.live_bytes += size;
+    if (allocation_counts.live_bytes > allocation_counts.peak_bytes)
+    {
+        allocation_counts.peak_bytes = allocation_counts.live_bytes;
+    }
+    return block + COUNTING_HEADER_SIZE;
+}
+
+static void counting_deallocator(void *ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    char *block = (char *)ptr - COUNTING_HEADER_SIZE;
+    allocation_counts.deallocations++;
+    allocation_counts.live_bytes -= *(size_t *)block;
+    counted_deallocate(block);
+}
+
+// counts the allocations of the backend allocate and deallocate point to now
+void start_counting_allocations(void)
+{
+    counted_allocate = allocate;
+    counted_deallocate = deallocate;
+    allocate = counting_allocator;
+    deallocate = counting_deallocator;
+}
+
+void stop_counting_allocations(void)
+{
+    allocate = counted_allocate;
+    deallocate = counted_deallocate;
+}
+
+void reset_allocation_counts(void)
+{
+    allocation_counts.allocations = 0;
+    allocation_counts.deallocations = 0;
+    allocation_counts.peak_bytes = allocation_counts.live_bytes;
+}
+
+#endif /* BEB2B1C4_87CD_475C_99EE_18E3B08D5501 */
@@ -0,0 +1,40 @@
+#!/bin/sh
+#
+# run.sh [csv | json] [operations]
+#
+# Builds benchmark.c once for every implementation in stack.h and queue.h, each in isolation,
+# runs them all and prints their results as one CSV table (default) or as JSON lines.
+#
+# The custom allocator backend is measured when the MemoryManager project sits next to this
+# repository (see Allocator/allocator.h); sources it needs besides its header go in
+# EXTRA_SOURCES. CC and CFLAGS are honored.
+
+set -e
+
+format=${1:-csv}
+operations=${2:-1048576}
+here=$(cd "$(dirname "$0")" && pwd)
+build=${BUILD_DIR:-"${TMPDIR:-/tmp}/data-structures-benchmark"}
+cc=${CC:-cc}
+cflags=${CFLAGS:-"-O2 -Wall -Wextra"}
+
+if [ ! -f "$here/../../../MemoryManager/mem_alloc.h" ]; then
+    cflags="$cflags -DNO_CUSTOM_ALLOCATOR"
+fi
+
+variants="STACK_ONE STACK_TWO STACK_THREE STACK_FOUR STACK_ARR_STREAMLINED STACK_ARR_BASIC
+STACK_ARR_ADV STACK_LINKED_LIST STACK_BLOCK STACK_BLOCK_NULL_ERR
+ARRAY_QUEUE QUEUE_LINKED_LIST CYCLIC_LIST_QUEUE DOUBLY_LINKED_LIST_QUEUE"
+
+mkdir -p "$build"
+header=true
+for variant in $variants; do
+    # shellcheck disable=SC2086 # cflags and EXTRA_SOURCES are lists
+    $cc $cflags -D"$variant" -o "$build/$variant" "$here/benchmark.c" ${EXTRA_SOURCES:-}
+    if $header || [ "$format" = json ]; then
+        "$build/$variant" "$format" "$operations"
+        header=false
+    else
+        "$build/$variant" "$format" "$operations" | tail -n +2
+    fi
+done
@@ -109,7 +109,7 @@ bool queue_empty(queue_t *queue)
 
 bool queue_full(queue_t *queue)
 {
-    return (queue->front == (queue->rear + 1) & (queue->size - 1)); // for this to work, size of queue must be a non-negative integral power of 2
+    return (queue->front == ((queue->rear + 1) & (queue->size - 1))); // for this to work, size of queue must be a non-negative integral power of 2
 }
 
 bool enqueue(item_t item, queue_t *queue)
@@ -202,6 +202,7 @@ bool enqueue(item_t item, queue_t *queue)
     }
 
     new_node->item = item;
+    new_node->next = NULL;
     if (!queue->rear) // i.e, if the queue is empty
     {
         queue->rear = queue->front = new_node;
@@ -209,7 +210,6 @@ bool enqueue(item_t item, queue_t *queue)
     }
 
     queue->rear->next = new_node;
-    new_node->next = NULL;
     queue->rear = new_node;
 
     return true;
@@ -347,11 +347,11 @@ item_t dequeue(queue_t *queue)
     item_t item = front->item;
 
     placeholder->next = front->next;
-    deallocate(front);
-    if (queue_empty(queue))
+    if (front == rear_end) // the last item: the queue is empty now, which front can no longer tell
     {
         queue->next = placeholder;
     }
+    deallocate(front);
 
     return item;
 }
@@ -389,8 +389,6 @@ than by the amount of memory necessary for the structure. Here is a doubly linke
 
 */
 
-#define DOUBLY_LINKED_LIST_QUEUE
-
 #ifdef DOUBLY_LINKED_LIST_QUEUE
 
 typedef struct node_ node_t;
@@ -427,6 +425,7 @@ bool enqueue(item_t item, queue_t *queue)
         return false;
     }
 
+    new_node->item = item;
     new_node->next = queue->next;
     new_node->prev = queue;
     queue->next = new_node;
@@ -437,7 +436,7 @@ bool enqueue(item_t item, queue_t *queue)
 
 bool queue_empty(queue_t *queue)
 {
-    return queue->next = queue;
+    return queue->next == queue;
 }
 
 item_t dequeue(queue_t *queue)
@@ -2,6 +2,7 @@
 #define A4AA5F91_C34B_4B17_863D_CAC9481DC891
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include "./Allocator/allocator.h"
 
@@ -74,7 +75,9 @@ A more realistic version might be the following:
 
 #ifdef STACK_ONE
 
-#define MAX_SIZE
+#ifndef MAX_SIZE
+#define MAX_SIZE 1024
+#endif
 
 size_t i = 0;
 item_t stack[MAX_SIZE];
@@ -97,7 +100,7 @@ bool push(item_t x)
 
 item_t pop(void)
 {
-    return (stack[i--]);
+    return (stack[--i]);
 }
 
 #endif
@@ -162,7 +165,7 @@ bool stack_empty(stack_t *st)
 
 bool push(item_t x, stack_t *st)
 {
-    if ((uintptr_t)st->top < (uintptr_t)st->base + st->size)
+    if (st->top < st->base + st->size)
     {
         *(st->top) = x;
         st->top += 1;
@@ -463,8 +466,9 @@ stack_t *create_stack(size_t max_size)
     }
 
     item_t *arr = (item_t *)allocate(max_size * sizeof(item_t));
-    if (!stack)
+    if (!arr)
     {
+        deallocate(stack);
         return NULL;
     }
 
@@ -530,8 +534,9 @@ stack_t *create_stack(size_t max_size)
     }
 
     item_t *arr = (item_t *)allocate(max_size * sizeof(item_t));
-    if (!stack)
+    if (!arr)
     {
+        deallocate(stack);
         return NULL;
     }
 
@@ -864,6 +869,7 @@ stack_t *create_stack(size_t max_block_size)
     stack->block_arr = (item_t *)allocate(sizeof(item_t) * max_block_size);
     if (!stack->block_arr)
     {
+        deallocate(stack);
         return NULL;
     }
 
@@ -878,31 +884,28 @@ bool push(item_t item, stack_t *stack)
 {
     if (stack->block_top >= stack->max_block_size)
     {
-        block_t *new_block = (block_t *)allocate(sizeof(block_t));
-        if (!new_block)
+        // the caller's handle stays the top block: the full block moves into a new node
+        // behind it, and the handle gets a fresh array
+        block_t *full_block = (block_t *)allocate(sizeof(block_t));
+        if (!full_block)
         {
             return false;
         }
 
-        new_block->max_block_size = stack->max_block_size;
-        new_block->block_arr = (item_t *)allocate(sizeof(item_t) * new_block->max_block_size);
-        if (!new_block->block_arr)
+        item_t *block_arr = (item_t *)allocate(sizeof(item_t) * stack->max_block_size);
+        if (!block_arr)
         {
+            deallocate(full_block);
             return false;
         }
 
-        new_block->previous_block = stack;
-        new_block->block_top = 0;
-
-        new_block->block_arr[new_block->block_top++] = item;
-
-        stack = (stack_t *)new_block;
-    }
-    else
-    {
-        stack->block_arr[stack->block_top++] = item;
+        *full_block = *stack;
+        stack->previous_block = full_block;
+        stack->block_arr = block_arr;
+        stack->block_top = 0;
     }
 
+    stack->block_arr[stack->block_top++] = item;
     return true;
 }
 
@@ -910,13 +913,11 @@ item_t pop(stack_t *stack)
 {
     if (!stack->block_top)
     {
-        stack_t *old = stack->previous_block;
-        deallocate(stack);
-
-        item_t temp = old->block_arr[--old->block_top];
-        stack = (stack_t *)old;
+        block_t *old = stack->previous_block;
+        deallocate(stack->block_arr);
 
-        return temp;
+        *stack = *old;
+        deallocate(old);
     }
 
     return stack->block_arr[--stack->block_top];
@@ -980,6 +981,7 @@ stack_t *create_stack(size_t max_block_size)
     stack->block_arr = (item_t *)allocate(sizeof(item_t) * max_block_size);
     if (!stack->block_arr)
     {
+        deallocate(stack);
         return NULL;
     }
 
@@ -999,31 +1001,28 @@ bool push(item_t item, stack_t *stack)
 
     if (stack->block_top >= stack->max_block_size)
     {
-        block_t *new_block = (block_t *)allocate(sizeof(block_t));
-        if (!new_block)
+        // the caller's handle stays the top block: the full block moves into a new node
+        // behind it, and the handle gets a fresh array
+        block_t *full_block = (block_t *)allocate(sizeof(block_t));
+        if (!full_block)
         {
             return false;
         }
 
-        new_block->max_block_size = stack->max_block_size;
-        new_block->block_arr = (item_t *)allocate(sizeof(item_t) * new_block->max_block_size);
-        if (!new_block->block_arr)
+        item_t *block_arr = (item_t *)allocate(sizeof(item_t) * stack->max_block_size);
+        if (!block_arr)
         {
+            deallocate(full_block);
             return false;
         }
 
-        new_block->previous_block = stack;
-        new_block->block_top = 0;
-
-        new_block->block_arr[new_block->block_top++] = item;
-
-        stack = (stack_t *)new_block;
-    }
-    else
-    {
-        stack->block_arr[stack->block_top++] = item;
+        *full_block = *stack;
+        stack->previous_block = full_block;
+        stack->block_arr = block_arr;
+        stack->block_top = 0;
     }
 
+    stack->block_arr[stack->block_top++] = item;
     return true;
 }
 
@@ -1036,13 +1035,11 @@ item_t pop(stack_t *stack)
 
     if (!stack->block_top)
     {
-        stack_t *old = stack->previous_block;
-        deallocate(stack);
-
-        item_t temp = old->block_arr[--old->block_top];
-        stack = (stack_t *)old;
+        block_t *old = stack->previous_block;
+        deallocate(stack->block_arr);
 
-        return temp;
+        *stack = *old;
+        deallocate(old);
     }
 
     return stack->block_arr[--stack->block_top];
@@ -4,6 +4,10 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#include "Algorithms/Counting/histogram.h"
+#include "Algorithms/Counting/presence_bitmap.h"
+#include "Algorithms/Counting/swiss_table.h"
+
 int random_between(int min, int max)
 {
     if (min > max)
@@ -46,34 +50,75 @@ int64_t method_one(int *arr)
     return ret;
 }
 
+// random_between(0, MAX) includes MAX, so the values span MAX + 1 slots
 int64_t method_two(int *arr)
 {
-    int64_t ret = 0;
     if (!arr)
     {
         return -1;
     }
 
-    int *temp = (int *)calloc(MAX, sizeof(int));
-    if (!temp)
+    presence_bitmap_t bitmap;
+    if (!presence_bitmap_init(&bitmap, (size_t)MAX + 1))
     {
         return -1;
     }
 
-    for (int64_t counter = 0; counter < NUM; counter++)
+    if (!presence_bitmap_add_all(&bitmap, arr, NUM))
+    {
+        presence_bitmap_free(&bitmap);
+        return -1;
+    }
+
+    int64_t ret = (int64_t)presence_bitmap_count_once(&bitmap);
+    presence_bitmap_free(&bitmap);
+    return ret;
+}
+
+// method_two on all cores: every thread owns a slice of the value range
+int64_t method_three(int *arr)
+{
+    if (!arr)
     {
-        temp[arr[counter]]++;
+        return -1;
+    }
+
+    histogram_summary_t summary;
+    if (!histogram_count(arr, NUM, (size_t)MAX + 1, 0, NULL, &summary))
+    {
+        return -1;
+    }
+
+    return (int64_t)summary.once;
+}
+
+// no bound on the values: memory follows the number of distinct values instead of MAX
+int64_t method_four(int *arr)
+{
+    if (!arr)
+    {
+        return -1;
+    }
+
+    swiss_table_t table;
+    if (!swiss_table_init(&table, 0))
+    {
+        return -1;
     }
 
     for (int64_t counter = 0; counter < NUM; counter++)
     {
-        if (temp[arr[counter]] == 1)
+        if (!swiss_table_add(&table, arr[counter], 1))
         {
-            ret++;
+            swiss_table_free(&table);
+            return -1;
         }
     }
 
-    return ret;
+    uint64_t count_of_counts[3];
+    swiss_table_count_of_counts(&table, count_of_counts, 3);
+    swiss_table_free(&table);
+    return (int64_t)count_of_counts[1];
 }
 
 int main()
@@ -90,5 +135,5 @@ int main()
         arr[counter] = random_between(0, MAX);
     }
 
-    printf("%ld\n", method_two(arr));
+    printf("%ld\n", method_three(arr));
 }
\ No newline at end of file